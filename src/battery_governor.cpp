@@ -0,0 +1,33 @@
+#include "battery_governor.h"
+
+using namespace sensor;
+
+//-- planCadence -----------------------------------------------------------------------------------
+Cadence sensor::planCadence(int16_t battery, uint16_t uploadFreq, uint8_t lowLevel, uint8_t criticalLevel, 
+                            bool wasSensorOnly)
+{
+  Cadence cadence;
+  cadence.interval = uploadFreq;
+  if ( 0 == lowLevel || lowLevel <= battery ) { return cadence; }
+
+  uint32_t maxInterval = std::min<uint32_t>( static_cast<uint32_t>( uploadFreq ) * GOVERNOR_MAX_STRETCH, 
+                                             GOVERNOR_MAX_INTERVAL );
+  maxInterval = std::max<uint32_t>( maxInterval, uploadFreq );
+
+  uint8_t sensorOnlyLevel = criticalLevel + ( true == wasSensorOnly ? GOVERNOR_HYSTERESIS : 0 );
+  if ( battery <= sensorOnlyLevel )
+  {
+    cadence.mode     = CADENCE_SENSOR_ONLY;
+    cadence.interval = maxInterval;
+    return cadence;
+  }
+
+  // Linear from upload_freq at the low level to maxInterval at the critical level
+  cadence.mode = CADENCE_SAVER;
+  if ( criticalLevel < lowLevel )
+  {
+    uint32_t drop  = std::min<uint32_t>( lowLevel - battery, lowLevel - criticalLevel );
+    cadence.interval = uploadFreq + ( maxInterval - uploadFreq ) * drop / ( lowLevel - criticalLevel );
+  }
+  return cadence;
+}
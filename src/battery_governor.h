@@ -0,0 +1,40 @@
+#ifndef __BATTERY_GOVERNOR_H__
+#define __BATTERY_GOVERNOR_H__
+
+#include <Arduino.h>
+
+namespace sensor
+{
+
+//-- BATTERY GOVERNOR ------------------------------------------------------------------------------
+// The sleep interval follows the battery level. Above battery_low_level it is upload_freq, below it
+// grows linearly up to GOVERNOR_MAX_STRETCH times upload_freq at battery_critical_level. At the
+// critical level the radio is not used any more: the readings go to the upload backlog and are
+// sent after the battery has been charged.
+const uint8_t  GOVERNOR_MAX_STRETCH  = 8;
+const uint8_t  GOVERNOR_HYSTERESIS   = 3;        // %, to leave the sensor-only mode
+const uint32_t GOVERNOR_MAX_INTERVAL = 3 * 3600; // s, ESP.deepSleepMax() is about 3.5 hours
+
+enum CadenceMode : uint8_t
+{
+  CADENCE_NORMAL      = 0, // upload_freq
+  CADENCE_SAVER       = 1, // stretched interval, uploads
+  CADENCE_SENSOR_ONLY = 2, // stretched interval, radio off
+};
+
+struct Cadence
+{
+  CadenceMode mode     = CADENCE_NORMAL;
+  uint32_t    interval = 0; // s
+};
+
+//-- planCadence -----------------------------------------------------------------------------------
+// battery: %, lowLevel: 0 - the governor is off
+// wasSensorOnly: the previous wake-up was sensor-only, it is left above the critical level plus
+// GOVERNOR_HYSTERESIS only, so a noisy A0 reading does not switch the radio on and off
+Cadence planCadence(int16_t battery, uint16_t uploadFreq, uint8_t lowLevel, uint8_t criticalLevel, 
+                    bool wasSensorOnly);
+
+}; // namespace
+
+#endif // __BATTERY_GOVERNOR_H__
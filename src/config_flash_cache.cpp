@@ -0,0 +1,117 @@
+#include "config_flash_cache.h"
+#include "sensor_ini_file_storage.h"
+#include "sensor_config_file_management.h"
+#include "rtc_memory_storage.h"
+
+#include <spi_flash.h>
+
+#include <GSiDebug.h>
+
+using namespace sensor;
+
+// Defined by the linker script, the sector is not used by the application otherwise
+extern "C" uint32_t _EEPROM_start;
+
+//-- Content of the flash sector
+struct ConfigCacheImage
+{
+  uint32_t magic       = CONFIG_CACHE_MAGIC;
+  uint16_t version     = INI_SNAPSHOT_VERSION;
+  uint16_t storageSize = sizeof( SensorIniFileStorage );
+  uint32_t generation  = 0;
+  uint32_t crc         = 0; // CRC32 of the generation and the storage
+
+  SensorIniFileStorage storage;
+};
+
+static_assert( 0 == sizeof(ConfigCacheImage) % 4, "the flash is written in 4 byte words" );
+static_assert( sizeof(ConfigCacheImage) <= SPI_FLASH_SEC_SIZE, "the config does not fit into a sector" );
+
+//-- getCacheSector --------------------------------------------------------------------------------
+static uint32_t getCacheSector()
+{
+  return ( (uint32_t)&_EEPROM_start - 0x40200000 ) / SPI_FLASH_SEC_SIZE;
+}
+
+//-- calculateImageCrc -----------------------------------------------------------------------------
+static uint32_t calculateImageCrc(const ConfigCacheImage &image)
+{
+  uint32_t crc = calculateCrc32( &image.generation, sizeof(image.generation) );
+  return calculateCrc32( &image.storage, sizeof(image.storage), crc );
+}
+
+//-- readCacheImage --------------------------------------------------------------------------------
+// returns false if the sector does not hold a valid image (e.g. it is erased)
+static bool readCacheImage(ConfigCacheImage &image)
+{
+  uint32_t address = getCacheSector() * SPI_FLASH_SEC_SIZE;
+  if ( false == ESP.flashRead( address, reinterpret_cast<uint32_t *>( &image ), sizeof(image) ) )
+  {
+    SERIAL_PLN("Config cache: flash read failed");
+    return false;
+  }
+
+  return CONFIG_CACHE_MAGIC == image.magic &&
+         INI_SNAPSHOT_VERSION == image.version &&
+         sizeof( SensorIniFileStorage ) == image.storageSize &&
+         calculateImageCrc( image ) == image.crc;
+}
+
+//-- loadConfigCache -------------------------------------------------------------------------------
+bool sensor::loadConfigCache(SensorIniFileStorage &storage)
+{
+  RtcConfigGeneration rtcGeneration;
+  if ( false == loadRtcRecord( RTC_BLOCK_CONFIG_GEN, rtcGeneration ) )
+  {
+    SERIAL_PLN("Config cache: no generation in RTC memory");
+    return false;
+  }
+
+  ConfigCacheImage image;
+  if ( false == readCacheImage( image ) || rtcGeneration.generation != image.generation )
+  {
+    SERIAL_PF("Config cache: miss (generation %u)\n", rtcGeneration.generation);
+    return false;
+  }
+
+  storage = image.storage;
+  SERIAL_PF("Config cache: hit (generation %u)\n", image.generation);
+  return true;
+}
+
+//-- storeConfigCache ------------------------------------------------------------------------------
+bool sensor::storeConfigCache(const SensorIniFileStorage &storage)
+{
+  ConfigCacheImage image;
+  bool isImageValid = readCacheImage( image );
+
+  if ( false == isImageValid || 0 != memcmp( &image.storage, &storage, sizeof(storage) ) )
+  {
+    image.magic       = CONFIG_CACHE_MAGIC;
+    image.version     = INI_SNAPSHOT_VERSION;
+    image.storageSize = sizeof( SensorIniFileStorage );
+    image.generation  = ( true == isImageValid ? image.generation + 1 : 1 );
+    image.storage     = storage;
+    image.crc         = calculateImageCrc( image );
+
+    uint32_t sector = getCacheSector();
+    if ( false == ESP.flashEraseSector( sector ) ||
+         false == ESP.flashWrite( sector * SPI_FLASH_SEC_SIZE, reinterpret_cast<uint32_t *>( &image ), sizeof(image) ) )
+    {
+      SERIAL_PLN("Config cache: flash write failed");
+      clearConfigCache();
+      return false;
+    }
+    SERIAL_PF("Config cache: written (generation %u)\n", image.generation);
+  }
+
+  RtcConfigGeneration rtcGeneration;
+  rtcGeneration.generation = image.generation;
+  return saveRtcRecord( RTC_BLOCK_CONFIG_GEN, rtcGeneration );
+}
+
+//-- clearConfigCache ------------------------------------------------------------------------------
+void sensor::clearConfigCache()
+{
+  clearRtcRecord<RtcConfigGeneration>( RTC_BLOCK_CONFIG_GEN );
+}
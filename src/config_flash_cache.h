@@ -0,0 +1,34 @@
+#ifndef __CONFIG_FLASH_CACHE_H__
+#define __CONFIG_FLASH_CACHE_H__
+
+#include <Arduino.h>
+
+namespace sensor
+{
+
+struct SensorIniFileStorage;
+
+//-- CONFIG FLASH CACHE ----------------------------------------------------------------------------
+// A copy of the config in the raw EEPROM sector of the flash, so a sensor wake-up can read it
+// without mounting LittleFS. The copy carries a generation counter which is also kept in the RTC
+// memory: the copy is only used if both match, i.e. after a deep sleep of a device that has
+// written the copy itself. After power-on the RTC record is gone and the config is read from
+// LittleFS again.
+const uint32_t CONFIG_CACHE_MAGIC = 0x43534947; // "GISC"
+
+//-- loadConfigCache -------------------------------------------------------------------------------
+// returns false on a cache miss, the storage is left untouched then
+bool loadConfigCache(SensorIniFileStorage &storage);
+
+//-- storeConfigCache ------------------------------------------------------------------------------
+// after the config has been read from or written to LittleFS. The sector is only erased and
+// rewritten if the content has changed.
+bool storeConfigCache(const SensorIniFileStorage &storage);
+
+//-- clearConfigCache ------------------------------------------------------------------------------
+// the next wake-up reads the config from LittleFS
+void clearConfigCache();
+
+}; // namespace
+
+#endif // __CONFIG_FLASH_CACHE_H__
@@ -0,0 +1,240 @@
+#include "config_schema.h"
+#include "sensor_config_file_management.h"
+#include "sensor_ini_file_storage.h"
+#include "upload_backlog.h"
+
+#include <GSiDebug.h>
+
+using namespace sensor;
+
+#define CONFIG_FIELD( SECTION, KEY, MEMBER, MIN_VALUE, MAX_VALUE, DECIMALS, FLAGS ) \
+  { hashConfigKey( hashConfigName( SECTION ), KEY ), SECTION, KEY, \
+    ConfigTypeOf<decltype( SensorIniFileStorage::MEMBER )>::value, \
+    offsetof( SensorIniFileStorage, MEMBER ), sizeof( SensorIniFileStorage::MEMBER ), \
+    MIN_VALUE, MAX_VALUE, DECIMALS, FLAGS }
+
+const uint8_t REQ  = CONFIG_FLAG_REQUIRED;
+const uint8_t FORM = CONFIG_FLAG_FORM;
+
+//-- CONFIG_FIELDS ---------------------------------------------------------------------------------
+// In the order of the ini file. The range is ignored for the strings, booleans and MAC addresses.
+constexpr ConfigField sensor::CONFIG_FIELDS[] =
+{
+  // [network]
+  CONFIG_FIELD( INI_NET_SECTION, INI_NET_WIFI_ENABLED,          wifi_enabled,          0, 0,     0, REQ | FORM ),
+  CONFIG_FIELD( INI_NET_SECTION, INI_NET_WIFI_AP_SSID,          wifi_ap_ssid,          0, 0,     0, REQ | FORM ),
+  CONFIG_FIELD( INI_NET_SECTION, INI_NET_WIFI_AP_PWD,           wifi_ap_pwd,           0, 0,     0, REQ | FORM ),
+  CONFIG_FIELD( INI_NET_SECTION, INI_NET_WIFI_AP_BSSID,         wifi_ap_bssid,         0, 0,     0, REQ ),
+  CONFIG_FIELD( INI_NET_SECTION, INI_NET_WIFI_AP_CHANNEL,       wifi_ap_channel,       0, 14,    0, REQ ),
+  CONFIG_FIELD( INI_NET_SECTION, INI_NET_WIFI_CON_DELAY,        wifi_con_delay,        0, 10000, 0, REQ | FORM ),
+  CONFIG_FIELD( INI_NET_SECTION, INI_NET_WIFI_MAX_CON_ATTEMPTS, wifi_max_con_attempts, 1, 1000,  0, REQ | FORM ),
+
+  // [data upload]
+  CONFIG_FIELD( INI_DATA_SECTION, INI_DATA_FREQ,               upload_freq,             1, 65535, 0, REQ | FORM ),
+  CONFIG_FIELD( INI_DATA_SECTION, INI_DATA_UPLOAD_TIMEOUT,     upload_timeout,          1, 255,   0, REQ | FORM ),
+  CONFIG_FIELD( INI_DATA_SECTION, INI_DATA_DEVICE_ID,          device_id,               0, 0,     0, REQ | FORM ),
+  CONFIG_FIELD( INI_DATA_SECTION, INI_DATA_LOCATION,           location,                0, 0,     0, REQ | FORM ),
+  CONFIG_FIELD( INI_DATA_SECTION, INI_DATA_MEASUREMENT_ORG,    data_measurement_org,    0, 0,     0, REQ | FORM ),
+  CONFIG_FIELD( INI_DATA_SECTION, INI_DATA_MEASUREMENT_BUCKET, data_measurement_bucket, 0, 0,     0, REQ | FORM ),
+  CONFIG_FIELD( INI_DATA_SECTION, INI_DATA_MEASUREMENT_NAME,   data_measurement_name,   0, 0,     0, REQ | FORM ),
+  CONFIG_FIELD( INI_DATA_SECTION, INI_DATA_BATCH_SIZE,         batch_size,              1, MAX_DATA_BATCH_SIZE, 0, FORM ),
+  CONFIG_FIELD( INI_DATA_SECTION, INI_DATA_TEMP_DEADBAND,      temp_deadband,           0, 100,   2, FORM ),
+  CONFIG_FIELD( INI_DATA_SECTION, INI_DATA_HUM_DEADBAND,       hum_deadband,            0, 100,   2, FORM ),
+  CONFIG_FIELD( INI_DATA_SECTION, INI_DATA_MAX_SILENT_WAKES,   max_silent_wakes,        0, 65535, 0, FORM ),
+  CONFIG_FIELD( INI_DATA_SECTION, INI_DATA_HISTORY_ENABLED,    history_enabled,         0, 0,     0, FORM ),
+  CONFIG_FIELD( INI_DATA_SECTION, INI_DATA_BACKLOG_DRAIN_MAX,  backlog_drain_max,       0, BACKLOG_CAPACITY, 0, FORM ),
+
+  // [server config]
+  CONFIG_FIELD( INI_SERVER_SECTION, INI_SERVER_ADDRESS,     server_address,    0, 0,     0, REQ | FORM ),
+  CONFIG_FIELD( INI_SERVER_SECTION, INI_SERVER_PORT,        server_port,       1, 65535, 0, REQ | FORM ),
+  CONFIG_FIELD( INI_SERVER_SECTION, INI_SERVER_AUTH_TOKEN,  server_auth_token, 0, 0,     0, REQ | FORM ),
+  CONFIG_FIELD( INI_SERVER_SECTION, INI_SERVER_TLS_PROFILE, tls_profile,       TLS_PROFILE_DEFAULT, TLS_PROFILE_SMALL_ECDSA, 0, FORM ),
+  CONFIG_FIELD( INI_SERVER_SECTION, INI_SERVER_GZIP_MIN_SIZE, gzip_min_size,   0, 65535, 0, FORM ),
+  CONFIG_FIELD( INI_SERVER_SECTION, INI_SERVER_TRANSPORT,     server_transport, SERVER_TRANSPORT_HTTPS, SERVER_TRANSPORT_UDP_ACK, 0, FORM ),
+
+  // [display]
+  CONFIG_FIELD( INI_DISP_SECTION, INI_DISP_CONTRAST, display_contrast, 0, 255, 0, REQ | FORM ),
+  CONFIG_FIELD( INI_DISP_SECTION, INI_DISP_ROTATION, display_rotation, 0, 0,   0, REQ | FORM ),
+
+  // [sensor]
+  CONFIG_FIELD( INI_SENSOR_SECTION, INI_SENSOR_TEMP_CORRECTION,    sensor_temp_correction,    -20, 20,    1, REQ | FORM ),
+  CONFIG_FIELD( INI_SENSOR_SECTION, INI_SENSOR_TELEMETRY_INTERVAL, sensor_telemetry_interval, 250, 60000, 0, FORM ),
+
+  // [battery]
+  CONFIG_FIELD( INI_BATTERY_SECTION, INI_BATTERY_MIN_LEVEL, batteryMinLevel, 0, 1023, 0, REQ | FORM ),
+  CONFIG_FIELD( INI_BATTERY_SECTION, INI_BATTERY_MAX_LEVEL, batteryMaxLevel, 0, 1023, 0, REQ | FORM ),
+  CONFIG_FIELD( INI_BATTERY_SECTION, INI_BATTERY_LOW_LEVEL,      batteryLowLevel,      0, 100, 0, FORM ),
+  CONFIG_FIELD( INI_BATTERY_SECTION, INI_BATTERY_CRITICAL_LEVEL, batteryCriticalLevel, 0, 100, 0, FORM ),
+};
+
+const uint8_t sensor::CONFIG_FIELD_COUNT = sizeof( CONFIG_FIELDS ) / sizeof( CONFIG_FIELDS[0] );
+
+// The parser keeps the found keys in a ConfigFieldMask
+static_assert( 8 * sizeof( ConfigFieldMask ) >= sizeof( CONFIG_FIELDS ) / sizeof( CONFIG_FIELDS[0] ), "Too many config fields" );
+
+//-- ConfigHashIndex -------------------------------------------------------------------------------
+// The hashes of CONFIG_FIELDS in ascending order and the index of their field, built at compile time
+// for the binary search of findConfigField()
+const uint8_t CONFIG_INDEX_SIZE = sizeof( CONFIG_FIELDS ) / sizeof( CONFIG_FIELDS[0] );
+
+struct ConfigHashIndex
+{
+  uint32_t hash[CONFIG_INDEX_SIZE];
+  uint8_t  index[CONFIG_INDEX_SIZE];
+};
+
+//-- sortConfigHashes: insertion sort, the table has a few dozen fields
+constexpr ConfigHashIndex sortConfigHashes()
+{
+  ConfigHashIndex sorted = {};
+  for ( uint8_t i = 0; i < CONFIG_INDEX_SIZE; ++i )
+  {
+    uint8_t position = i;
+    for ( ; 0 < position && sorted.hash[position - 1] > CONFIG_FIELDS[i].hash; --position )
+    {
+      sorted.hash[position]  = sorted.hash[position - 1];
+      sorted.index[position] = sorted.index[position - 1];
+    }
+    sorted.hash[position]  = CONFIG_FIELDS[i].hash;
+    sorted.index[position] = i;
+  }
+  return sorted;
+}
+
+//-- hasUniqueConfigHashes: two keys with the same hash could not be told apart
+constexpr bool hasUniqueConfigHashes(const ConfigHashIndex &sorted)
+{
+  for ( uint8_t i = 1; i < CONFIG_INDEX_SIZE; ++i )
+  {
+    if ( sorted.hash[i - 1] == sorted.hash[i] ) { return false; }
+  }
+  return true;
+}
+
+static constexpr ConfigHashIndex CONFIG_HASH_INDEX = sortConfigHashes();
+
+static_assert( hasUniqueConfigHashes( CONFIG_HASH_INDEX ), "Two config keys have the same hash, rename one of them" );
+
+//-- findConfigField -------------------------------------------------------------------------------
+// Binary search, an ini line costs a handful of comparisons
+int8_t sensor::findConfigField(uint32_t hash)
+{
+  uint8_t low  = 0;
+  uint8_t high = CONFIG_INDEX_SIZE;
+  while ( low < high )
+  {
+    uint8_t middle = ( low + high ) / 2;
+    if      ( CONFIG_HASH_INDEX.hash[middle] < hash ) { low  = middle + 1; }
+    else if ( CONFIG_HASH_INDEX.hash[middle] > hash ) { high = middle; }
+    else                                              { return CONFIG_HASH_INDEX.index[middle]; }
+  }
+  return -1;
+}
+
+//-- getConfigFieldMask ----------------------------------------------------------------------------
+ConfigFieldMask sensor::getConfigFieldMask(uint16_t offset)
+{
+  for ( uint8_t i = 0; i < CONFIG_FIELD_COUNT; ++i )
+  {
+    if ( offset == CONFIG_FIELDS[i].offset ) { return 1ULL << i; }
+  }
+  return 0;
+}
+
+//-- parseConfigValue ------------------------------------------------------------------------------
+bool sensor::parseConfigValue(const ConfigField &field, const char *text, SensorIniFileStorage &storage)
+{
+  uint8_t *value = reinterpret_cast<uint8_t *>( &storage ) + field.offset;
+  char *end = NULL;
+
+  switch ( field.type )
+  {
+  case CONFIG_TYPE_BOOL:
+    {
+      bool boolValue = false;
+      if      ( 0 == strcasecmp( text, "true" )  || 0 == strcasecmp( text, "yes" ) || 
+                0 == strcasecmp( text, "on" )    || 0 == strcmp( text, "1" ) )      { boolValue = true; }
+      else if ( 0 == strcasecmp( text, "false" ) || 0 == strcasecmp( text, "no" ) || 
+                0 == strcasecmp( text, "off" )   || 0 == strcmp( text, "0" ) )      { boolValue = false; }
+      else { return false; }
+
+      *reinterpret_cast<bool *>( value ) = boolValue;
+      SERIAL_PF("%s = %s\n", field.key, ( true == boolValue ? "true" : "false" ) );
+      return true;
+    }
+
+  case CONFIG_TYPE_STRING:
+    if ( field.size <= strlen( text ) ) { return false; }
+    strcpy( reinterpret_cast<char *>( value ), text );
+    SERIAL_PF("%s = %s\n", field.key, text );
+    return true;
+
+  case CONFIG_TYPE_UINT8:
+  case CONFIG_TYPE_UINT16:
+  case CONFIG_TYPE_INT32:
+    {
+      long number = strtol( text, &end, 10 );
+      if ( end == text || 0 != *end || field.minValue > number || field.maxValue < number ) { return false; }
+
+      if      ( CONFIG_TYPE_UINT8  == field.type ) { *value = static_cast<uint8_t>( number ); }
+      else if ( CONFIG_TYPE_UINT16 == field.type ) { *reinterpret_cast<uint16_t *>( value ) = static_cast<uint16_t>( number ); }
+      else                                         { *reinterpret_cast<int32_t *>( value )  = static_cast<int32_t>( number ); }
+
+      SERIAL_PF("%s = %ld\n", field.key, number );
+      return true;
+    }
+
+  case CONFIG_TYPE_FLOAT:
+    {
+      float number = strtof( text, &end );
+      if ( end == text || 0 != *end || field.minValue > number || field.maxValue < number ) { return false; }
+
+      *reinterpret_cast<float *>( value ) = number;
+      SERIAL_PF("%s = %f\n", field.key, number );
+      return true;
+    }
+
+  case CONFIG_TYPE_MAC:
+    {
+      uint8_t mac[6] = { 0 };
+      for ( uint8_t i = 0; i < sizeof( mac ); ++i )
+      {
+        unsigned long octet = strtoul( text, &end, 16 );
+        if ( end == text || 0xFF < octet ) { return false; }
+        if ( sizeof( mac ) - 1 > i && '-' != *end && ':' != *end ) { return false; }
+        mac[i] = static_cast<uint8_t>( octet );
+        text = end + 1;
+      }
+      if ( 0 != *end ) { return false; }
+
+      memcpy( value, mac, sizeof( mac ) );
+      SERIAL_PF("%s = %x-%x-%x-%x-%x-%x\n", field.key, mac[0], mac[1], mac[2], mac[3], mac[4], mac[5] );
+      return true;
+    }
+  }
+  return false;
+}
+
+//-- printConfigValue ------------------------------------------------------------------------------
+size_t sensor::printConfigValue(Print &out, const ConfigField &field, const SensorIniFileStorage &storage)
+{
+  const uint8_t *value = reinterpret_cast<const uint8_t *>( &storage ) + field.offset;
+
+  switch ( field.type )
+  {
+  case CONFIG_TYPE_BOOL:   return out.print( true == *reinterpret_cast<const bool *>( value ) ? "true" : "false" );
+  case CONFIG_TYPE_STRING: return out.print( reinterpret_cast<const char *>( value ) );
+  case CONFIG_TYPE_UINT8:  return out.print( static_cast<unsigned long>( *value ) );
+  case CONFIG_TYPE_UINT16: return out.print( static_cast<unsigned long>( *reinterpret_cast<const uint16_t *>( value ) ) );
+  case CONFIG_TYPE_INT32:  return out.print( static_cast<long>( *reinterpret_cast<const int32_t *>( value ) ) );
+  case CONFIG_TYPE_FLOAT:  return out.print( *reinterpret_cast<const float *>( value ), field.decimals );
+  case CONFIG_TYPE_MAC:
+    {
+      char text[18] = { 0 };
+      snprintf( text, sizeof( text ), "%02x-%02x-%02x-%02x-%02x-%02x", 
+                value[0], value[1], value[2], value[3], value[4], value[5] );
+      return out.print( text );
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,103 @@
+#ifndef __CONFIG_SCHEMA_H__
+#define __CONFIG_SCHEMA_H__
+
+#include <Arduino.h>
+#include <stddef.h>
+
+namespace sensor
+{
+
+//-- CONFIG SCHEMA ---------------------------------------------------------------------------------
+// One descriptor per ini key: where it is stored in SensorIniFileStorage, how it is parsed,
+// validated and printed. The ini file, the js file of the config page and the submitted form are
+// all processed by walking the table, a new setting needs one line in CONFIG_FIELDS only.
+// The keys are identified by the FNV-1a hash of "<section>/<key>", calculated at compile time for
+// the table and on the fly for the lines of the ini file.
+
+enum ConfigValueType : uint8_t
+{
+  CONFIG_TYPE_BOOL = 0,
+  CONFIG_TYPE_STRING,
+  CONFIG_TYPE_UINT8,
+  CONFIG_TYPE_UINT16,
+  CONFIG_TYPE_INT32,
+  CONFIG_TYPE_FLOAT,
+  CONFIG_TYPE_MAC,     // uint8_t[6], "00-00-00-00-00-00" or "00:00:00:00:00:00"
+};
+
+const uint32_t CONFIG_HASH_OFFSET = 2166136261UL;
+const uint32_t CONFIG_HASH_PRIME  = 16777619UL;
+
+//-- hashConfigName --------------------------------------------------------------------------------
+// FNV-1a, pass the previous result as hash to continue a calculation
+constexpr uint32_t hashConfigName(const char *name, uint32_t hash = CONFIG_HASH_OFFSET)
+{
+  return ( 0 == *name ? hash : hashConfigName( name + 1, ( hash ^ static_cast<uint8_t>( *name ) ) * CONFIG_HASH_PRIME ) );
+}
+
+//-- hashConfigKey ---------------------------------------------------------------------------------
+// sectionHash is hashConfigName( section )
+constexpr uint32_t hashConfigKey(uint32_t sectionHash, const char *key)
+{
+  return hashConfigName( key, ( sectionHash ^ static_cast<uint8_t>( '/' ) ) * CONFIG_HASH_PRIME );
+}
+
+//-- flags of ConfigField
+const uint8_t CONFIG_FLAG_REQUIRED = 0x01; // the ini file must contain it
+const uint8_t CONFIG_FLAG_FORM     = 0x02; // it is on the config page (js file and submit)
+
+struct ConfigField
+{
+  uint32_t         hash;      // hashConfigKey( hashConfigName( section ), key )
+  const char      *section;
+  const char      *key;
+  ConfigValueType  type;
+  uint16_t         offset;    // in SensorIniFileStorage
+  uint16_t         size;      // in SensorIniFileStorage, strings: maximum length + 1
+  int32_t          minValue;  // numbers only, the valid range
+  int32_t          maxValue;
+  uint8_t          decimals;  // CONFIG_TYPE_FLOAT only, in the ini and the js files
+  uint8_t          flags;     // CONFIG_FLAG_*
+};
+
+//-- ConfigTypeOf ----------------------------------------------------------------------------------
+// The value type of a SensorIniFileStorage member, a member of other type does not compile
+template <typename T> struct ConfigTypeOf;
+template <> struct ConfigTypeOf<bool>     { static const ConfigValueType value = CONFIG_TYPE_BOOL;   };
+template <> struct ConfigTypeOf<uint8_t>  { static const ConfigValueType value = CONFIG_TYPE_UINT8;  };
+template <> struct ConfigTypeOf<uint16_t> { static const ConfigValueType value = CONFIG_TYPE_UINT16; };
+template <> struct ConfigTypeOf<int32_t>  { static const ConfigValueType value = CONFIG_TYPE_INT32;  };
+template <> struct ConfigTypeOf<float>    { static const ConfigValueType value = CONFIG_TYPE_FLOAT;  };
+template <size_t N> struct ConfigTypeOf<char[N]>    { static const ConfigValueType value = CONFIG_TYPE_STRING; };
+template <>         struct ConfigTypeOf<uint8_t[6]> { static const ConfigValueType value = CONFIG_TYPE_MAC;    };
+
+extern const ConfigField CONFIG_FIELDS[];
+extern const uint8_t     CONFIG_FIELD_COUNT;
+
+//-- findConfigField -------------------------------------------------------------------------------
+// returns the index in CONFIG_FIELDS, -1 if the key is unknown. A binary search over the hashes,
+// which are checked to be unique at compile time.
+int8_t findConfigField(uint32_t hash);
+
+//-- getConfigFieldMask ----------------------------------------------------------------------------
+// The bit of a field in a set of fields (e.g. the changed ones), offset is in SensorIniFileStorage
+typedef uint64_t ConfigFieldMask;
+
+ConfigFieldMask getConfigFieldMask(uint16_t offset);
+
+#define CONFIG_FIELD_MASK( MEMBER ) sensor::getConfigFieldMask( offsetof( sensor::SensorIniFileStorage, MEMBER ) )
+
+struct SensorIniFileStorage;
+
+//-- parseConfigValue ------------------------------------------------------------------------------
+// Converts the text and stores it in the field. Returns false if the value is malformed or out of
+// range, the field is not changed then.
+bool parseConfigValue(const ConfigField &field, const char *text, SensorIniFileStorage &storage);
+
+//-- printConfigValue ------------------------------------------------------------------------------
+// In the format of the ini file, parseConfigValue() reads it back
+size_t printConfigValue(Print &out, const ConfigField &field, const SensorIniFileStorage &storage);
+
+}; // namespace
+
+#endif // __CONFIG_SCHEMA_H__
@@ -0,0 +1,234 @@
+#include "gzip_stream.h"
+#include "rtc_memory_storage.h"
+
+#include <new>
+
+using namespace sensor;
+
+const uint16_t GZIP_HASH_EMPTY    = 0xFFFF;
+const uint16_t GZIP_END_OF_BLOCK  = 256;
+const uint16_t GZIP_FIRST_LENGTH  = 257;
+
+// The distances are shorter than the buffer, the distance codes above 19 are never used
+static_assert( 2 * GZIP_WINDOW_SIZE <= 1024, "the distance table ends at 1024" );
+
+// RFC 1951 3.2.5: the base values and the extra bits of the length and the distance codes
+static const uint16_t LENGTH_BASE[]  = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                         35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t  LENGTH_EXTRA[] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                         3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t DISTANCE_BASE[]  = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                           257, 385, 513, 769 };
+static const uint8_t  DISTANCE_EXTRA[] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8 };
+
+//-- hashPrefix ------------------------------------------------------------------------------------
+static uint8_t hashPrefix(const uint8_t *data)
+{
+  uint32_t prefix = ( static_cast<uint32_t>( data[0] ) << 16 ) | ( data[1] << 8 ) | data[2];
+  return ( prefix * 2654435761UL ) >> 24;
+}
+
+//-- reverseBits -----------------------------------------------------------------------------------
+// The Huffman codes are packed starting with their most significant bit
+static uint16_t reverseBits(uint16_t code, uint8_t length)
+{
+  uint16_t reversed = 0;
+  for ( uint8_t i = 0; i < length; ++i, code >>= 1 ) { reversed = ( reversed << 1 ) | ( code & 1 ); }
+  return reversed;
+}
+
+//-- GzipStream::begin -----------------------------------------------------------------------------
+bool GzipStream::begin(Print &out)
+{
+  release();
+  m_window = new (std::nothrow) GzipWindow;
+  if ( nullptr == m_window ) { return false; }
+
+  memset( m_window->hash, 0xFF, sizeof( m_window->hash ) );
+  m_out      = &out;
+  m_used     = 0;
+  m_pending  = 0;
+  m_crc      = 0;
+  m_size     = 0;
+  m_bits     = 0;
+  m_bitCount = 0;
+  m_hasHeader = false;
+  return true;
+}
+
+//-- GzipStream::end -------------------------------------------------------------------------------
+void GzipStream::end()
+{
+  if ( nullptr == m_window ) { return; }
+  if ( false == m_hasHeader ) { writeHeader(); }
+
+  compress( true );
+  putCode( GZIP_END_OF_BLOCK );
+  flushBits();
+
+  // CRC32 and ISIZE, little endian
+  uint8_t trailer[8];
+  for ( uint8_t i = 0; i < 4; ++i )
+  {
+    trailer[i]     = static_cast<uint8_t>( m_crc  >> ( 8 * i ) );
+    trailer[i + 4] = static_cast<uint8_t>( m_size >> ( 8 * i ) );
+  }
+  m_out->write( trailer, sizeof( trailer ) );
+  release();
+}
+
+//-- GzipStream::release ---------------------------------------------------------------------------
+void GzipStream::release()
+{
+  delete m_window;
+  m_window = nullptr;
+}
+
+//-- GzipStream::writeHeader -----------------------------------------------------------------------
+// No file name and no time, then the one and only deflate block: BFINAL, fixed Huffman codes
+void GzipStream::writeHeader()
+{
+  const uint8_t HEADER[] = { 0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 0xFF };
+  m_out->write( HEADER, sizeof( HEADER ) );
+  putBits( 1, 1 );
+  putBits( 1, 2 );
+  m_hasHeader = true;
+}
+
+//-- GzipStream::write -----------------------------------------------------------------------------
+size_t GzipStream::write(const uint8_t *data, size_t size)
+{
+  if ( nullptr == m_window ) { return 0; }
+  if ( false == m_hasHeader ) { writeHeader(); }
+
+  m_crc   = calculateCrc32( data, size, m_crc );
+  m_size += size;
+
+  size_t left = size;
+  while ( 0 < left )
+  {
+    size_t part = std::min<size_t>( left, sizeof( m_window->data ) - m_used );
+    memcpy( m_window->data + m_used, data, part );
+    m_used += part;
+    data   += part;
+    left   -= part;
+
+    if ( sizeof( m_window->data ) == m_used )
+    {
+      compress( false );
+      slideWindow();
+    }
+  }
+  return size;
+}
+
+//-- GzipStream::compress --------------------------------------------------------------------------
+// Greedy matching. Until the end of the input a match must fit into the buffered bytes, so the
+// last GZIP_MAX_MATCH bytes are only compressed after the window has been slid.
+void GzipStream::compress(bool isFinal)
+{
+  uint16_t limit = ( true == isFinal ? m_used : m_used - GZIP_MAX_MATCH );
+  while ( m_pending < limit )
+  {
+    uint16_t distance = 0;
+    uint16_t length   = findMatch( m_pending, distance );
+    if ( GZIP_MIN_MATCH > length )
+    {
+      putLiteral( m_window->data[m_pending++] );
+      continue;
+    }
+
+    putMatch( length, distance );
+    for ( uint16_t end = m_pending + length; ++m_pending < end; )
+    {
+      if ( m_pending + GZIP_MIN_MATCH <= m_used ) { m_window->hash[hashPrefix( m_window->data + m_pending )] = m_pending; }
+    }
+  }
+}
+
+//-- GzipStream::slideWindow -----------------------------------------------------------------------
+// The last GZIP_WINDOW_SIZE compressed bytes and the rest of the input are kept
+void GzipStream::slideWindow()
+{
+  uint16_t shift = m_pending - GZIP_WINDOW_SIZE;
+  memmove( m_window->data, m_window->data + shift, m_used - shift );
+  m_used    -= shift;
+  m_pending -= shift;
+
+  for ( uint16_t &position : m_window->hash )
+  {
+    position = ( GZIP_HASH_EMPTY != position && shift <= position ? position - shift : GZIP_HASH_EMPTY );
+  }
+}
+
+//-- GzipStream::findMatch -------------------------------------------------------------------------
+// The last position with the same prefix hash is the only candidate. Returns the match length.
+uint16_t GzipStream::findMatch(uint16_t position, uint16_t &distance)
+{
+  if ( m_used < position + GZIP_MIN_MATCH ) { return 0; }
+
+  const uint8_t *data = m_window->data;
+  uint16_t &slot     = m_window->hash[hashPrefix( data + position )];
+  uint16_t candidate = slot;
+  slot = position;
+  if ( GZIP_HASH_EMPTY == candidate ) { return 0; }
+
+  uint16_t maxLength = std::min<uint16_t>( GZIP_MAX_MATCH, m_used - position );
+  uint16_t length = 0;
+  while ( length < maxLength && data[candidate + length] == data[position + length] ) { ++length; }
+
+  distance = position - candidate;
+  return length;
+}
+
+//-- GzipStream::putLiteral ------------------------------------------------------------------------
+void GzipStream::putLiteral(uint8_t literal)
+{
+  putCode( literal );
+}
+
+//-- GzipStream::putMatch --------------------------------------------------------------------------
+void GzipStream::putMatch(uint16_t length, uint16_t distance)
+{
+  uint8_t code = sizeof( LENGTH_BASE ) / sizeof( LENGTH_BASE[0] ) - 1;
+  while ( LENGTH_BASE[code] > length ) { --code; }
+  putCode( GZIP_FIRST_LENGTH + code );
+  putBits( length - LENGTH_BASE[code], LENGTH_EXTRA[code] );
+
+  code = sizeof( DISTANCE_BASE ) / sizeof( DISTANCE_BASE[0] ) - 1;
+  while ( DISTANCE_BASE[code] > distance ) { --code; }
+  putBits( reverseBits( code, 5 ), 5 );
+  putBits( distance - DISTANCE_BASE[code], DISTANCE_EXTRA[code] );
+}
+
+//-- GzipStream::putCode ---------------------------------------------------------------------------
+// A literal/length symbol with the fixed Huffman codes of RFC 1951 3.2.6
+void GzipStream::putCode(uint16_t symbol)
+{
+  if      ( 144 > symbol ) { putBits( reverseBits( 0x30  + symbol,         8 ), 8 ); }
+  else if ( 256 > symbol ) { putBits( reverseBits( 0x190 + ( symbol - 144 ), 9 ), 9 ); }
+  else if ( 280 > symbol ) { putBits( reverseBits( symbol - 256,           7 ), 7 ); }
+  else                     { putBits( reverseBits( 0xC0  + ( symbol - 280 ), 8 ), 8 ); }
+}
+
+//-- GzipStream::putBits ---------------------------------------------------------------------------
+void GzipStream::putBits(uint32_t bits, uint8_t count)
+{
+  m_bits |= bits << m_bitCount;
+  m_bitCount += count;
+  while ( 8 <= m_bitCount )
+  {
+    m_out->write( static_cast<uint8_t>( m_bits ) );
+    m_bits >>= 8;
+    m_bitCount -= 8;
+  }
+}
+
+//-- GzipStream::flushBits -------------------------------------------------------------------------
+// To the byte boundary, the unused bits are 0
+void GzipStream::flushBits()
+{
+  if ( 0 < m_bitCount ) { m_out->write( static_cast<uint8_t>( m_bits ) ); }
+  m_bits     = 0;
+  m_bitCount = 0;
+}
@@ -0,0 +1,68 @@
+#ifndef __GZIP_STREAM_H__
+#define __GZIP_STREAM_H__
+
+#include <Arduino.h>
+
+namespace sensor
+{
+
+//-- GZIP STREAM -----------------------------------------------------------------------------------
+// Streaming deflate (RFC 1951) in a gzip container (RFC 1952) for the upload bodies. Only the fixed
+// Huffman codes are used, so there is no code table to build or send: the line protocol gains its
+// ratio from the LZ77 matches of the repeated measurement, tag and field names anyway.
+// The matches look back GZIP_WINDOW_SIZE bytes, a few lines of line protocol.
+const size_t   GZIP_WINDOW_SIZE = 512;
+const uint16_t GZIP_HASH_SIZE   = 256; // the last position of every 3 byte prefix hash
+const uint16_t GZIP_MIN_MATCH   = 3;
+const uint16_t GZIP_MAX_MATCH   = 258;
+
+//-- The window of the already compressed bytes and the input not compressed yet, about 1.5 KB.
+//   It is allocated for the time of an upload only.
+struct GzipWindow
+{
+  uint8_t  data[2 * GZIP_WINDOW_SIZE];
+  uint16_t hash[GZIP_HASH_SIZE];
+};
+
+//-- GzipStream ------------------------------------------------------------------------------------
+// The bytes printed to it are compressed to out. The gzip header is written with the first byte.
+class GzipStream : public Print
+{
+public:
+  ~GzipStream() { release(); }
+
+  //-- begin: allocates the window, returns false if the heap is short. Nothing is written yet.
+  bool begin(Print &out);
+  //-- end: compresses the rest of the input, writes the trailer and releases the window
+  void end();
+
+  using Print::write;
+  size_t write(uint8_t c) override { return write( &c, 1 ); }
+  size_t write(const uint8_t *data, size_t size) override;
+
+private:
+  void release();
+  void writeHeader();
+  void compress(bool isFinal);
+  void slideWindow();
+  uint16_t findMatch(uint16_t position, uint16_t &distance);
+  void putLiteral(uint8_t literal);
+  void putMatch(uint16_t length, uint16_t distance);
+  void putCode(uint16_t symbol);
+  void putBits(uint32_t bits, uint8_t count);
+  void flushBits();
+
+  Print      *m_out    = nullptr;
+  GzipWindow *m_window = nullptr;
+  uint16_t    m_used    = 0; // bytes in GzipWindow::data
+  uint16_t    m_pending = 0; // the first byte not compressed yet
+  uint32_t    m_crc  = 0;    // of the input
+  uint32_t    m_size = 0;    // of the input
+  uint32_t    m_bits = 0;    // not written yet, LSB first
+  uint8_t     m_bitCount = 0;
+  bool        m_hasHeader = false;
+};
+
+}; // namespace
+
+#endif // __GZIP_STREAM_H__
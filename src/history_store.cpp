@@ -0,0 +1,616 @@
+#include "history_store.h"
+#include "rtc_memory_storage.h"
+#include "segment_file.h"
+
+#include <LittleFS.h>
+#include <ESPAsyncWebServer.h>
+
+#include <memory>
+
+#include <GSiDebug.h>
+
+using namespace sensor;
+
+//-- Header of a segment file, the blocks follow it
+struct HistorySegmentHeader
+{
+  uint32_t magic         = HISTORY_MAGIC;
+  uint16_t version       = HISTORY_VERSION;
+  uint16_t blockSize     = HISTORY_BLOCK_SIZE;
+  uint16_t segmentBlocks = HISTORY_SEGMENT_BLOCKS;
+  uint16_t reserved      = 0;
+};
+
+//-- Header of the pending file, the uncompressed points follow it
+struct HistoryPendingHeader
+{
+  uint32_t magic    = HISTORY_MAGIC;
+  uint32_t sequence = 0; // of the block the points belong to
+};
+
+static_assert( sizeof(HistoryBlock) == HISTORY_BLOCK_SIZE, "the block header has padding" );
+static_assert( 12 == sizeof(HistoryPoint), "the pending points are stored as they are" );
+
+const uint16_t HISTORY_DATA_BITS = HISTORY_BLOCK_DATA_SIZE * 8;
+const uint8_t  HISTORY_VALUE_BITS = 16;
+
+//-- getSegmentNumber ------------------------------------------------------------------------------
+// The block sequences start at 1, every segment holds HISTORY_SEGMENT_BLOCKS of them
+static uint32_t getSegmentNumber(uint32_t sequence) { return ( sequence - 1 ) / HISTORY_SEGMENT_BLOCKS; }
+
+//-- calculateBlockCrc -----------------------------------------------------------------------------
+static uint32_t calculateBlockCrc(const HistoryBlock &block)
+{
+  uint32_t crc = calculateCrc32( &block.header, offsetof( HistoryBlockHeader, crc ) );
+  return calculateCrc32( block.data, sizeof( block.data ), crc );
+}
+
+//-- openSegment -----------------------------------------------------------------------------------
+// For reading, the file is positioned at the first block. Returns false if the segment does not
+// exist or it has an unknown format.
+static bool openSegment(uint32_t number, File &file)
+{
+  char path[SEGMENT_PATH_MAX_LENGTH];
+  getSegmentPath( HISTORY_DIRECTORY, number, path );
+  file = LittleFS.open( path, "r" );
+  if ( false == file ) { return false; }
+
+  HistorySegmentHeader header;
+  HistorySegmentHeader fileHeader;
+  if ( sizeof( fileHeader ) != file.read( reinterpret_cast<uint8_t *>( &fileHeader ), sizeof( fileHeader ) ) ||
+       0 != memcmp( &header, &fileHeader, sizeof( header ) ) )
+  {
+    SERIAL_PF("History: segment %u has an unknown format.\n", static_cast<unsigned>( number ));
+    file.close();
+    return false;
+  }
+  return true;
+}
+
+//-- countSegmentBlocks ----------------------------------------------------------------------------
+// 0 if the segment does not exist
+static uint16_t countSegmentBlocks(uint32_t number)
+{
+  File file;
+  if ( false == openSegment( number, file ) ) { return 0; }
+
+  uint16_t count = ( file.size() - sizeof( HistorySegmentHeader ) ) / HISTORY_BLOCK_SIZE;
+  file.close();
+  return count;
+}
+
+//-- BIT STREAM ------------------------------------------------------------------------------------
+// The bits are stored from the most significant one. The writer does not write past the data, it
+// returns false instead.
+static bool writeBits(HistoryBlock &block, uint32_t value, uint8_t count)
+{
+  if ( HISTORY_DATA_BITS < block.header.bitLength + count ) { return false; }
+
+  while ( 0 < count-- )
+  {
+    uint16_t position = block.header.bitLength++;
+    uint8_t  mask     = 0x80 >> ( position % 8 );
+    if ( 0 != ( ( value >> count ) & 1 ) ) { block.data[ position / 8 ] |= mask; }
+    else                                   { block.data[ position / 8 ] &= ~mask; }
+  }
+  return true;
+}
+
+static uint32_t readBits(const HistoryBlock &block, uint16_t &position, uint8_t count)
+{
+  uint32_t value = 0;
+  while ( 0 < count-- )
+  {
+    value = ( value << 1 ) | ( ( block.data[ position / 8 ] >> ( 7 - position % 8 ) ) & 1 );
+    ++position;
+  }
+  return value;
+}
+
+//-- countLeadingZeros / countTrailingZeros: of a non-zero 16 bit value
+static uint8_t countLeadingZeros(uint16_t value)
+{
+  uint8_t count = 0;
+  while ( 0 == ( value & 0x8000 ) ) { value <<= 1; ++count; }
+  return count;
+}
+
+static uint8_t countTrailingZeros(uint16_t value)
+{
+  uint8_t count = 0;
+  while ( 0 == ( value & 1 ) ) { value >>= 1; ++count; }
+  return count;
+}
+
+//-- DELTA-OF-DELTA RANGES -------------------------------------------------------------------------
+// control bits, number of the value bits and the smallest value of the range (biased storage)
+struct DeltaRange
+{
+  uint8_t control;
+  uint8_t controlBits;
+  uint8_t valueBits;
+  int32_t minValue;
+};
+
+const DeltaRange DELTA_RANGES[] =
+{
+  { 0x02, 2,  7,   -63 }, // '10'
+  { 0x06, 3,  9,  -255 }, // '110'
+  { 0x0E, 4, 12, -2047 }, // '1110'
+};
+const uint8_t DELTA_LARGE_CONTROL = 0x0F; // '1111' and 32 bits
+
+//-- resetCodec ------------------------------------------------------------------------------------
+// The first point of a block: the time is in the header, the values are stored as they are
+static void resetCodec(HistoryCodec &codec, const HistoryPoint &point)
+{
+  codec = HistoryCodec();
+  codec.time = point.time;
+  memcpy( codec.values, point.values, sizeof( codec.values ) );
+}
+
+//-- encodePoint -----------------------------------------------------------------------------------
+// returns false if the point does not fit into the block, the block and the codec are unchanged then
+static bool encodePoint(HistoryBlock &block, HistoryCodec &codec, const HistoryPoint &point)
+{
+  uint16_t     bitLength = block.header.bitLength;
+  HistoryCodec next      = codec;
+  bool         isFitting = true;
+
+  if ( 0 == block.header.count )
+  {
+    block.header.firstTime = point.time;
+    resetCodec( next, point );
+    for ( uint8_t i = 0; i < HISTORY_VALUE_COUNT && true == isFitting; ++i )
+    {
+      isFitting = writeBits( block, point.values[i], HISTORY_VALUE_BITS );
+    }
+  }
+  else
+  {
+    // Time: delta-of-delta
+    int32_t delta = static_cast<int32_t>( point.time - next.time );
+    int32_t deltaOfDelta = delta - next.delta;
+    next.time  = point.time;
+    next.delta = delta;
+
+    if ( 0 == deltaOfDelta ) { isFitting = writeBits( block, 0, 1 ); }
+    else
+    {
+      bool isEncoded = false;
+      for ( const DeltaRange &range : DELTA_RANGES )
+      {
+        if ( range.minValue <= deltaOfDelta && deltaOfDelta < range.minValue + ( 1L << range.valueBits ) )
+        {
+          isFitting = writeBits( block, range.control, range.controlBits ) &&
+                      writeBits( block, deltaOfDelta - range.minValue, range.valueBits );
+          isEncoded = true;
+          break;
+        }
+      }
+      if ( false == isEncoded )
+      {
+        isFitting = writeBits( block, DELTA_LARGE_CONTROL, 4 ) &&
+                    writeBits( block, static_cast<uint32_t>( deltaOfDelta ), 32 );
+      }
+    }
+
+    // Values: XOR with the previous ones
+    for ( uint8_t i = 0; i < HISTORY_VALUE_COUNT && true == isFitting; ++i )
+    {
+      uint16_t xored = point.values[i] ^ next.values[i];
+      next.values[i] = point.values[i];
+      if ( 0 == xored )
+      {
+        isFitting = writeBits( block, 0, 1 );
+        continue;
+      }
+
+      uint8_t leading  = countLeadingZeros( xored );
+      uint8_t trailing = countTrailingZeros( xored );
+      if ( true == next.hasWindow[i] && next.leading[i] <= leading && next.trailing[i] <= trailing )
+      {
+        // The meaningful bits fit into the previous window
+        isFitting = writeBits( block, 0x02, 2 ) &&
+                    writeBits( block, xored >> next.trailing[i], HISTORY_VALUE_BITS - next.leading[i] - next.trailing[i] );
+      }
+      else
+      {
+        uint8_t meaningful = HISTORY_VALUE_BITS - leading - trailing;
+        isFitting = writeBits( block, 0x03, 2 ) &&
+                    writeBits( block, leading, 4 ) &&
+                    writeBits( block, meaningful - 1, 4 ) &&
+                    writeBits( block, xored >> trailing, meaningful );
+        next.hasWindow[i] = true;
+        next.leading[i]   = leading;
+        next.trailing[i]  = trailing;
+      }
+    }
+  }
+
+  if ( false == isFitting )
+  {
+    block.header.bitLength = bitLength;
+    return false;
+  }
+  ++block.header.count;
+  codec = next;
+  return true;
+}
+
+//-- decodePoint -----------------------------------------------------------------------------------
+// pointIndex: 0 for the first point of the block
+static void decodePoint(const HistoryBlock &block, uint16_t pointIndex, uint16_t &position,
+                        HistoryCodec &codec, HistoryPoint &point)
+{
+  if ( 0 == pointIndex )
+  {
+    point.time = block.header.firstTime;
+    for ( uint8_t i = 0; i < HISTORY_VALUE_COUNT; ++i )
+    {
+      point.values[i] = readBits( block, position, HISTORY_VALUE_BITS );
+    }
+    resetCodec( codec, point );
+    return;
+  }
+
+  int32_t deltaOfDelta = 0;
+  if ( 0 != readBits( block, position, 1 ) )
+  {
+    uint8_t control = 1;
+    bool isDecoded = false;
+    for ( const DeltaRange &range : DELTA_RANGES )
+    {
+      control = ( control << 1 ) | readBits( block, position, 1 );
+      if ( range.control == control )
+      {
+        deltaOfDelta = range.minValue + static_cast<int32_t>( readBits( block, position, range.valueBits ) );
+        isDecoded = true;
+        break;
+      }
+    }
+    if ( false == isDecoded ) { deltaOfDelta = static_cast<int32_t>( readBits( block, position, 32 ) ); }
+  }
+  codec.delta += deltaOfDelta;
+  codec.time  += codec.delta;
+  point.time   = codec.time;
+
+  for ( uint8_t i = 0; i < HISTORY_VALUE_COUNT; ++i )
+  {
+    if ( 0 != readBits( block, position, 1 ) )
+    {
+      if ( 0 != readBits( block, position, 1 ) )
+      {
+        codec.hasWindow[i] = true;
+        codec.leading[i]   = readBits( block, position, 4 );
+        uint8_t meaningful = readBits( block, position, 4 ) + 1;
+        codec.trailing[i]  = HISTORY_VALUE_BITS - codec.leading[i] - meaningful;
+      }
+      uint8_t meaningful = HISTORY_VALUE_BITS - codec.leading[i] - codec.trailing[i];
+      codec.values[i] ^= readBits( block, position, meaningful ) << codec.trailing[i];
+    }
+    point.values[i] = codec.values[i];
+  }
+}
+
+//-- HistoryStore::open ----------------------------------------------------------------------------
+// The pending points are compressed into the block again, a new block is started without them
+bool HistoryStore::open()
+{
+  m_block = HistoryBlock();
+  m_codec = HistoryCodec();
+  if ( false == loadPendingPoints() )
+  {
+    m_block = HistoryBlock();
+    m_block.header.sequence = findNextSequence();
+  }
+  m_isOpen = true;
+  return true;
+}
+
+//-- HistoryStore::close ---------------------------------------------------------------------------
+void HistoryStore::close()
+{
+  m_isOpen = false;
+}
+
+//-- HistoryStore::loadPendingPoints ---------------------------------------------------------------
+// Returns false if there is no pending file or its block has already been appended to a segment
+// (a reset right after the block was written)
+bool HistoryStore::loadPendingPoints()
+{
+  File file = LittleFS.open( HISTORY_PENDING_FILENAME, "r" );
+  if ( false == file ) { return false; }
+
+  HistoryPendingHeader header;
+  HistoryPendingHeader fileHeader;
+  if ( sizeof( fileHeader ) != file.read( reinterpret_cast<uint8_t *>( &fileHeader ), sizeof( fileHeader ) ) ||
+       header.magic != fileHeader.magic || 0 == fileHeader.sequence || 
+       true == isBlockWritten( fileHeader.sequence ) )
+  {
+    file.close();
+    return false;
+  }
+
+  m_block.header.sequence = fileHeader.sequence;
+  HistoryPoint point;
+  while ( sizeof( point ) == file.read( reinterpret_cast<uint8_t *>( &point ), sizeof( point ) ) )
+  {
+    if ( false == encodePoint( m_block, m_codec, point ) ) { break; }
+  }
+  file.close();
+  return true;
+}
+
+//-- HistoryStore::isBlockWritten ------------------------------------------------------------------
+// The RTC cursor saves opening the segment
+bool HistoryStore::isBlockWritten(uint32_t sequence)
+{
+  RtcHistoryCursor cursor;
+  if ( true == loadRtcRecord( RTC_BLOCK_HISTORY_CURSOR, cursor ) ) { return sequence <= cursor.sequence; }
+
+  return ( sequence - 1 ) % HISTORY_SEGMENT_BLOCKS < countSegmentBlocks( getSegmentNumber( sequence ) );
+}
+
+//-- HistoryStore::findNextSequence ----------------------------------------------------------------
+// After the newest block of the segments
+uint32_t HistoryStore::findNextSequence()
+{
+  RtcHistoryCursor cursor;
+  if ( true == loadRtcRecord( RTC_BLOCK_HISTORY_CURSOR, cursor ) ) { return cursor.sequence + 1; }
+
+  uint32_t first = 0;
+  uint32_t last  = 0;
+  if ( false == findSegments( HISTORY_DIRECTORY, first, last ) ) { return 1; }
+  return last * HISTORY_SEGMENT_BLOCKS + countSegmentBlocks( last ) + 1;
+}
+
+//-- HistoryStore::append --------------------------------------------------------------------------
+bool HistoryStore::append(const HistoryPoint &point)
+{
+  if ( false == m_isOpen ) { return false; }
+
+  if ( true == encodePoint( m_block, m_codec, point ) ) { return appendPendingPoint( point ); }
+
+  // The block is full: it goes into the newest segment and the point starts the next block. If the
+  // block cannot be written, it stays pending and the point is dropped.
+  if ( false == appendBlock() ) { return false; }
+
+  uint32_t sequence = m_block.header.sequence + 1;
+  m_block = HistoryBlock();
+  m_block.header.sequence = sequence;
+  encodePoint( m_block, m_codec, point );
+  return appendPendingPoint( point );
+}
+
+//-- HistoryStore::appendBlock ---------------------------------------------------------------------
+// The first block of a segment creates the file and removes the oldest segment beyond
+// HISTORY_SEGMENT_COUNT
+bool HistoryStore::appendBlock()
+{
+  uint32_t sequence = m_block.header.sequence;
+  uint32_t segment  = getSegmentNumber( sequence );
+  bool isNewSegment = ( 0 == ( sequence - 1 ) % HISTORY_SEGMENT_BLOCKS );
+
+  char path[SEGMENT_PATH_MAX_LENGTH];
+  getSegmentPath( HISTORY_DIRECTORY, segment, path );
+  File file = LittleFS.open( path, ( true == isNewSegment ? "w" : "a" ) );
+  bool isWritten = ( true == file );
+  if ( true == isWritten && 0 == file.size() )
+  {
+    HistorySegmentHeader header;
+    isWritten = ( sizeof( header ) == file.write( reinterpret_cast<const uint8_t *>( &header ), sizeof( header ) ) );
+  }
+
+  m_block.header.crc = calculateBlockCrc( m_block );
+  isWritten = isWritten && sizeof( m_block ) == file.write( reinterpret_cast<const uint8_t *>( &m_block ), sizeof( m_block ) );
+  if ( true == file ) { file.close(); }
+  if ( false == isWritten )
+  {
+    SERIAL_PLN("History: block write failed.");
+    clearRtcRecord<RtcHistoryCursor>( RTC_BLOCK_HISTORY_CURSOR );
+    return false;
+  }
+
+  if ( true == isNewSegment && HISTORY_SEGMENT_COUNT <= segment )
+  {
+    removeSegments( HISTORY_DIRECTORY, segment - HISTORY_SEGMENT_COUNT + 1 );
+  }
+
+  RtcHistoryCursor cursor;
+  cursor.sequence = sequence;
+  return saveRtcRecord( RTC_BLOCK_HISTORY_CURSOR, cursor );
+}
+
+//-- HistoryStore::appendPendingPoint --------------------------------------------------------------
+// The first point of a block starts a new pending file
+bool HistoryStore::appendPendingPoint(const HistoryPoint &point)
+{
+  bool isFirst = ( 1 == m_block.header.count );
+  File file = LittleFS.open( HISTORY_PENDING_FILENAME, ( true == isFirst ? "w" : "a" ) );
+  bool isWritten = ( true == file );
+  if ( true == isWritten && true == isFirst )
+  {
+    HistoryPendingHeader header;
+    header.sequence = m_block.header.sequence;
+    isWritten = ( sizeof( header ) == file.write( reinterpret_cast<const uint8_t *>( &header ), sizeof( header ) ) );
+  }
+
+  isWritten = isWritten && sizeof( point ) == file.write( reinterpret_cast<const uint8_t *>( &point ), sizeof( point ) );
+  if ( true == file ) { file.close(); }
+  if ( false == isWritten ) { SERIAL_PLN("History: pending point write failed."); }
+  return isWritten;
+}
+
+//-- HistoryReader::begin --------------------------------------------------------------------------
+bool HistoryReader::begin(uint32_t from, uint32_t to)
+{
+  m_from = from;
+  m_to   = to;
+  m_block = HistoryBlock();
+  m_pointIndex    = 0;
+  m_lastSequence  = 0;
+  m_isPendingFile = false;
+
+  m_hasSegments = findSegments( HISTORY_DIRECTORY, m_segment, m_lastSegment );
+  return true == m_hasSegments || true == LittleFS.exists( HISTORY_PENDING_FILENAME );
+}
+
+//-- HistoryReader::next ---------------------------------------------------------------------------
+bool HistoryReader::next(HistoryPoint &point)
+{
+  while ( true )
+  {
+    if ( m_pointIndex < m_block.header.count ) 
+    { 
+      decodePoint( m_block, m_pointIndex++, m_bitPosition, m_codec, point ); 
+    }
+    else if ( true == loadNextBlock() ) 
+    { 
+      continue; 
+    }
+    else if ( false == readPendingPoint( point ) ) 
+    { 
+      return false; 
+    }
+
+    // The wall clock may have been stepped back (e.g. a wrong Date header corrected by SNTP), so
+    // the points are not assumed to be in time order: the ones out of the range are skipped
+    if ( m_from <= point.time && point.time <= m_to ) { return true; }
+  }
+}
+
+//-- HistoryReader::end ----------------------------------------------------------------------------
+void HistoryReader::end()
+{
+  if ( true == m_file ) { m_file.close(); }
+}
+
+//-- HistoryReader::loadNextBlock ------------------------------------------------------------------
+// The segments in the order of their numbers, the empty and the corrupted blocks are skipped
+bool HistoryReader::loadNextBlock()
+{
+  while ( false == m_isPendingFile )
+  {
+    if ( true == m_file )
+    {
+      if ( sizeof( m_block ) == m_file.read( reinterpret_cast<uint8_t *>( &m_block ), sizeof( m_block ) ) )
+      {
+        if ( calculateBlockCrc( m_block ) != m_block.header.crc )
+        {
+          SERIAL_PF("History: block %u is corrupted, it is skipped.\n", static_cast<unsigned>( m_block.header.sequence ));
+          continue;
+        }
+        m_lastSequence = std::max( m_lastSequence, m_block.header.sequence );
+        m_pointIndex   = 0;
+        m_bitPosition  = 0;
+        if ( 0 < m_block.header.count ) { return true; }
+        continue;
+      }
+      m_file.close();
+    }
+
+    if ( false == m_hasSegments || m_lastSegment < m_segment ) { break; }
+    openSegment( m_segment++, m_file );
+  }
+  m_block.header.count = 0;
+  return false;
+}
+
+//-- HistoryReader::readPendingPoint ---------------------------------------------------------------
+// The points of a block which has already been appended to a segment are not read again
+bool HistoryReader::readPendingPoint(HistoryPoint &point)
+{
+  if ( false == m_isPendingFile )
+  {
+    m_isPendingFile = true;
+    m_file = LittleFS.open( HISTORY_PENDING_FILENAME, "r" );
+
+    HistoryPendingHeader header;
+    HistoryPendingHeader fileHeader;
+    if ( true == m_file && 
+         ( sizeof( fileHeader ) != m_file.read( reinterpret_cast<uint8_t *>( &fileHeader ), sizeof( fileHeader ) ) ||
+           header.magic != fileHeader.magic || fileHeader.sequence <= m_lastSequence ) )
+    {
+      m_file.close();
+    }
+  }
+  return true == m_file && sizeof( point ) == m_file.read( reinterpret_cast<uint8_t *>( &point ), sizeof( point ) );
+}
+
+//-- HISTORY API -----------------------------------------------------------------------------------
+const char     HISTORY_CSV_HEADER[]     = "time,temperature,humidity,pressure,battery\n";
+const uint8_t  HISTORY_CSV_LINE_LENGTH  = 64;
+
+//-- HistoryResponse: the state of a streamed response
+struct HistoryResponse
+{
+  HistoryReader reader;
+  char   line[HISTORY_CSV_LINE_LENGTH] = { 0 };
+  size_t lineLength   = 0;
+  size_t linePosition = 0;
+  bool   isFinished   = false;
+
+  ~HistoryResponse() { reader.end(); }
+
+  //-- fill: the next part of the CSV, 0 at the end
+  size_t fill(uint8_t *buffer, size_t maxLen)
+  {
+    size_t length = 0;
+    while ( length < maxLen )
+    {
+      if ( lineLength <= linePosition )
+      {
+        HistoryPoint point;
+        if ( true == isFinished || false == reader.next( point ) )
+        {
+          isFinished = true;
+          break;
+        }
+        // The sign is printed separately, the integer part of -0.5 is 0
+        int temperature = static_cast<int16_t>( point.values[HISTORY_VALUE_TEMPERATURE] );
+        int written = snprintf( line, sizeof( line ), "%u,%s%d.%02d,%u.%02u,%u.%u,%u\n",
+          static_cast<unsigned>( point.time ),
+          ( 0 > temperature ? "-" : "" ), abs( temperature ) / 100, abs( temperature ) % 100,
+          point.values[HISTORY_VALUE_HUMIDITY] / 100, point.values[HISTORY_VALUE_HUMIDITY] % 100,
+          point.values[HISTORY_VALUE_PRESSURE] / 10,  point.values[HISTORY_VALUE_PRESSURE] % 10,
+          point.values[HISTORY_VALUE_BATTERY] );
+        lineLength   = std::min( static_cast<size_t>( written ), sizeof( line ) - 1 );
+        linePosition = 0;
+      }
+
+      size_t part = std::min( lineLength - linePosition, maxLen - length );
+      memcpy( buffer + length, line + linePosition, part );
+      linePosition += part;
+      length       += part;
+    }
+    return length;
+  }
+};
+
+//-- getTimeParam ----------------------------------------------------------------------------------
+static uint32_t getTimeParam(AsyncWebServerRequest *request, const char *name, uint32_t defaultValue)
+{
+  AsyncWebParameter *param = request->getParam( name );
+  return ( nullptr == param ? defaultValue : strtoul( param->value().c_str(), nullptr, 10 ) );
+}
+
+//-- beginHistoryApi -------------------------------------------------------------------------------
+void sensor::beginHistoryApi(AsyncWebServer &server)
+{
+  server.on( HISTORY_API_URI, HTTP_GET, [](AsyncWebServerRequest *request)
+  {
+    std::shared_ptr<HistoryResponse> response = std::make_shared<HistoryResponse>();
+    if ( false == response->reader.begin( getTimeParam( request, "from", 0 ), getTimeParam( request, "to", UINT32_MAX ) ) )
+    {
+      request->send( 404, "text/plain", "No history." );
+      return;
+    }
+    memcpy( response->line, HISTORY_CSV_HEADER, sizeof( HISTORY_CSV_HEADER ) - 1 );
+    response->lineLength = sizeof( HISTORY_CSV_HEADER ) - 1;
+
+    // The response keeps the reader (and its file) until the last part has been sent
+    request->send( request->beginChunkedResponse( "text/csv",
+      [response](uint8_t *buffer, size_t maxLen, size_t) -> size_t { return response->fill( buffer, maxLen ); } ) );
+  } );
+}
@@ -0,0 +1,135 @@
+#ifndef __HISTORY_STORE_H__
+#define __HISTORY_STORE_H__
+
+#include <Arduino.h>
+#include <FS.h>
+
+class AsyncWebServer;
+
+namespace sensor
+{
+
+//-- HISTORY STORE ---------------------------------------------------------------------------------
+// Long local history of the readings in fixed-size blocks, appended to segment files (see
+// segment_file.h). The points of a block are compressed like in Gorilla (Facebook's time series
+// database): the time stamps as delta-of-delta, the values XOR-ed with the previous ones. A regular
+// reading costs about 3-4 bytes, about 70 of them fit into a block. So the 16 segments of 16 blocks
+// of 256 bytes hold about 17000 readings: five weeks of 3-minute readings. When a new segment is
+// started, the oldest one is removed.
+// The points of the block being filled are appended uncompressed to the pending file. When the
+// block is full, it is compressed from them and appended to the newest segment in one write.
+const char     HISTORY_DIRECTORY[]        = "/history/";
+const char     HISTORY_PENDING_FILENAME[] = "/history/pending.bin";
+const uint32_t HISTORY_MAGIC          = 0x48495354; // "TSIH"
+const uint16_t HISTORY_VERSION        = 2;
+const uint16_t HISTORY_BLOCK_SIZE     = 256;
+const uint16_t HISTORY_SEGMENT_BLOCKS = 16; // 4 KB segment files
+const uint16_t HISTORY_SEGMENT_COUNT  = 16;
+
+const char HISTORY_API_URI[] = "/api/history";
+
+//-- HistoryPoint: the units of RtcReading
+enum HistoryValue : uint8_t
+{
+  HISTORY_VALUE_TEMPERATURE = 0, // 1/100 oC, int16_t
+  HISTORY_VALUE_HUMIDITY,        // 1/100 %
+  HISTORY_VALUE_PRESSURE,        // 1/10 hPa
+  HISTORY_VALUE_BATTERY,         // %
+  HISTORY_VALUE_COUNT
+};
+
+struct HistoryPoint
+{
+  uint32_t time = 0; // epoch seconds
+  uint16_t values[HISTORY_VALUE_COUNT] = { 0 };
+};
+
+//-- Header of a block, the compressed points follow it
+struct HistoryBlockHeader
+{
+  uint32_t sequence  = 0; // 0 - empty, it increases with every new block
+  uint32_t firstTime = 0; // time stamp of the first point
+  uint16_t count     = 0; // number of points
+  uint16_t bitLength = 0; // of the compressed points
+  uint32_t crc       = 0; // CRC32 of the header (without the crc) and the data
+};
+
+const uint16_t HISTORY_BLOCK_DATA_SIZE = HISTORY_BLOCK_SIZE - sizeof( HistoryBlockHeader );
+
+struct HistoryBlock
+{
+  HistoryBlockHeader header;
+  uint8_t data[HISTORY_BLOCK_DATA_SIZE] = { 0 };
+};
+
+//-- State of the compression, the same for the encoder and the decoder
+struct HistoryCodec
+{
+  uint32_t time  = 0;
+  int32_t  delta = 0;
+  uint16_t values[HISTORY_VALUE_COUNT] = { 0 };
+  uint8_t  leading[HISTORY_VALUE_COUNT]  = { 0 }; // window of the last XOR with meaningful bits
+  uint8_t  trailing[HISTORY_VALUE_COUNT] = { 0 };
+  bool     hasWindow[HISTORY_VALUE_COUNT] = { false };
+};
+
+//-- HistoryStore ----------------------------------------------------------------------------------
+// Appends the points to the newest block. LittleFS must be mounted.
+class HistoryStore
+{
+public:
+  //-- open: loads the pending points of the newest block
+  bool open();
+  void close();
+
+  //-- append: the compression is best for regular intervals, a time stamp may still go backwards
+  bool append(const HistoryPoint &point);
+
+private:
+  bool loadPendingPoints();
+  bool isBlockWritten(uint32_t sequence);
+  uint32_t findNextSequence();
+  bool appendBlock();
+  bool appendPendingPoint(const HistoryPoint &point);
+
+  HistoryBlock m_block;          // the block being filled, the points are in the pending file
+  HistoryCodec m_codec;          // after the last point of m_block
+  bool         m_isOpen = false;
+};
+
+//-- HistoryReader ---------------------------------------------------------------------------------
+// Decodes the points from the oldest to the newest: the blocks of the segments, then the pending
+// points
+class HistoryReader
+{
+public:
+  //-- begin: the points of [from, to] are returned, false if there is no history
+  bool begin(uint32_t from, uint32_t to);
+  bool next(HistoryPoint &point);
+  void end();
+
+private:
+  bool loadNextBlock();
+  bool readPendingPoint(HistoryPoint &point);
+
+  File         m_file;           // the segment being read, then the pending file
+  HistoryBlock m_block;
+  HistoryCodec m_codec;
+  uint32_t     m_from = 0;
+  uint32_t     m_to   = 0;
+  uint32_t     m_segment      = 0; // the next segment to open
+  uint32_t     m_lastSegment  = 0;
+  uint32_t     m_lastSequence = 0; // of the blocks read, older pending points are not read
+  bool         m_hasSegments    = false;
+  bool         m_isPendingFile  = false;
+  uint16_t     m_pointIndex   = 0;
+  uint16_t     m_bitPosition  = 0;
+};
+
+//-- beginHistoryApi -------------------------------------------------------------------------------
+// GET /api/history?from=<epoch>&to=<epoch>: the points as CSV, streamed while they are decoded
+void beginHistoryApi(AsyncWebServer &server);
+
+}; // namespace
+
+#endif // __HISTORY_STORE_H__
@@ -0,0 +1,188 @@
+#include "http_request_writer.h"
+#include "gzip_stream.h"
+
+#include <GSiDebug.h>
+
+using namespace sensor;
+
+//-- HttpRequestHeader::build ----------------------------------------------------------------------
+bool HttpRequestHeader::build(const char *serverAddress, const char *path, const char *org, 
+                              const char *bucket, const char *authToken)
+{
+  int length = snprintf( m_text, sizeof( m_text ),
+    "POST %s&org=%s&bucket=%s HTTP/1.1\r\n"
+    "Host: %s\r\n"
+    "User-Agent: ESP8266 Sensor Agent\r\n"
+    "Connection: close\r\n"
+    "Authorization: Token %s\r\n",
+    path, org, bucket, serverAddress, authToken );
+
+  if ( 0 > length || sizeof( m_text ) <= static_cast<size_t>( length ) )
+  {
+    SERIAL_PLN("HTTP request header is too long.");
+    m_text[0] = 0;
+    m_length  = 0;
+    return false;
+  }
+  m_length = length;
+  return true;
+}
+
+//-- HttpRequestWriter::writePost ------------------------------------------------------------------
+size_t HttpRequestWriter::writePost(const HttpRequestHeader &header, HttpBodyWriter bodyWriter, 
+                                    const void *context)
+{
+  LengthCounter bodyLength;
+  bodyWriter( bodyLength, context );
+
+  reset();
+
+  char contentLength[32] = { 0 };
+  int length = snprintf( contentLength, sizeof( contentLength ), "Content-Length: %u\r\n\r\n", 
+                         static_cast<unsigned>( bodyLength.length() ) );
+
+  write( header.c_str(), header.length() );
+  write( contentLength, length );
+  bodyWriter( *this, context );
+  sendBuffer();
+
+  return ( true == m_hasFailed ? 0 : m_sent );
+}
+
+//-- HttpRequestWriter::writePostChunked -----------------------------------------------------------
+size_t HttpRequestWriter::writePostChunked(const HttpRequestHeader &header, HttpBodyWriter bodyWriter, 
+                                           const void *context, bool isCompressed /* false */)
+{
+  const char CONTENT_ENCODING[]  = "Content-Encoding: gzip\r\n";
+  const char TRANSFER_ENCODING[] = "Transfer-Encoding: chunked\r\n\r\n";
+  const char LAST_CHUNK[]        = "0\r\n\r\n";
+
+  reset();
+
+  GzipStream gzip;
+  if ( true == isCompressed && false == gzip.begin( *this ) )
+  {
+    SERIAL_PLN("Not enough heap for the compression, the body is sent uncompressed.");
+    isCompressed = false;
+  }
+
+  write( header.c_str(), header.length() );
+  if ( true == isCompressed ) { write( CONTENT_ENCODING, sizeof( CONTENT_ENCODING ) - 1 ); }
+  write( TRANSFER_ENCODING, sizeof( TRANSFER_ENCODING ) - 1 );
+  sendBuffer();
+
+  setChunked( true );
+  if ( true == isCompressed )
+  {
+    bodyWriter( gzip, context );
+    gzip.end();
+  }
+  else
+  {
+    bodyWriter( *this, context );
+  }
+  sendBuffer();
+  setChunked( false );
+
+  write( LAST_CHUNK, sizeof( LAST_CHUNK ) - 1 );
+  sendBuffer();
+
+  return ( true == m_hasFailed ? 0 : m_sent );
+}
+
+//-- HttpRequestWriter::write ----------------------------------------------------------------------
+size_t HttpRequestWriter::write(const uint8_t *data, size_t size)
+{
+  size_t capacity = sizeof( m_buffer ) - ( true == m_isChunked ? HTTP_CHUNK_SUFFIX_SIZE : 0 );
+  size_t left = size;
+  while ( false == m_hasFailed && 0 < left )
+  {
+    size_t part = std::min( left, capacity - m_used );
+    memcpy( m_buffer + m_used, data, part );
+    m_used += part;
+    data   += part;
+    left   -= part;
+
+    if ( capacity == m_used ) { sendBuffer(); }
+  }
+  return ( true == m_hasFailed ? 0 : size );
+}
+
+//-- HttpRequestWriter::reset ----------------------------------------------------------------------
+void HttpRequestWriter::reset()
+{
+  m_used = 0;
+  m_sent = 0;
+  m_hasFailed = false;
+  m_isChunked = false;
+}
+
+//-- HttpRequestWriter::setChunked -----------------------------------------------------------------
+// The buffer must be empty
+void HttpRequestWriter::setChunked(bool isChunked)
+{
+  m_isChunked = isChunked;
+  m_used = ( true == isChunked ? HTTP_CHUNK_PREFIX_SIZE : 0 );
+}
+
+//-- HttpRequestWriter::sendBuffer -----------------------------------------------------------------
+// In chunked mode the chunk size is written right-aligned in front of the data and the chunk is
+// sent in one piece with its framing
+void HttpRequestWriter::sendBuffer()
+{
+  size_t start = ( true == m_isChunked ? HTTP_CHUNK_PREFIX_SIZE : 0 );
+  if ( true == m_hasFailed || start == m_used ) { return; }
+
+  if ( true == m_isChunked )
+  {
+    char chunkSize[HTTP_CHUNK_PREFIX_SIZE + 1] = { 0 };
+    int length = snprintf( chunkSize, sizeof( chunkSize ), "%x\r\n", static_cast<unsigned>( m_used - start ) );
+    start -= length;
+    memcpy( m_buffer + start, chunkSize, length );
+    m_buffer[m_used++] = '\r';
+    m_buffer[m_used++] = '\n';
+  }
+
+  size_t size    = m_used - start;
+  size_t written = m_out.write( m_buffer + start, size );
+  m_sent += written;
+  if ( written != size )
+  {
+    SERIAL_PF("HTTP write failed: %u of %u bytes sent\n", static_cast<unsigned>( written ), 
+              static_cast<unsigned>( size ) );
+    m_hasFailed = true;
+  }
+  m_used = ( true == m_isChunked ? HTTP_CHUNK_PREFIX_SIZE : 0 );
+}
+
+//-- parseHttpDate ---------------------------------------------------------------------------------
+// The days are counted from the civil date like in Howard Hinnant's days_from_civil
+bool sensor::parseHttpDate(const char *value, uint32_t &epoch)
+{
+  const char MONTHS[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+  int  day = 0, year = 0, hour = 0, minute = 0, second = 0;
+  int  length = 0; // sscanf counts the conversions only, the zone is checked by the parsed length
+  char monthName[4] = { 0 };
+  if ( 6 != sscanf( value, "%*3s, %2d %3s %4d %2d:%2d:%2d GMT%n", &day, monthName, &year, &hour, &minute, &second, &length ) ||
+       0 == length ) 
+  { 
+    return false; 
+  }
+
+  const char *monthPosition = strstr( MONTHS, monthName );
+  if ( 3 != strlen( monthName ) || nullptr == monthPosition || 0 != ( monthPosition - MONTHS ) % 3 ) { return false; }
+  int month = ( monthPosition - MONTHS ) / 3 + 1;
+  if ( 1970 > year || 1 > day || 31 < day || 23 < hour || 59 < minute || 60 < second ) { return false; }
+
+  // March based year, so the leap day is the last day of the year
+  year -= ( 2 >= month ? 1 : 0 );
+  int32_t  era       = year / 400;
+  uint32_t yearOfEra = year - era * 400;
+  uint32_t dayOfYear = ( 153 * ( month + ( 2 < month ? -3 : 9 ) ) + 2 ) / 5 + day - 1;
+  uint32_t dayOfEra  = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  int32_t  days      = era * 146097 + static_cast<int32_t>( dayOfEra ) - 719468;
+
+  epoch = static_cast<uint32_t>( days ) * 86400 + hour * 3600 + minute * 60 + second;
+  return true;
+}
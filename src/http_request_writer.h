@@ -0,0 +1,98 @@
+#ifndef __HTTP_REQUEST_WRITER_H__
+#define __HTTP_REQUEST_WRITER_H__
+
+#include <Arduino.h>
+
+namespace sensor
+{
+
+const size_t HTTP_HEADER_MAX_LENGTH = 768; // the server address and the token can be 255 characters
+const size_t HTTP_WRITE_CHUNK_SIZE  = 512; // one TLS record with the reduced-footprint profile
+
+// Framing of Transfer-Encoding: chunked, it is written into the same buffer as the data
+const size_t HTTP_CHUNK_PREFIX_SIZE = 5; // "1f9\r\n": 3 hex digits for HTTP_WRITE_CHUNK_SIZE
+const size_t HTTP_CHUNK_SUFFIX_SIZE = 2; // "\r\n"
+
+//-- HttpRequestHeader -----------------------------------------------------------------------------
+// The constant part of the upload request (request line, Host, Authorization, ...). It depends on
+// the config only, so it is built once and reused by the uploads.
+class HttpRequestHeader
+{
+public:
+  //-- build: returns false if the header does not fit into the buffer
+  bool build(const char *serverAddress, const char *path, const char *org, const char *bucket, 
+             const char *authToken);
+
+  bool isBuilt() const { return 0 < m_length; }
+  const char *c_str() const { return m_text; }
+  size_t length() const { return m_length; }
+
+private:
+  char   m_text[HTTP_HEADER_MAX_LENGTH] = { 0 };
+  size_t m_length = 0;
+};
+
+//-- HttpBodyWriter --------------------------------------------------------------------------------
+// Prints the body of a request. writePost() calls it twice, first for the Content-Length, so it must
+// print the same bytes both times. writePostChunked() calls it once.
+typedef void (*HttpBodyWriter)(Print &out, const void *context);
+
+//-- LengthCounter ---------------------------------------------------------------------------------
+// Counts the printed bytes without storing them
+class LengthCounter : public Print
+{
+public:
+  using Print::write;
+  size_t write(uint8_t) override { ++m_length; return 1; }
+  size_t write(const uint8_t *, size_t size) override { m_length += size; return size; }
+
+  size_t length() const { return m_length; }
+
+private:
+  size_t m_length = 0;
+};
+
+//-- HttpRequestWriter -----------------------------------------------------------------------------
+// Streams a POST request to the client through a fixed buffer, nothing is allocated on the heap.
+// The client gets the request in HTTP_WRITE_CHUNK_SIZE pieces, as BearSSL::WiFiClientSecure sends
+// a TLS record for every write() call. In chunked mode every piece is one HTTP chunk.
+class HttpRequestWriter : public Print
+{
+public:
+  explicit HttpRequestWriter(Print &out): m_out(out) {}
+
+  //-- writePost: header, Content-Length and body
+  //   returns the number of bytes sent, 0 if the client failed
+  size_t writePost(const HttpRequestHeader &header, HttpBodyWriter bodyWriter, const void *context);
+
+  //-- writePostChunked: header and the body with Transfer-Encoding: chunked. The body is printed
+  //   only once, for the bodies which are expensive to print (e.g. read from a file).
+  //   isCompressed: the body is sent with Content-Encoding: gzip, it is sent uncompressed if the
+  //   window of the compressor cannot be allocated
+  size_t writePostChunked(const HttpRequestHeader &header, HttpBodyWriter bodyWriter, const void *context,
+                          bool isCompressed = false);
+
+  using Print::write;
+  size_t write(uint8_t c) override { return write( &c, 1 ); }
+  size_t write(const uint8_t *data, size_t size) override;
+
+private:
+  void reset();
+  void setChunked(bool isChunked);
+  void sendBuffer();
+
+  Print   &m_out;
+  uint8_t  m_buffer[HTTP_WRITE_CHUNK_SIZE];
+  size_t   m_used = 0;
+  size_t   m_sent = 0;
+  bool     m_hasFailed = false;
+  bool     m_isChunked = false; // the data starts after HTTP_CHUNK_PREFIX_SIZE
+};
+
+//-- parseHttpDate ---------------------------------------------------------------------------------
+// The value of the Date header (IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT") as epoch seconds
+bool parseHttpDate(const char *value, uint32_t &epoch);
+
+}; // namespace
+
+#endif // __HTTP_REQUEST_WRITER_H__
@@ -0,0 +1,58 @@
+#include "line_protocol.h"
+
+using namespace sensor;
+
+//-- printLineName ---------------------------------------------------------------------------------
+size_t sensor::printLineName(Print &out, const char *name, bool isKey)
+{
+  size_t length = 0;
+  for ( const char *c = name; 0 != *c; ++c )
+  {
+    if ( ',' == *c || ' ' == *c || ( true == isKey && '=' == *c ) ) { length += out.write( '\\' ); }
+    length += out.write( *c );
+  }
+  return length;
+}
+
+//-- printUnsigned ---------------------------------------------------------------------------------
+size_t sensor::printUnsigned(Print &out, uint32_t value)
+{
+  char text[10]; // 4294967295
+  uint8_t start = sizeof( text );
+  do
+  {
+    text[--start] = '0' + value % 10;
+    value /= 10;
+  } while ( 0 != value );
+
+  return out.write( text + start, sizeof( text ) - start );
+}
+
+//-- printFixed ------------------------------------------------------------------------------------
+size_t sensor::printFixed(Print &out, int32_t value, uint8_t decimals)
+{
+  size_t length = 0;
+  // INT32_MIN is LINE_VALUE_MISSING, the negation cannot overflow
+  uint32_t magnitude = static_cast<uint32_t>( value );
+  if ( 0 > value )
+  {
+    length += out.write( '-' );
+    magnitude = static_cast<uint32_t>( -value );
+  }
+  if ( 0 == decimals ) { return length + printUnsigned( out, magnitude ); }
+
+  uint32_t scale = 1;
+  for ( uint8_t i = 0; i < decimals; ++i ) { scale *= 10; }
+
+  length += printUnsigned( out, magnitude / scale );
+  length += out.write( '.' );
+
+  char fraction[9];
+  uint32_t rest = magnitude % scale;
+  for ( uint8_t i = decimals; 0 < i; --i )
+  {
+    fraction[i - 1] = '0' + rest % 10;
+    rest /= 10;
+  }
+  return length + out.write( fraction, decimals );
+}
@@ -0,0 +1,122 @@
+#ifndef __LINE_PROTOCOL_H__
+#define __LINE_PROTOCOL_H__
+
+#include <Arduino.h>
+
+namespace sensor
+{
+
+//-- INFLUXDB LINE PROTOCOL ------------------------------------------------------------------------
+// <measurement>[,<tag key>=<tag value>...] <field key>=<field value>[,...] [<time stamp>]\n
+// The tag and field keys of a measurement are declared at compile time in a LineSchema, a point
+// only carries the values. Numbers are printed from fixed point integers, no float formatting.
+
+enum LineFieldType : uint8_t
+{
+  LINE_FIELD_FIXED   = 0, // decimal number, the value is multiplied by 10^decimals
+  LINE_FIELD_INTEGER = 1, // integer with the 'i' suffix
+};
+
+struct LineField
+{
+  const char    *key;
+  LineFieldType  type;
+  uint8_t        decimals; // LINE_FIELD_FIXED only, 0 - 9
+};
+
+// A field with this value is left out of the line
+const int32_t LINE_VALUE_MISSING = INT32_MIN;
+
+template <size_t TAG_COUNT, size_t FIELD_COUNT>
+struct LineSchema
+{
+  const char *tagKeys[TAG_COUNT];
+  LineField   fields[FIELD_COUNT];
+};
+
+template <size_t TAG_COUNT, size_t FIELD_COUNT>
+struct LinePoint
+{
+  const char *tagValues[TAG_COUNT] = { 0 }; // empty tags are left out
+  int32_t     fieldValues[FIELD_COUNT];
+  uint32_t    timeStamp = 0; // s, 0 - the server sets the time
+
+  LinePoint() { for ( size_t i = 0; i < FIELD_COUNT; ++i ) { fieldValues[i] = LINE_VALUE_MISSING; } }
+};
+
+//-- printLineName ---------------------------------------------------------------------------------
+// Escapes the commas and the spaces, and the equal signs too if isKey is set (tag keys, tag values
+// and field keys). The measurement name is printed with isKey false.
+size_t printLineName(Print &out, const char *name, bool isKey);
+
+//-- printFixed ------------------------------------------------------------------------------------
+// e.g. value 2153, decimals 2 => "21.53"
+size_t printFixed(Print &out, int32_t value, uint8_t decimals);
+
+//-- printUnsigned ---------------------------------------------------------------------------------
+size_t printUnsigned(Print &out, uint32_t value);
+
+//-- encodeLine ------------------------------------------------------------------------------------
+// Prints one point, the line is closed by '\n'. At least one field must be set, otherwise the line
+// is invalid. measurementSuffix is appended to the measurement name (e.g. "Health"), it can be NULL.
+template <size_t TAG_COUNT, size_t FIELD_COUNT>
+size_t encodeLine(Print &out, const char *measurement, const char *measurementSuffix,
+                  const LineSchema<TAG_COUNT, FIELD_COUNT> &schema, 
+                  const LinePoint<TAG_COUNT, FIELD_COUNT> &point)
+{
+  size_t length = printLineName( out, measurement, false );
+  if ( NULL != measurementSuffix ) { length += printLineName( out, measurementSuffix, false ); }
+
+  for ( size_t i = 0; i < TAG_COUNT; ++i )
+  {
+    if ( NULL == point.tagValues[i] || 0 == point.tagValues[i][0] ) { continue; }
+
+    length += out.write( ',' );
+    length += printLineName( out, schema.tagKeys[i], true );
+    length += out.write( '=' );
+    length += printLineName( out, point.tagValues[i], true );
+  }
+
+  char separator = ' ';
+  for ( size_t i = 0; i < FIELD_COUNT; ++i )
+  {
+    if ( LINE_VALUE_MISSING == point.fieldValues[i] ) { continue; }
+
+    length += out.write( separator );
+    separator = ',';
+    length += printLineName( out, schema.fields[i].key, true );
+    length += out.write( '=' );
+    if ( LINE_FIELD_INTEGER == schema.fields[i].type )
+    {
+      length += printFixed( out, point.fieldValues[i], 0 );
+      length += out.write( 'i' );
+    }
+    else
+    {
+      length += printFixed( out, point.fieldValues[i], schema.fields[i].decimals );
+    }
+  }
+
+  if ( 0 != point.timeStamp )
+  {
+    length += out.write( ' ' );
+    length += printUnsigned( out, point.timeStamp );
+  }
+  length += out.write( '\n' );
+  return length;
+}
+
+//-- encodeLines -----------------------------------------------------------------------------------
+// Multi-point body, one line per point
+template <size_t TAG_COUNT, size_t FIELD_COUNT>
+size_t encodeLines(Print &out, const char *measurement, const LineSchema<TAG_COUNT, FIELD_COUNT> &schema, 
+                   const LinePoint<TAG_COUNT, FIELD_COUNT> *points, size_t count)
+{
+  size_t length = 0;
+  for ( size_t i = 0; i < count; ++i ) { length += encodeLine( out, measurement, NULL, schema, points[i] ); }
+  return length;
+}
+
+}; // namespace
+
+#endif // __LINE_PROTOCOL_H__
@@ -31,9 +31,11 @@ Office or Home devices
 #include <pins_arduino.h>
 
 //-- Network and web server
+#include <time.h>
 #include <ESP8266mDNS.h>
 #include <ESP8266WiFi.h>
-#include <ESP8266WebServer.h>
+#include <WiFiUdp.h>
+#include <ESPAsyncWebServer.h>
 
 //-- Sensor related
 #define SENSOR_BME280
@@ -66,9 +68,45 @@ Office or Home devices
 #include "sensor_ini_file_storage.h"
 
 #include "web_config_management.h"
+#include "rtc_memory_storage.h"
+#include "wake_timing.h"
+#include "tls_session_cache.h"
+#include "tls_profile.h"
+#include "http_request_writer.h"
+#include "line_protocol.h"
+#include "config_schema.h"
+#include "config_flash_cache.h"
+#include "telemetry_stream.h"
+#include "history_store.h"
+#include "upload_backlog.h"
+#include "battery_governor.h"
+#include "udp_line_sender.h"
 
 sensor::SensorIniFileStorage g_iniStorage;
 sensor::WebConfigManagement g_webConfMan;
+sensor::TelemetryStream g_telemetry;
+sensor::HistoryStore g_historyStore;
+sensor::UploadBacklog g_uploadBacklog;
+
+//-- WiFi fast reconnect cache, kept in the RTC memory between deep sleeps
+sensor::RtcWiFiCache g_wifiCache;
+bool g_isWiFiCacheValid = false;
+
+//-- Readings collected in the RTC memory in buffered mode (batching and send-on-delta)
+sensor::RtcReadingBuffer g_readingBuffer;
+bool g_isBufferedMode  = false;
+bool g_isRadioOffWake  = false; // this wake-up was programmed with WAKE_RF_DISABLED
+
+//-- Sleep interval and radio use of the sensor mode, planned from the battery level
+sensor::Cadence g_cadence;
+
+//-- Phase timing of the wake-up, the previous one is reported as a health measurement
+sensor::WakeTimer g_wakeTimer;
+sensor::RtcWakeTiming g_prevWakeTiming;
+bool g_isPrevWakeTimingValid = false;
+
+//-- The constant part of the upload request, built once after the config has been read
+sensor::HttpRequestHeader g_requestHeader;
 
 //-- WatchDog to avoid infinite data sending
 #include <Ticker.h>
@@ -135,6 +173,7 @@ U8G2_PCD8544_84X48_1_4W_SW_SPI  u8g2(U8G2_R2, PIN_CLOCK, PIN_DATA, PIN_CS, PIN_D
 //-- To store different sensor values
 float g_temp(0), g_hum(0), g_pres(0);
   int16_t g_battery = 100;
+  int16_t g_batteryAdc = 0; // the raw A0 value of g_battery
 
   uint64_t g_timeStamp = 0;
   char g_txTemprD[4] = "-00";
@@ -149,8 +188,11 @@ struct DataReportValues //-- keeps the collection of the data to report
   float humid = 0.0;
   float press = 0.0;
   int16_t battery = 100;
+  uint32_t cadence = 0; // s, the sleep interval of the battery governor
   uint64_t timeStamp = 0;
+  time_t epoch = 0; // wall clock of the reading, 0 - the server stamps it
   // uptime is calculated on the fly by the influx::submitData function
+  const sensor::RtcWakeTiming *wakeTiming = NULL; // reported as a health measurement, if set
 
   DataReportValues(const char *deviceId, const char* location);
 };
@@ -191,6 +233,7 @@ const uint8_t MASK_ICON_CLEAR = 0;
 //-- FORWARD DECLARATIONS --------------------------------------------------------------------------
 void screenV2();
 void drawScreen();
+void loadWallClock();
 void handleTickerUploadTimeout();
 
 //-- NETWORK RELATED -------------------------------------------------------------------------------
@@ -201,6 +244,7 @@ const uint8_t SCREEN_UPDATE_TIME = 54; // 54 ms
 
 //-- Global variables ------------------------------------------------------------------------------
 bool g_isInSetupMode = false;
+bool g_isFsMounted = false;
 Ticker g_uploadTimeOutTicker;
 Ticker g_batLevelTicker;
 
@@ -217,15 +261,388 @@ void onSTAConnected(const WiFiEventSoftAPModeStationConnected &w)
   SERIAL_PF( "Client MAC address: %x-%x-%x-%x-%x-%x\n", w.mac[0], w.mac[1], w.mac[2], w.mac[3], w.mac[4], w.mac[5]);
 }
 
+//-- loadWiFiCache ---------------------------------------------------------------------------------
+// The cache is only usable if the CRC is fine and the DHCP lease is not too old
+void loadWiFiCache()
+{
+  g_isWiFiCacheValid = sensor::loadRtcRecord( sensor::RTC_BLOCK_WIFI_CACHE, g_wifiCache );
+  if ( true == g_isWiFiCacheValid && sensor::RTC_WIFI_LEASE_MAX_AGE <= g_wifiCache.leaseAge )
+  {
+    SERIAL_PLN("WiFi cache: DHCP lease expired.");
+    g_isWiFiCacheValid = false;
+  }
+  SERIAL_PF("WiFi cache: %s\n", ( true == g_isWiFiCacheValid ? "valid" : "invalid" ) );
+}
+
+//-- clearWiFiCache --------------------------------------------------------------------------------
+void clearWiFiCache()
+{
+  g_isWiFiCacheValid = false;
+  sensor::clearRtcRecord<sensor::RtcWiFiCache>( sensor::RTC_BLOCK_WIFI_CACHE );
+}
+
+//-- mountFileSystem -------------------------------------------------------------------------------
+// LittleFS is only mounted when it is needed: config cache miss, config write or setup mode
+bool mountFileSystem()
+{
+  if ( true == g_isFsMounted ) { return true; }
+
+  g_wakeTimer.begin();
+  g_isFsMounted = LittleFS.begin();
+  g_wakeTimer.end( sensor::WAKE_PHASE_FS_MOUNT );
+  return g_isFsMounted;
+}
+
+//-- storeWiFiCache --------------------------------------------------------------------------------
+// isNewLease: true - the connection was made by DHCP, the current config must be saved
+//             false - the cached lease was used, only the counters are updated
+void storeWiFiCache(bool isNewLease, uint32_t sleepTime /* s */ )
+{
+  if ( true == isNewLease )
+  {
+    memcpy( g_wifiCache.bssid, WiFi.BSSID(), sizeof( g_wifiCache.bssid ) );
+    g_wifiCache.channel    = WiFi.channel();
+    g_wifiCache.localIp    = WiFi.localIP();
+    g_wifiCache.gateway    = WiFi.gatewayIP();
+    g_wifiCache.subnetMask = WiFi.subnetMask();
+    g_wifiCache.dns        = WiFi.dnsIP(0);
+    g_wifiCache.leaseAge   = 0;
+    g_wifiCache.wakesSinceRfCal = 0;
+  }
+
+  // The next wake-up happens after the sleep time
+  g_wifiCache.leaseAge += sleepTime;
+
+  // Full RF calibration from time to time to follow the temperature and supply changes
+  ++g_wifiCache.wakesSinceRfCal;
+  if ( sensor::RTC_RF_CAL_INTERVAL <= g_wifiCache.wakesSinceRfCal )
+  {
+    g_wifiCache.rfCalPolicy = sensor::RF_CAL_POLICY_FULL;
+    g_wifiCache.wakesSinceRfCal = 0;
+  }
+  else { g_wifiCache.rfCalPolicy = sensor::RF_CAL_POLICY_SKIP; }
+
+  g_isWiFiCacheValid = sensor::saveRtcRecord( sensor::RTC_BLOCK_WIFI_CACHE, g_wifiCache );
+}
+
+//-- getNextWakeRfMode -----------------------------------------------------------------------------
+// The RF mode of the next wake-up is decided when going to deep sleep
+RFMode getNextWakeRfMode()
+{
+  if ( true == g_isWiFiCacheValid && sensor::RF_CAL_POLICY_SKIP == g_wifiCache.rfCalPolicy ) 
+  { 
+    return WAKE_NO_RFCAL; 
+  }
+  return WAKE_RF_DEFAULT;
+}
+
+//-- loadReadingBuffer -----------------------------------------------------------------------------
+void loadReadingBuffer()
+{
+  if ( false == sensor::loadRtcRecord( sensor::RTC_BLOCK_READING_BUFFER, g_readingBuffer ) )
+  {
+    g_readingBuffer = sensor::RtcReadingBuffer();
+    g_readingBuffer.backlogCount = sensor::BACKLOG_COUNT_UNKNOWN; // the device clock restarts
+  }
+  loadWallClock();
+
+  // The RF mode of the wake-up is only known after a deep sleep. Power-on and restart: radio on.
+  g_isRadioOffWake = ( REASON_DEEP_SLEEP_AWAKE == ESP.getResetInfoPtr()->reason ) &&
+                     ( g_readingBuffer.flags & sensor::RTC_FLAG_RADIO_OFF );
+  SERIAL_PF("Reading buffer: %d readings, radio %s\n", g_readingBuffer.count, ( g_isRadioOffWake ? "off" : "on" ) );
+}
+
+//-- goToDeepSleep ---------------------------------------------------------------------------------
+// All the deep sleeps of the sensor mode. The device clock of the reading buffer follows the awake
+// and the sleep time (the upload backlog needs it in every mode) and the RF mode of the next
+// wake-up is saved.
+const uint32_t RADIO_REWAKE_TIME = 100; // ms, deep sleep only to switch on the radio
+
+void goToDeepSleep(RFMode rfMode, uint32_t sleepTime /* ms */ )
+{
+  g_readingBuffer.clock += millis() + sleepTime;
+  if ( WAKE_RF_DISABLED == rfMode ) { g_readingBuffer.flags |=  sensor::RTC_FLAG_RADIO_OFF; }
+  else                              { g_readingBuffer.flags &= ~sensor::RTC_FLAG_RADIO_OFF; }
+  sensor::saveRtcRecord( sensor::RTC_BLOCK_READING_BUFFER, g_readingBuffer );
+
+  ESP.deepSleep( sleepTime * 1000ULL, rfMode );
+}
+
+//-- getSleepInterval ------------------------------------------------------------------------------
+// s, upload_freq stretched by the battery governor
+uint32_t getSleepInterval()
+{
+  return ( 0 < g_cadence.interval ? g_cadence.interval : g_iniStorage.upload_freq );
+}
+
+void goToDeepSleep(RFMode rfMode)
+{
+  goToDeepSleep( rfMode, getSleepInterval() * 1000UL );
+}
+
+//-- planCadence -----------------------------------------------------------------------------------
+// After readSensors(). The sensor-only mode is kept in the reading buffer for the hysteresis.
+void planCadence()
+{
+  bool wasSensorOnly = g_readingBuffer.flags & sensor::RTC_FLAG_SENSOR_ONLY;
+  g_cadence = sensor::planCadence( g_battery, g_iniStorage.upload_freq, g_iniStorage.batteryLowLevel, 
+                                   g_iniStorage.batteryCriticalLevel, wasSensorOnly );
+
+  if ( sensor::CADENCE_SENSOR_ONLY == g_cadence.mode ) { g_readingBuffer.flags |=  sensor::RTC_FLAG_SENSOR_ONLY; }
+  else                                                 { g_readingBuffer.flags &= ~sensor::RTC_FLAG_SENSOR_ONLY; }
+  if ( sensor::CADENCE_NORMAL != g_cadence.mode )
+  {
+    SERIAL_PF("Battery %d%%: sleep %u s%s\n", g_battery, g_cadence.interval, 
+              ( sensor::CADENCE_SENSOR_ONLY == g_cadence.mode ? ", sensor only" : "" ) );
+  }
+}
+
+//-- WALL CLOCK ------------------------------------------------------------------------------------
+// Taken from the Date header of the upload responses or from SNTP, see RtcWallClock
+// Without the Date header (UDP transports) it is re-synced by SNTP when it is older than this
+const uint32_t WALL_CLOCK_MAX_AGE = 24 * 3600UL * 1000; // ms
+
+sensor::RtcWallClock g_wallClock;
+bool g_isWallClockValid   = false;
+bool g_isWallClockSyncing = false; // SNTP has been started to re-sync a valid wall clock
+
+//-- getWallClockAge -------------------------------------------------------------------------------
+// ms of device clock since the wall clock has been set
+uint32_t getWallClockAge()
+{
+  return g_readingBuffer.clock + millis() - g_wallClock.clock;
+}
+
+//-- loadWallClock ---------------------------------------------------------------------------------
+// Only a deep sleep carries the device clock forward, after any other reset it is not trusted.
+// Beyond the int32 range of getWallClock() the time stamps would overflow, it is not trusted either.
+void loadWallClock()
+{
+  g_isWallClockValid = ( REASON_DEEP_SLEEP_AWAKE == ESP.getResetInfoPtr()->reason ) &&
+                       ( true == sensor::loadRtcRecord( sensor::RTC_BLOCK_WALL_CLOCK, g_wallClock ) ) &&
+                       ( static_cast<uint32_t>( INT32_MAX ) >= getWallClockAge() );
+}
+
+//-- setWallClock ----------------------------------------------------------------------------------
+void setWallClock(time_t epochNow)
+{
+  g_wallClock.epoch = epochNow;
+  g_wallClock.clock = g_readingBuffer.clock + millis();
+  g_isWallClockValid = sensor::saveRtcRecord( sensor::RTC_BLOCK_WALL_CLOCK, g_wallClock );
+}
+
+//-- getWallClock ----------------------------------------------------------------------------------
+// The wall clock at a device clock value, 0 if it is not known
+time_t getWallClock(uint32_t clock)
+{
+  if ( false == g_isWallClockValid ) { return 0; }
+  return g_wallClock.epoch + static_cast<int32_t>( clock - g_wallClock.clock ) / 1000;
+}
+
+//-- waitForWallClock ------------------------------------------------------------------------------
+// The wall clock of the last upload is used if it is known. SNTP is the fallback after a
+// power-on: it is started right after the WiFi connection if more than one reading is buffered,
+// the backlog has readings or the history is enabled. It also re-syncs an old wall clock, which
+// is kept if SNTP does not answer.
+// return 0 if the time is not available within NTP_TIMEOUT
+const char NTP_SERVER_1[] = "pool.ntp.org";
+const char NTP_SERVER_2[] = "time.nist.gov";
+const uint16_t NTP_TIMEOUT    = 2000;       // ms
+const time_t   NTP_VALID_TIME = 1600000000; // anything before is the unset clock
+
+time_t waitForWallClock()
+{
+  if ( true == g_isWallClockValid && false == g_isWallClockSyncing ) 
+  { 
+    return getWallClock( g_readingBuffer.clock + millis() ); 
+  }
+
+  uint32_t startTime = millis();
+  time_t now = time( NULL );
+  while ( NTP_VALID_TIME > now )
+  {
+    if ( NTP_TIMEOUT < millis() - startTime ) 
+    { 
+      SERIAL_PLN( F("SNTP timeout.") );
+      g_isWallClockSyncing = false;
+      return getWallClock( g_readingBuffer.clock + millis() ); // 0 if it is not known
+    }
+    delay( 10 );
+    now = time( NULL );
+  }
+  g_isWallClockSyncing = false;
+  setWallClock( now );
+  return now;
+}
+
+//-- storeHistory ----------------------------------------------------------------------------------
+// Appends the uploaded batch (buffered mode) or the current reading to the history file.
+// clockNow: the device clock at epochNow, the time stamps are calculated like for the batch
+void storeHistory(uint32_t clockNow, time_t epochNow)
+{
+  if ( false == g_iniStorage.history_enabled || 0 == epochNow ) { return; }
+  if ( false == mountFileSystem() || false == g_historyStore.open() )
+  {
+    SERIAL_PLN( F("History is not available.") );
+    return;
+  }
+
+  sensor::HistoryPoint point;
+  if ( true == g_isBufferedMode )
+  {
+    for ( uint8_t i = 0; i < g_readingBuffer.count; ++i )
+    {
+      const sensor::RtcReading &reading = g_readingBuffer.at( i );
+      point.time = epochNow - ( clockNow - reading.clock ) / 1000;
+      point.values[sensor::HISTORY_VALUE_TEMPERATURE] = static_cast<uint16_t>( reading.tempr );
+      point.values[sensor::HISTORY_VALUE_HUMIDITY]    = reading.humid;
+      point.values[sensor::HISTORY_VALUE_PRESSURE]    = reading.press;
+      point.values[sensor::HISTORY_VALUE_BATTERY]     = reading.battery;
+      g_historyStore.append( point );
+    }
+  }
+  else
+  {
+    point.time = epochNow;
+    point.values[sensor::HISTORY_VALUE_TEMPERATURE] = static_cast<uint16_t>( static_cast<int16_t>( roundf( g_temp * 100 ) ) );
+    point.values[sensor::HISTORY_VALUE_HUMIDITY]    = static_cast<uint16_t>( roundf( g_hum * 100 ) );
+    point.values[sensor::HISTORY_VALUE_PRESSURE]    = static_cast<uint16_t>( roundf( g_pres * 10 ) );
+    point.values[sensor::HISTORY_VALUE_BATTERY]     = static_cast<uint16_t>( g_battery );
+    g_historyStore.append( point );
+  }
+  g_historyStore.close();
+}
+
+//-- isBacklogPending ------------------------------------------------------------------------------
+// The unacknowledged UDP cannot tell a delivered datagram from a lost one: the backlog removed after
+// such an upload could be lost as well. It is kept in the file until an acknowledged transport.
+bool isBacklogPending()
+{
+  return 0 < g_iniStorage.backlog_drain_max && 0 < g_readingBuffer.backlogCount &&
+         sensor::BACKLOG_COUNT_UNKNOWN != g_readingBuffer.backlogCount &&
+         sensor::SERVER_TRANSPORT_UDP != g_iniStorage.server_transport;
+}
+
+//-- getBacklogDrainCount --------------------------------------------------------------------------
+// The backlog readings sent with this upload. The whole upload must finish before the upload
+// watchdog fires, otherwise none of the readings is removed and the next wake-up sends the same
+// ones again. The time left by the watchdog is shared: the connection and the current readings get
+// BACKLOG_DRAIN_RESERVE, the rest limits the readings at BACKLOG_DRAIN_RATE.
+const uint32_t BACKLOG_DRAIN_RESERVE = 5000; // ms, WiFi, TLS handshake and the current readings
+const uint32_t BACKLOG_DRAIN_RATE    = 20;   // readings per second, about 2 KB/s of line protocol
+
+uint32_t getBacklogDrainCount(uint32_t uploadStart)
+{
+  uint32_t timeout = static_cast<uint32_t>( g_iniStorage.upload_timeout ) * 1000;
+  uint32_t elapsed = millis() - uploadStart;
+  uint32_t budget  = ( elapsed + BACKLOG_DRAIN_RESERVE < timeout ? timeout - elapsed - BACKLOG_DRAIN_RESERVE : 0 );
+  uint32_t count   = std::min<uint32_t>( g_uploadBacklog.count(), g_iniStorage.backlog_drain_max );
+  return std::min<uint32_t>( count, budget * BACKLOG_DRAIN_RATE / 1000 );
+}
+
+//-- openBacklog -----------------------------------------------------------------------------------
+// After a power-on the readings of the file belong to the previous run of the device clock
+bool openBacklog()
+{
+  if ( false == mountFileSystem() || false == g_uploadBacklog.open() )
+  {
+    SERIAL_PLN( F("Upload backlog is not available.") );
+    return false;
+  }
+  if ( sensor::BACKLOG_COUNT_UNKNOWN == g_readingBuffer.backlogCount ) { g_uploadBacklog.clear(); }
+  g_readingBuffer.backlogCount = g_uploadBacklog.count();
+  return true;
+}
+
+//-- storeBacklog ----------------------------------------------------------------------------------
+// The readings of a failed upload: the buffered ones (buffered mode) or the current one. They are
+// uploaded by a later wake-up, see DataReportBacklog.
+// count: the number of the oldest buffered readings to store, all of them by default
+void storeBacklog(uint8_t count = sensor::RTC_BATCH_MAX)
+{
+  if ( 0 == g_iniStorage.backlog_drain_max || false == openBacklog() ) { return; }
+
+  sensor::RtcReading readings[sensor::RTC_BATCH_MAX];
+  if ( true == g_isBufferedMode )
+  {
+    count = std::min( count, g_readingBuffer.count );
+    for ( uint8_t i = 0; i < count; ++i ) { readings[i] = g_readingBuffer.at( i ); }
+  }
+  else
+  {
+    count = 1;
+    readings[0].clock   = g_readingBuffer.clock + static_cast<uint32_t>( g_timeStamp );
+    readings[0].tempr   = static_cast<int16_t>( roundf( g_temp * 100 ) );
+    readings[0].humid   = static_cast<uint16_t>( roundf( g_hum * 100 ) );
+    readings[0].press   = static_cast<uint16_t>( roundf( g_pres * 10 ) );
+    readings[0].battery = static_cast<uint8_t>( g_battery );
+  }
+
+  if ( true == g_uploadBacklog.append( readings, count ) )
+  {
+    SERIAL_PF("Backlog: %d readings stored, %u pending.\n", count, g_uploadBacklog.count() );
+    if ( true == g_isBufferedMode ) { g_readingBuffer.removeOldest( count ); }
+  }
+  g_readingBuffer.backlogCount = g_uploadBacklog.count();
+  g_uploadBacklog.close();
+}
+
+//-- connectToWiFiFast -----------------------------------------------------------------------------
+// Warm wake-up: BSSID, channel and the last DHCP lease come from the RTC memory.
+// No DHCP exchange and no SDK flash write (not persistent).
+// return false if the AP is not reached within WIFI_FAST_CON_TIMEOUT, the static config is removed
+const uint16_t WIFI_FAST_CON_TIMEOUT = 1500; // ms
+
+bool connectToWiFiFast(const sensor::SensorIniFileStorage& senConf, const sensor::RtcWiFiCache& cache )
+{
+  SERIAL_PF("\n\nconnecting to :%s (RTC cache) ", senConf.wifi_ap_ssid);
+
+  WiFi.persistent( false );
+  WiFi.mode(WIFI_STA);
+  WiFi.config( IPAddress( cache.localIp ), IPAddress( cache.gateway ), 
+               IPAddress( cache.subnetMask ), IPAddress( cache.dns ) );
+  WiFi.begin( senConf.wifi_ap_ssid, senConf.wifi_ap_pwd, cache.channel, cache.bssid, true );
+
+  g_dispIcons.fields.wifi = true;
+  drawScreen();
+
+  uint32_t startTime = millis();
+  while ( WiFi.status() != WL_CONNECTED ) 
+  {
+    if ( WIFI_FAST_CON_TIMEOUT < millis() - startTime )
+    {
+      SERIAL_PLN( F("Fast connect timeout.") );
+      WiFi.disconnect();
+      WiFi.config( 0U, 0U, 0U ); // back to DHCP
+      return false;
+    }
+    delay( 10 );
+  }
+
+  SERIAL_PF("\nWiFi connected in %lu ms. IP address: %s\n", millis() - startTime, WiFi.localIP().toString().c_str() );
+  return true;
+}
+
 // -- connectToWiFiV3 ------------------------------------------------------------------------------
 // Connects to the known WiFi AP
+// If the RTC cache is valid, the fast reconnect is tried first. On failure the cache is dropped.
 // If the BSSID is known let's try to connect to it. If it is not known, use just the SSID and PWD
 // If connecting to the AP is successful, the BSSID is saved with the channel -> ConfigChanged -> true
 // If connecting to the AP is usuccessful, clear the BSSID and the channel -> ConfigChanged -> true
 // return false if connection is unsuccessful / true if successful
-bool connectToWiFiV4(sensor::SensorIniFileStorage& senConf, bool &isConfigChanged )
+bool connectToWiFiV4(sensor::SensorIniFileStorage& senConf, sensor::ConfigFieldMask &changedFields )
 {
-  isConfigChanged = false;
+  changedFields = 0;
+
+  if ( true == g_isWiFiCacheValid )
+  {
+    if ( true == connectToWiFiFast( senConf, g_wifiCache ) )
+    {
+      storeWiFiCache( false, getSleepInterval() );
+      return true;
+    }
+    clearWiFiCache();
+  }
 
   WiFi.persistent( true );
   SERIAL_PF("\n\nconnecting to :%s", senConf.wifi_ap_ssid);
@@ -243,6 +660,7 @@ bool connectToWiFiV4(sensor::SensorIniFileStorage& senConf, bool &isConfigChange
     //  60 attempts is the minimum with 150 ms delay
     if ( 240 > senConf.wifi_max_con_attempts ) { senConf.wifi_max_con_attempts += 60; }
     else { senConf.wifi_max_con_attempts = 240; }
+    changedFields |= CONFIG_FIELD_MASK( wifi_max_con_attempts );
     SERIAL_PF("Con_attempts: %d; Con_delays: %d\n", senConf.wifi_max_con_attempts, senConf.wifi_con_delay);
     
     //iniFileStorage.wifi_max_con_attempts = iniFileStorage.wifi_max_con_attempts * 2;
@@ -271,7 +689,7 @@ bool connectToWiFiV4(sensor::SensorIniFileStorage& senConf, bool &isConfigChange
     { 
       memset(senConf.wifi_ap_bssid, 0, sizeof( uint8_t) * 6 ); // clean out the BSSID
       senConf.wifi_ap_channel = 0;
-      isConfigChanged = true;
+      changedFields |= CONFIG_FIELD_MASK( wifi_ap_bssid ) | CONFIG_FIELD_MASK( wifi_ap_channel );
       
       return false; 
     }
@@ -288,7 +706,7 @@ bool connectToWiFiV4(sensor::SensorIniFileStorage& senConf, bool &isConfigChange
   SERIAL_PF("\nWiFi connected. IP address: %s\n", WiFi.localIP().toString().c_str() );
   if ( 0 == bssid_check )
   {
-    isConfigChanged = true;
+    changedFields |= CONFIG_FIELD_MASK( wifi_ap_bssid );
 
     const uint8_t *mac = WiFi.BSSID();
     memcpy( senConf.wifi_ap_bssid, mac, sizeof( uint8_t ) * 6 );
@@ -300,7 +718,7 @@ bool connectToWiFiV4(sensor::SensorIniFileStorage& senConf, bool &isConfigChange
 
   if ( WiFi.channel() != senConf.wifi_ap_channel ) // The channel value has changed
   { 
-    isConfigChanged = true; 
+    changedFields |= CONFIG_FIELD_MASK( wifi_ap_channel );
     senConf.wifi_ap_channel = WiFi.channel();
   }
 
@@ -308,12 +726,14 @@ bool connectToWiFiV4(sensor::SensorIniFileStorage& senConf, bool &isConfigChange
   SERIAL_PF("AP Channel: %d\n", WiFi.channel() );
   SERIAL_PF("Con_attempts: %d; Con_delays: %d\n", senConf.wifi_max_con_attempts, senConf.wifi_con_delay);
 
+  storeWiFiCache( true, getSleepInterval() );
+
   return true;
 }
 
 
 //-- WEBSERVER Management --------------------------------------------------------------------------
-ESP8266WebServer server(80);    // Create a webserver object that listens for HTTP request on port 80
+AsyncWebServer server(80);      // Create a webserver object that listens for HTTP request on port 80
 const char NOT_FOUND[] = " not found\n";
 
 
@@ -330,6 +750,10 @@ namespace influx
     const char *data_org = 0;
     const char *data_bucket = 0;
     const char *data_measurement_name = 0;
+    uint8_t tls_profile = sensor::TLS_PROFILE_DEFAULT;
+    uint16_t gzip_min_size = 0; // bytes, 0 - the body is not compressed
+    uint8_t transport = sensor::SERVER_TRANSPORT_HTTPS;
+    const sensor::HttpRequestHeader *requestHeader = NULL; // built once from the config
     
     DataReportConfig( const char *srv_addr, uint16_t srv_port,
                       const char *srv_auth_token,
@@ -346,30 +770,281 @@ namespace influx
                     data_org(data_org), data_bucket(data_bucket), data_measurement_name(data_meas_name)
   {}
 
+  //-- A batch of readings from the RTC memory with the clock values to time stamp them
+  struct DataReportBatch
+  {
+    const sensor::RtcReadingBuffer &buffer;
+    uint32_t clockNow = 0; // device clock (ms) at the time of the upload
+    time_t   epochNow = 0; // wall clock (s) at the time of the upload
+
+    DataReportBatch( const sensor::RtcReadingBuffer &buffer, uint32_t clockNow, time_t epochNow );
+  };
+
+  DataReportBatch::DataReportBatch( const sensor::RtcReadingBuffer &buffer, uint32_t clockNow, 
+                    time_t epochNow ): buffer(buffer), clockNow(clockNow), epochNow(epochNow)
+  {}
+
+  //-- The oldest readings of the upload backlog, they are sent in front of the current data
+  struct DataReportBacklog
+  {
+    sensor::UploadBacklog *backlog = NULL;
+    uint32_t count    = 0; // readings to send, the oldest ones
+    uint32_t clockNow = 0; // device clock (ms) at the time of the upload
+    time_t   epochNow = 0; // wall clock (s) at the time of the upload
+  };
+
   const char SERVER_REQ_URL_V2[] = "/api/v2/write?precision=s"; //org=mine&bucket=ts_bucket&precision=s";
 
+  //-- Sensor measurement, one point per reading
+  enum SensorField : uint8_t
+  {
+    SENSOR_FIELD_TEMPERATURE = 0,
+    SENSOR_FIELD_HUMIDITY,
+  #ifdef SENSOR_BME280
+    SENSOR_FIELD_PRESSURE,
+  #endif
+    SENSOR_FIELD_BATTERY,
+    SENSOR_FIELD_UPTIME,   // the current reading only
+    SENSOR_FIELD_CADENCE,  // the current reading only
+    SENSOR_FIELD_COUNT
+  };
+
+  const sensor::LineSchema<2, SENSOR_FIELD_COUNT> SENSOR_LINE_SCHEMA =
+  {
+    { "deviceId", "location" },
+    {
+      { "temperature", sensor::LINE_FIELD_FIXED,   2 },
+      { "humidity",    sensor::LINE_FIELD_FIXED,   2 },
+    #ifdef SENSOR_BME280
+      { "pressure",    sensor::LINE_FIELD_FIXED,   2 },
+    #endif
+      { "battery",     sensor::LINE_FIELD_INTEGER, 0 },
+      { "uptime",      sensor::LINE_FIELD_FIXED,   1 }, // s
+      { "cadence",     sensor::LINE_FIELD_INTEGER, 0 }, // s
+    }
+  };
+
+  typedef sensor::LinePoint<2, SENSOR_FIELD_COUNT> SensorLinePoint;
+
+//-- DataReportPayload -----------------------------------------------------------------------------
+// Everything printPayload() needs. The uptime is taken once, as the body is printed twice.
+struct DataReportPayload
+{
+  const DataReportConfig &rptConf;
+  const DataReportValues &rptValues;
+  const DataReportBatch  *batch;
+  const DataReportBacklog *backlog;
+  uint64_t uptime; // ms
+
+  DataReportPayload( const DataReportConfig &rptConf, const DataReportValues &rptValues, 
+                     const DataReportBatch *batch, const DataReportBacklog *backlog, uint64_t uptime );
+};
+
+DataReportPayload::DataReportPayload( const DataReportConfig &rptConf, const DataReportValues &rptValues, 
+                    const DataReportBatch *batch, const DataReportBacklog *backlog, uint64_t uptime ): 
+                    rptConf(rptConf), rptValues(rptValues), batch(batch), backlog(backlog), uptime(uptime)
+{}
+
+//-- setReadingFields ------------------------------------------------------------------------------
+// A buffered or a backlog reading, time stamped from the device clock
+void setReadingFields(SensorLinePoint &point, const sensor::RtcReading &reading, uint32_t clockNow, 
+                      time_t epochNow)
+{
+  point.fieldValues[SENSOR_FIELD_TEMPERATURE] = reading.tempr;
+  point.fieldValues[SENSOR_FIELD_HUMIDITY]    = reading.humid;
+  #ifdef SENSOR_BME280
+    point.fieldValues[SENSOR_FIELD_PRESSURE]  = reading.press * 10;
+  #endif
+  point.fieldValues[SENSOR_FIELD_BATTERY]     = reading.battery;
+  point.fieldValues[SENSOR_FIELD_UPTIME]      = sensor::LINE_VALUE_MISSING;
+  point.fieldValues[SENSOR_FIELD_CADENCE]     = sensor::LINE_VALUE_MISSING;
+  point.timeStamp = epochNow - ( clockNow - reading.clock ) / 1000;
+}
+
+//-- printPayload ----------------------------------------------------------------------------------
+// HttpBodyWriter of submitData: the readings and the health measurement, one line each.
+// Backlog and buffered readings are printed the oldest first with time stamps, otherwise InfluxDB
+// would merge the points. The uptime belongs to the current (last) reading only.
+void printPayload(Print &out, const void *context)
+{
+  const DataReportPayload &payload = *static_cast<const DataReportPayload *>( context );
+  const DataReportConfig  &rptConf   = payload.rptConf;
+  const DataReportValues  &rptValues = payload.rptValues;
+
+  SensorLinePoint point;
+  point.tagValues[0] = rptValues.deviceId;
+  point.tagValues[1] = rptValues.location;
+
+  if ( NULL != payload.backlog )
+  {
+    // A corrupted record is skipped, it is removed with the others
+    const DataReportBacklog &backlog = *payload.backlog;
+    sensor::RtcReading reading;
+    for ( uint32_t i = 0; i < backlog.count; ++i )
+    {
+      if ( false == backlog.backlog->read( i, reading ) ) { continue; }
+      setReadingFields( point, reading, backlog.clockNow, backlog.epochNow );
+      sensor::encodeLine( out, rptConf.data_measurement_name, NULL, SENSOR_LINE_SCHEMA, point );
+    }
+    point.timeStamp = 0;
+  }
+
+  if ( NULL == payload.batch )
+  {
+    point.fieldValues[SENSOR_FIELD_TEMPERATURE] = lroundf( rptValues.tempr * 100 );
+    point.fieldValues[SENSOR_FIELD_HUMIDITY]    = lroundf( rptValues.humid * 100 );
+    #ifdef SENSOR_BME280
+      point.fieldValues[SENSOR_FIELD_PRESSURE]  = lroundf( rptValues.press * 100 );
+    #endif
+    point.fieldValues[SENSOR_FIELD_BATTERY]     = rptValues.battery;
+    point.fieldValues[SENSOR_FIELD_UPTIME]      = payload.uptime / 100;
+    point.fieldValues[SENSOR_FIELD_CADENCE]     = rptValues.cadence;
+    point.timeStamp = rptValues.epoch;
+    sensor::encodeLine( out, rptConf.data_measurement_name, NULL, SENSOR_LINE_SCHEMA, point );
+  }
+  else
+  {
+    const DataReportBatch &batch = *payload.batch;
+    for ( uint8_t i = 0; i < batch.buffer.count; ++i )
+    {
+      setReadingFields( point, batch.buffer.at( i ), batch.clockNow, batch.epochNow );
+      if ( batch.buffer.count - 1 == i ) 
+      { 
+        point.fieldValues[SENSOR_FIELD_UPTIME]  = static_cast<int32_t>( payload.uptime / 100 ); 
+        point.fieldValues[SENSOR_FIELD_CADENCE] = rptValues.cadence;
+      }
+      sensor::encodeLine( out, rptConf.data_measurement_name, NULL, SENSOR_LINE_SCHEMA, point );
+    }
+  }
+
+  if ( NULL != rptValues.wakeTiming )
+  {
+    sensor::WakeTimer::printLine( out, *rptValues.wakeTiming, rptConf.data_measurement_name, 
+                                  rptValues.deviceId, rptValues.location );
+  }
+}
+
 //== REPORTING =====================================================================================
+//-- SUBMIT DATA UDP -------------------------------------------------------------------------------
+// The line protocol in datagrams to the relay on the LAN, see UdpLineSender. There is no response
+// with a Date header, the wall clock is set and re-synced by SNTP (see WALL_CLOCK_MAX_AGE).
+bool submitDataUdp(const DataReportConfig& rptConf, const DataReportValues& rptValues, 
+                   const DataReportBatch *batch, const DataReportBacklog *backlog )
+{
+  SERIAL_PF( "\nSending to: udp://%s:%d\n", rptConf.server_address, rptConf.server_port );
+
+  g_dispIcons.fields.inet = true;
+  drawScreen();
+
+  g_wakeTimer.begin();
+  IPAddress serverIp;
+  bool isResolved = WiFi.hostByName( rptConf.server_address, serverIp );
+  g_wakeTimer.end( sensor::WAKE_PHASE_DNS );
+
+  WiFiUDP udp;
+  if ( !isResolved || 0 == udp.begin( sensor::UDP_LOCAL_PORT ) )
+  {
+    g_dispIcons.fields.dislike = true;
+    drawScreen();
+
+    SERIAL_PLN( F("UDP socket failed") );
+    return false;
+  }
+
+  g_dispIcons.fields.upload = true;
+  drawScreen();
+
+  // The sequences start at random, the relay may still know the ones of the previous wake-up
+  DataReportPayload payload( rptConf, rptValues, batch, backlog, millis() - rptValues.timeStamp );
+  sensor::UdpLineSender sender( udp, serverIp, rptConf.server_port, 
+                                sensor::SERVER_TRANSPORT_UDP_ACK == rptConf.transport, ESP.random() );
+
+  g_wakeTimer.begin();
+  printPayload( sender, &payload );
+  bool isSent = sender.end();
+  g_wakeTimer.end( sensor::WAKE_PHASE_REQUEST );
+  udp.stop();
+
+  if ( !isSent ) 
+  {
+    g_dispIcons.fields.dislike = true;
+    drawScreen();
+
+    SERIAL_PLN( F("Failed to send the datagrams.") );
+    return false;
+  }
+  SERIAL_PLN( F("Datagrams sent.") );
+  return true;
+}
+
 //-- SUBMIT DATA -----------------------------------------------------------------------------------
 // Upload the data to the server
-bool submitData(const DataReportConfig& rptConf, const DataReportValues& rptValues)
+// batch: if it is given, the buffered readings are uploaded instead of rptValues
+// backlog: if it is given, the oldest readings of the backlog are uploaded too
+bool submitData(const DataReportConfig& rptConf, const DataReportValues& rptValues, 
+                const DataReportBatch *batch = NULL, const DataReportBacklog *backlog = NULL )
 {
-  #ifdef SENSOR_BME280
-    const char PAYLOAD_STRING[] = "%s,deviceId=%s,location=%s temperature=%.2f,humidity=%.2f,pressure=%.2f,battery=%di,uptime=%llu.%llu";
-  #else
-    const char PAYLOAD_STRING[] = "%s,deviceId=%s,location=%s temperature=%.2f,humidity=%.2f,battery=%di,uptime=%llu.%llu";
-  #endif
+  if ( sensor::SERVER_TRANSPORT_HTTPS != rptConf.transport ) 
+  { 
+    return submitDataUdp( rptConf, rptValues, batch, backlog ); 
+  }
+
+  if ( NULL == rptConf.requestHeader || false == rptConf.requestHeader->isBuilt() )
+  {
+    SERIAL_PLN( F("No HTTP request header, the upload is skipped.") );
+    return false;
+  }
 
   SERIAL_PLN("Initiating data upload.");
   // Use WiFiClientSecure class to create TLS connection
   BearSSL::WiFiClientSecure tcpClient;
   tcpClient.setInsecure();
+  g_wakeTimer.begin();
+  sensor::applyTlsProfile( tcpClient, rptConf.server_address, rptConf.server_port, rptConf.tls_profile );
+  g_wakeTimer.end( sensor::WAKE_PHASE_TLS ); // the MFLN probe is a TLS connection of its own
+
+  // The session of the previous wake-up is offered for an abbreviated handshake
+  BearSSL::Session tlsSession;
+  bool isSessionOffered = sensor::loadTlsSession( rptConf.server_address, rptConf.server_port, tlsSession );
+  tcpClient.setSession( &tlsSession );
 
   SERIAL_PF( "\nConnecting to: %s:%d\n", rptConf.server_address, rptConf.server_port );
 
   g_dispIcons.fields.inet = true;
   drawScreen();
 
-  if ( !tcpClient.connect( rptConf.server_address, rptConf.server_port ) ) 
+  // DNS separately for the phase timing, connect() gets the address from the lwIP DNS cache
+  g_wakeTimer.begin();
+  IPAddress serverIp;
+  bool isResolved = WiFi.hostByName( rptConf.server_address, serverIp );
+  g_wakeTimer.end( sensor::WAKE_PHASE_DNS );
+  if ( !isResolved ) 
+  {
+    g_dispIcons.fields.dislike = true;
+    drawScreen();
+
+    SERIAL_PF( "DNS lookup of %s failed\n", rptConf.server_address );
+    return false;
+  }
+
+  g_wakeTimer.begin();
+  bool isConnected = tcpClient.connect( rptConf.server_address, rptConf.server_port );
+  if ( !isConnected && true == isSessionOffered )
+  {
+    // The server refused the resumption, once more with a full handshake
+    SERIAL_PLN( F("Connection with the cached TLS session failed. Full handshake.") );
+    sensor::clearTlsSession();
+    tcpClient.stop();
+    tlsSession = BearSSL::Session();
+    isConnected = tcpClient.connect( rptConf.server_address, rptConf.server_port );
+  }
+  g_wakeTimer.add( sensor::WAKE_PHASE_TLS );
+  if ( isConnected ) 
+  { 
+    sensor::saveTlsSession( rptConf.server_address, rptConf.server_port, tlsSession ); 
+    sensor::confirmTlsProfile( rptConf.server_address, rptConf.server_port );
+  }
+  if ( !isConnected ) 
   {
     g_dispIcons.fields.dislike = true;
     drawScreen();
@@ -382,54 +1057,32 @@ bool submitData(const DataReportConfig& rptConf, const DataReportValues& rptValu
   g_dispIcons.fields.upload = true;
   drawScreen();
 
-  // Send HTTPS request
-  String strReq;
-
-  strReq += F("POST ");
-    strReq += influx::SERVER_REQ_URL_V2;
-    strReq += "&org=";          strReq += rptConf.data_org;
-    strReq += "&bucket=";     strReq += rptConf.data_bucket;
-    strReq += F(" HTTP/1.1\r\n");
-
-  strReq += F("Host: ");  strReq += rptConf.server_address; strReq += F(" \r\n");
-
-  strReq += F("User-Agent: ESP8266 Sensor Agent\r\n");
-  strReq += F("Connection: close\r\n");
-  strReq += F("Authorization: Token ");
-  strReq += rptConf.server_auth_token; strReq += F(" \r\n");
-
-  //strReq += F("Content-Type: application/x-www-form-urlencoded\r\n");
+  // Send HTTPS request, the body is streamed after the constant header. The backlog can be hundreds
+  // of readings: it is sent chunked, so the records are read from the file only once.
+  DataReportPayload payload( rptConf, rptValues, batch, backlog, millis() - rptValues.timeStamp );
+  sensor::HttpRequestWriter requestWriter( tcpClient );
 
-  char payloadBuffer[256]     = { 0 };
-  uint64_t timeDiff = millis() - rptValues.timeStamp;
-  sprintf( payloadBuffer, 
-    PAYLOAD_STRING,  //   "%s,deviceID=%s,location=%s temperature=%.2f,humidity=%.2f,pressure=%.2f,battery=%di,uptime=%llu.%llu";
-    rptConf.data_measurement_name, // e.g. "homeThermoSensor"
-    rptValues.deviceId, //device ID,
-    rptValues.location, //location,
-    rptValues.tempr, // Temperature
-    #ifdef SENSOR_BME280
-      rptValues.humid,  // Humidity
-    #endif
-    rptValues.press, // Air pressure
-    rptValues.battery, // Battery level
-    ( timeDiff / 1000), ((timeDiff / 100) - timeDiff / 1000) // Uptime
-  );
-  
-  uint16_t len = strlen( payloadBuffer );
-
-  strReq += F("Content-Length: ");
-  char payloadLength[5] = { 0 };
-  sprintf( payloadLength, "%d", len );
-  strReq += payloadLength;
-  strReq += F("\r\n\r\n");
-  strReq += payloadBuffer;
-  strReq += F("\r\n");
-  strReq += F("\r\n");
+  // The multi-point bodies above gzip_min_size are compressed (and sent chunked). The size of a
+  // backlog body is not measured, it is compressed anyway.
+  bool isCompressed = false;
+  if ( 0 < rptConf.gzip_min_size && ( NULL != backlog || NULL != batch ) )
+  {
+    sensor::LengthCounter bodyLength;
+    if ( NULL == backlog ) { printPayload( bodyLength, &payload ); }
+    isCompressed = ( NULL != backlog || rptConf.gzip_min_size <= bodyLength.length() );
+  }
 
-  SERIAL_P( F("Request: ") ); SERIAL_PLN( strReq );
+  SERIAL_P( F("Request: ") ); SERIAL_P( rptConf.requestHeader->c_str() );
+  #ifdef GSI_DEBUG
+    if ( NULL == backlog ) { printPayload( Serial, &payload ); }
+  #endif
 
-  if ( tcpClient.write(  strReq.c_str() ) == 0 ) 
+  g_wakeTimer.begin();
+  size_t written = ( NULL == backlog && false == isCompressed ? 
+                     requestWriter.writePost( *rptConf.requestHeader, printPayload, &payload ) :
+                     requestWriter.writePostChunked( *rptConf.requestHeader, printPayload, &payload, isCompressed ) );
+  g_wakeTimer.end( sensor::WAKE_PHASE_REQUEST );
+  if ( 0 == written ) 
   {
     g_dispIcons.fields.dislike = true;
     drawScreen();
@@ -441,7 +1094,9 @@ bool submitData(const DataReportConfig& rptConf, const DataReportValues& rptValu
   
   // Check HTTP status
   char httpStatus[32] = {0};
+  g_wakeTimer.begin();
   tcpClient.readBytesUntil('\r', httpStatus, sizeof( httpStatus ));
+  g_wakeTimer.end( sensor::WAKE_PHASE_STATUS );
   if ( strcmp( httpStatus, "HTTP/1.1 204 No Content" ) != 0) 
   {
     g_dispIcons.fields.dislike = true;
@@ -455,15 +1110,30 @@ bool submitData(const DataReportConfig& rptConf, const DataReportValues& rptValu
     SERIAL_PLN( F("Received HTTP 204 No Content."));
   }
 
-  // Skip HTTP headers
-  const char endOfHeaders[] = "\r\n\r\n";
-  if ( !tcpClient.find( endOfHeaders ) ) 
+  // The HTTP headers: the Date sets the wall clock for the time stamps of the next uploads.
+  // Only the Date header must fit into the buffer, the rest of a longer line is skipped. So every
+  // read starts at a line, and an empty one is the end of the headers.
+  const char DATE_HEADER[] = "Date: ";
+  char headerLine[64] = { 0 };
+  while ( true )
   {
-    g_dispIcons.fields.dislike = true;
-    drawScreen();
+    size_t length = tcpClient.readBytesUntil( '\n', headerLine, sizeof( headerLine ) - 1 );
+    if ( sizeof( headerLine ) - 1 == length ) 
+    { 
+      tcpClient.find( '\n' ); // the new line has not been read
+      continue; 
+    }
+    headerLine[length] = 0;
+    if ( 0 < length && '\r' == headerLine[length - 1] ) { headerLine[--length] = 0; }
+    if ( 0 == length ) { break; }
 
-    SERIAL_PLN( F("Invalid response. Cannot find \\r\\n\\r\\n") );
-    return false;
+    uint32_t epoch = 0;
+    if ( 0 == strncasecmp( headerLine, DATE_HEADER, sizeof( DATE_HEADER ) - 1 ) &&
+         true == sensor::parseHttpDate( headerLine + sizeof( DATE_HEADER ) - 1, epoch ) )
+    {
+      setWallClock( epoch );
+      SERIAL_PF("Wall clock: %u\n", epoch );
+    }
   }
 
   return true;
@@ -541,6 +1211,7 @@ void readSensors()
   const sensor::SensorIniFileStorage& ini = g_iniStorage;
 
   int16_t batteryLevel = analogRead(A0);
+  g_batteryAdc = batteryLevel;
   //g_battery = ( ( batteryLevel - ZERO_BASE )  / RANGE_DIFF ) * 100; 
   //g_battery = batteryLevel;
   g_battery = (  (float)( batteryLevel - ini.batteryMinLevel )  / (ini.batteryMaxLevel - ini.batteryMinLevel) ) * 100;
@@ -552,6 +1223,22 @@ void readSensors()
   Serial.printf("A0: %d | Battery level: %d%%\n", batteryLevel, g_battery );
 }
 
+//-- sampleTelemetry -------------------------------------------------------------------------------
+// TelemetrySampler of setup mode: called once per interval, the sample is sent to every client
+void sampleTelemetry(sensor::TelemetrySample &sample)
+{
+  readSensors();
+
+  sample.temperature = g_temp;
+  sample.humidity    = g_hum;
+  #ifdef SENSOR_BME280
+    sample.pressure  = g_pres;
+  #endif
+  sample.batteryAdc  = g_batteryAdc;
+  sample.battery     = g_battery;
+  sample.freeHeap    = ESP.getFreeHeap();
+}
+
 //-- handleTickerUploadTimeout ---------------------------------------------------------------------
 void handleTickerUploadTimeout()
 {
@@ -563,7 +1250,8 @@ void handleTickerUploadTimeout()
   g_dispIcons.fields.pclosed = true;
   drawScreen();
 
-  ESP.deepSleep(  g_iniStorage.upload_freq * 10e5, WAKE_RF_DEFAULT );
+  g_wakeTimer.finish(); // The timed out wake-up is reported by the next successful upload
+  goToDeepSleep( getNextWakeRfMode() );
 }
 
 
@@ -1033,9 +1721,7 @@ void setupOTA()
     g_uploadTimeOutTicker.detach();
     yield();
 
-    server.close();
-    yield();
-    server.stop();
+    server.end();
     yield();
 
     String type;
@@ -1045,6 +1731,7 @@ void setupOTA()
       // NOTE: if updating FS this would be the place to unmount FS using FS.end()
       type = "filesystem"; 
       LittleFS.end(); 
+      g_isFsMounted = false;
     }
     
     SERIAL_PLN("Start updating " + type);
@@ -1084,9 +1771,12 @@ void handleSetupMode()
 {
   SERIAL_PLN("Config mode active. Starting Access Point mode.");
   printScreenLine("Config mode started.");
+  clearWiFiCache(); // The network config may change
+  sensor::clearConfigCache(); // the config itself too
+  sensor::clearRtcRecord<sensor::RtcReadingBuffer>( sensor::RTC_BLOCK_READING_BUFFER ); // and the buffering
   
   wifiStaConnectHandler = WiFi.onSoftAPModeStationConnected(onSTAConnected);
-  if ( false == g_iniStorage.wifi_enabled )
+  if ( false == g_iniStorage.wifi_enabled || true == g_isRadioOffWake )
   {
     WiFi.forceSleepWake();
     delay(1000);
@@ -1109,11 +1799,14 @@ void handleSetupMode()
   SERIAL_PF("AP IP address: %s\n", WiFi.softAPIP().toString().c_str() );
   screenAPStarted();
 
-  server.onNotFound([]() {                            // If the client requests any URI
-  if (!g_webConfMan.handleFileRead(server.uri(), server, g_iniStorage))                  // send it if it exists
-    server.send(404, "text/plain", "404: Not Found"); // otherwise, respond with a 404 (Not Found) error
+  // The files and the api are handled by g_webConfMan
+  server.onNotFound([](AsyncWebServerRequest *request) { 
+    request->send(404, "text/plain", "404: Not Found"); // otherwise, respond with a 404 (Not Found) error
   });
 
+  g_webConfMan.begin(server, g_iniStorage);
+  g_telemetry.begin(server, sampleTelemetry, g_iniStorage.sensor_telemetry_interval);
+  sensor::beginHistoryApi(server);
   server.begin();                           // Start the server
   SERIAL_PLN( F("HTTP server started") );
 
@@ -1126,22 +1819,29 @@ void handleSetupMode()
 void handleSensorModeWiFiConnectV2()
 {
   // Connect to WiFi 
-  bool isConfigChanged = false;
-  bool isConnectionSuccessful = connectToWiFiV4( g_iniStorage, isConfigChanged );
+  sensor::ConfigFieldMask changedFields = 0;
+  g_wakeTimer.begin();
+  bool isConnectionSuccessful = connectToWiFiV4( g_iniStorage, changedFields );
+  g_wakeTimer.end( sensor::WAKE_PHASE_WIFI );
 
-  // Write Ini file if configuration has changed
-  if ( true == isConfigChanged )
+  // Only the changed fields are saved, into the config journal
+  if ( 0 != changedFields )
   {
     SERIAL_PLN("NetworkConfig changed.");
 
-    bool result = sensor::SensorConfigFile::writeIniFile(g_iniStorage);
-    SERIAL_PF("Write IniFile: %d\n", result ) ;
+    bool result = ( true == mountFileSystem() &&
+                    true == sensor::SensorConfigFile::saveChanges( g_iniStorage, changedFields ) );
+    SERIAL_PF("Save config changes: %d\n", result ) ;
+
+    // The next wake-up must not use the old copy
+    if ( true == result ) { sensor::storeConfigCache( g_iniStorage ); }
+    else                  { sensor::clearConfigCache(); }
   }
 
   if ( false == isConnectionSuccessful )
   {
     SERIAL_PLN( F("Failed to connect to WiFi AP. Going to sleep.") );
-    isConfigChanged = true;
+    storeBacklog();
   
     g_dispIcons.allFields = 0;
     g_dispIcons.fields.wifi = true;
@@ -1149,9 +1849,118 @@ void handleSensorModeWiFiConnectV2()
     g_dispIcons.fields.pclosed = true;
     
     drawScreen();
-    ESP.deepSleep( g_iniStorage.upload_freq * 10e5, WAKE_RF_DEFAULT );
+    g_wakeTimer.finish(); // Reported by the next successful upload
+    goToDeepSleep( WAKE_RF_DEFAULT );
   }
 
+  // Time stamps for the buffered readings, the backlog and the history: SNTP if the wall clock of
+  // the last upload is not known. Without the Date header of HTTPS the wall clock drifts with the
+  // sleep timer, it is re-synced when it gets old.
+  if ( false == g_isWallClockValid && 
+       ( 1 < g_readingBuffer.count || true == isBacklogPending() || true == g_iniStorage.history_enabled ) ) 
+  { 
+    configTime( 0, 0, NTP_SERVER_1, NTP_SERVER_2 ); 
+  }
+  else if ( true == g_isWallClockValid && sensor::SERVER_TRANSPORT_HTTPS != g_iniStorage.server_transport &&
+            WALL_CLOCK_MAX_AGE < getWallClockAge() )
+  {
+    g_isWallClockSyncing = true;
+    configTime( 0, 0, NTP_SERVER_1, NTP_SERVER_2 ); 
+  }
+}
+
+//-- isSendOnDeltaEnabled --------------------------------------------------------------------------
+bool isSendOnDeltaEnabled()
+{
+  return 0 < g_iniStorage.temp_deadband || 0 < g_iniStorage.hum_deadband;
+}
+
+//-- isInsideDeadband ------------------------------------------------------------------------------
+// true if the reading has not moved enough since the last report. A deadband of 0 is not checked.
+bool isInsideDeadband(const sensor::RtcReading &reading)
+{
+  if ( false == isSendOnDeltaEnabled() ) { return false; }
+  if ( 0 == ( g_readingBuffer.flags & sensor::RTC_FLAG_HAS_REPORTED ) ) { return false; }
+
+  const sensor::SensorIniFileStorage& ini = g_iniStorage;
+  if ( 0 < ini.temp_deadband && ini.temp_deadband * 100 <= abs( reading.tempr - g_readingBuffer.lastTempr ) ) 
+  { 
+    return false; 
+  }
+  if ( 0 < ini.hum_deadband && 
+       ini.hum_deadband * 100 <= abs( static_cast<int32_t>( reading.humid ) - g_readingBuffer.lastHumid ) ) 
+  { 
+    return false; 
+  }
+  return true;
+}
+
+//-- isRadioNeededNextWake -------------------------------------------------------------------------
+// The RF mode must be decided before the deep sleep. With send-on-delta the next reading is expected
+// to be inside the deadband. If it is not, that wake-up costs a short re-wake with the radio on.
+bool isRadioNeededNextWake()
+{
+  if ( sensor::CADENCE_SENSOR_ONLY == g_cadence.mode ) { return false; }
+  if ( g_readingBuffer.count + 1 < g_iniStorage.batch_size ) { return false; }
+  if ( true == isSendOnDeltaEnabled() && g_readingBuffer.silentWakes + 1 < g_iniStorage.max_silent_wakes ) 
+  { 
+    return false; 
+  }
+  return true;
+}
+
+//-- handleSensorModeBuffered ----------------------------------------------------------------------
+// Buffered mode: batching (batch_size > 1) and/or send-on-delta (a deadband is set).
+// A reading is stored in the RTC memory if it is outside the deadband or a heartbeat is due, and
+// only the wake-up which fills the batch has the radio switched on and uploads the readings.
+// Returns only if the readings must be uploaded now, otherwise goes to deep sleep.
+void handleSensorModeBuffered()
+{
+  g_isBufferedMode = true;
+
+  bool isUploadPending = g_readingBuffer.flags & sensor::RTC_FLAG_UPLOAD_PENDING;
+  g_readingBuffer.flags &= ~( sensor::RTC_FLAG_UPLOAD_PENDING | sensor::RTC_FLAG_RADIO_OFF );
+
+  if ( false == isUploadPending ) // The reading of a re-wake is already in the buffer
+  {
+    sensor::RtcReading reading;
+    reading.clock   = g_readingBuffer.clock + millis();
+    reading.tempr   = static_cast<int16_t>( roundf( g_temp * 100 ) );
+    reading.humid   = static_cast<uint16_t>( roundf( g_hum * 100 ) );
+    reading.press   = static_cast<uint16_t>( roundf( g_pres * 10 ) );
+    reading.battery = static_cast<uint8_t>( g_battery );
+
+    if ( true == isInsideDeadband( reading ) && g_readingBuffer.silentWakes + 1 < g_iniStorage.max_silent_wakes )
+    {
+      ++g_readingBuffer.silentWakes;
+      SERIAL_PF("Inside the deadband, silent wake-up %d.\n", g_readingBuffer.silentWakes );
+      g_dispIcons.fields.pclosed = true;
+      drawScreen();
+      goToDeepSleep( true == isRadioNeededNextWake() ? getNextWakeRfMode() : WAKE_RF_DISABLED );
+    }
+
+    g_readingBuffer.push( reading );
+    g_readingBuffer.lastTempr   = reading.tempr;
+    g_readingBuffer.lastHumid   = reading.humid;
+    g_readingBuffer.silentWakes = 0;
+    g_readingBuffer.flags |= sensor::RTC_FLAG_HAS_REPORTED;
+  }
+  SERIAL_PF("Buffered: %d/%d readings.\n", g_readingBuffer.count, g_iniStorage.batch_size );
+
+  if ( g_readingBuffer.count < g_iniStorage.batch_size )
+  {
+    g_dispIcons.fields.pclosed = true;
+    drawScreen();
+    goToDeepSleep( true == isRadioNeededNextWake() ? getNextWakeRfMode() : WAKE_RF_DISABLED );
+  }
+
+  if ( true == g_isRadioOffWake && sensor::CADENCE_SENSOR_ONLY != g_cadence.mode )
+  { 
+    // The radio cannot be switched on in this wake-up, only by a deep sleep
+    SERIAL_PLN("Radio is off. Re-wake for the upload.");
+    g_readingBuffer.flags |= sensor::RTC_FLAG_UPLOAD_PENDING;
+    goToDeepSleep( getNextWakeRfMode(), RADIO_REWAKE_TIME );
+  }
 }
 
 
@@ -1172,6 +1981,7 @@ void handleSensorMode()
   drawScreen();
 
   g_uploadTimeOutTicker.attach(g_iniStorage.upload_timeout, handleTickerUploadTimeout );
+  uint32_t uploadStart = millis();
   
   influx::DataReportConfig rptConfig( g_iniStorage.server_address,
                                       g_iniStorage.server_port,
@@ -1180,6 +1990,10 @@ void handleSensorMode()
                                       g_iniStorage.data_measurement_bucket,
                                       g_iniStorage.data_measurement_name
                                   );
+  rptConfig.tls_profile = g_iniStorage.tls_profile;
+  rptConfig.gzip_min_size = g_iniStorage.gzip_min_size;
+  rptConfig.transport = g_iniStorage.server_transport;
+  rptConfig.requestHeader = &g_requestHeader;
   
 
   DataReportValues rptValues( g_iniStorage.device_id, g_iniStorage.location );
@@ -1189,14 +2003,91 @@ void handleSensorMode()
     rptValues.press = g_pres;
   #endif
   rptValues.battery = g_battery;
+  rptValues.cadence = getSleepInterval();
   rptValues.timeStamp = g_timeStamp;
+  if ( true == g_isWallClockSyncing ) { waitForWallClock(); } // the reading is time stamped too
+  rptValues.epoch     = getWallClock( g_readingBuffer.clock + static_cast<uint32_t>( g_timeStamp ) );
+  if ( true == g_isPrevWakeTimingValid ) { rptValues.wakeTiming = &g_prevWakeTiming; }
+
+  // Time stamps for the buffered and the backlog readings
+  time_t epochNow = 0;
+  if ( true == isBacklogPending() || ( true == g_isBufferedMode && 1 < g_readingBuffer.count ) )
+  {
+    epochNow = waitForWallClock();
+  }
+  uint32_t clockNow = g_readingBuffer.clock + millis();
+
+  // The oldest readings of the failed uploads go first
+  influx::DataReportBacklog rptBacklog;
+  influx::DataReportBacklog *backlog = NULL;
+  if ( true == isBacklogPending() && 0 != epochNow && true == openBacklog() )
+  {
+    rptBacklog.backlog  = &g_uploadBacklog;
+    rptBacklog.count    = getBacklogDrainCount( uploadStart );
+    rptBacklog.clockNow = clockNow;
+    rptBacklog.epochNow = epochNow;
+    backlog = &rptBacklog;
+    SERIAL_PF("Backlog: sending %u of %u readings.\n", rptBacklog.count, g_uploadBacklog.count() );
+  }
+
+  bool isSubmitted = false;
+  if ( true == g_isBufferedMode && 1 < g_readingBuffer.count )
+  {
+    if ( 0 != epochNow )
+    {
+      influx::DataReportBatch rptBatch( g_readingBuffer, clockNow, epochNow );
+      isSubmitted = influx::submitData( rptConfig, rptValues, &rptBatch, backlog );
+      if ( true == isSubmitted ) 
+      { 
+        storeHistory( clockNow, epochNow );
+        g_readingBuffer.clear(); 
+      }
+    }
+    else
+    {
+      // Without time stamps the points would be merged by the server, only the current one is sent.
+      // The others wait in the backlog for the wall clock.
+      SERIAL_PF("No wall clock. %d buffered readings to the backlog.\n", g_readingBuffer.count - 1 );
+      storeBacklog( g_readingBuffer.count - 1 );
+      g_readingBuffer.removeOldest( g_readingBuffer.count - 1 ); // if the backlog is off
+      isSubmitted = influx::submitData( rptConfig, rptValues );
+      if ( true == isSubmitted ) { g_readingBuffer.clear(); }
+    }
+  }
+  else
+  {
+    // A single reading needs no time stamp, the current values are sent
+    isSubmitted = influx::submitData( rptConfig, rptValues, NULL, backlog );
+
+    // Unbuffered, the history keeps the reading even if the upload has failed: the gaps of the
+    // server can be found. A buffered reading is stored when it leaves the buffer.
+    if ( true == g_iniStorage.history_enabled && ( true == isSubmitted || false == g_isBufferedMode ) )
+    {
+      uint32_t clockNow = g_readingBuffer.clock + millis();
+      storeHistory( clockNow, waitForWallClock() );
+    }
+    if ( true == isSubmitted ) { g_readingBuffer.clear(); }
+  }
   
-  if ( true == influx::submitData(rptConfig, rptValues ) )
+  if ( NULL != backlog )
+  {
+    if ( true == isSubmitted ) { g_uploadBacklog.remove( rptBacklog.count ); }
+    g_readingBuffer.backlogCount = g_uploadBacklog.count();
+    g_uploadBacklog.close();
+  }
+
+  if ( true == isSubmitted )
   {
     
     g_dispIcons.allFields = 0;
     //g_dispIcons.fields.like = true;
   }
+  else
+  {
+    clearWiFiCache(); // The cached lease may be the reason, use DHCP next time
+    storeBacklog();
+  }
+  g_wakeTimer.finish(); // This wake-up is reported by the next successful upload
   Serial.printf("Diff: %llu ms\n", millis() - g_timeStamp );
 
 
@@ -1211,7 +2102,7 @@ void handleSensorMode()
   g_dispIcons.fields.pclosed = true;
   drawScreen();
   
-  ESP.deepSleep(  g_iniStorage.upload_freq * 10e5, WAKE_RF_DEFAULT );
+  goToDeepSleep( getNextWakeRfMode() );
 }
 
 //-- handleTickerBatteryMonitor() ------------------------------------------------------------------
@@ -1228,8 +2119,9 @@ uint64_t g_btnTimeStamp = 0;
 //-- handleSetupModeLoop ---------------------------------------------------------------------------
 void handleSetupModeLoop()
 {
-  // handle HTTP requests and clients
-  server.handleClient();
+  // The HTTP requests are handled asynchronously, only the config writes and the restart are left
+  g_webConfMan.loop();
+  g_telemetry.loop();
 
   // handle OTA requests and clients
   ArduinoOTA.handle();
@@ -1327,11 +2219,12 @@ void setupWebServer()
   SERIAL_PF("AP IP address: %s\n", WiFi.softAPIP().toString().c_str() );
   // screenAPStarted();
 
-  server.onNotFound([]() {                            // If the client requests any URI
-  if ( !g_webConfMan.handleFileRead( server.uri(), server, g_iniStorage ) )                  // send it if it exists
-    server.send(404, "text/plain", "404: Not Found"); // otherwise, respond with a 404 (Not Found) error
+  // The files and the api are handled by g_webConfMan
+  server.onNotFound([](AsyncWebServerRequest *request) { 
+    request->send(404, "text/plain", "404: Not Found"); // otherwise, respond with a 404 (Not Found) error
   });
 
+  g_webConfMan.begin(server, g_iniStorage);
   server.begin();                           // Start the server
   SERIAL_PLN( F("HTTP server started") );
 
@@ -1359,6 +2252,7 @@ void setupInflux()
                                       g_iniStorage.data_measurement_bucket,
                                       g_iniStorage.data_measurement_name
                                     );
+  rptConfig.requestHeader = &g_requestHeader;
 
   DataReportValues rptValues( "TSH99", "usBoxR" );
   // rptValues.deviceId = "TSH99";
@@ -1378,6 +2272,7 @@ void setupInflux()
 //-- SETUP FULL ------------------------------------------------------------------------------------
 void setupFull() 
 {
+  g_wakeTimer.end( sensor::WAKE_PHASE_BOOT );
   pinMode( BTN_CONFIG, INPUT_PULLUP); // Extra button for swith on config mode.
   g_timeStamp = millis();
 
@@ -1390,52 +2285,77 @@ void setupFull()
   ///////////////g_isInSetupMode = true;
   SERIAL_PF("Config mode triggered: %s\n", ( true == g_isInSetupMode ? "yes" : "no" ) );
 
+  loadWiFiCache();
+  loadReadingBuffer();
+  g_isPrevWakeTimingValid = g_wakeTimer.loadPrevious( g_prevWakeTiming );
+
   // Init screen
   u8g2.begin();
   u8g2.setContrast( 155 ); // 155 - Home; 127 - Office
 
-  sensor::SensorConfigFile senConFile;
-
-  // Mount the LittleFS  
-  if ( false == LittleFS.begin() )  
-  { 
-    SERIAL_PLN("FATAL ERROR: LittleFS.begin() failed"); 
-    printScreenLine("File system error.");
-  
-    if ( true == g_isInSetupMode )
-    {
-      delay(2000);
-      handleSetupMode();
-      return;
-    }
-
-    delay(35000); // TODO find-up a better error strategy
-    ESP.restart();
+  // A sensor wake-up from deep sleep reads the config from the flash cache, LittleFS is not mounted
+  bool isConfigCached = false;
+  if ( false == g_isInSetupMode && REASON_DEEP_SLEEP_AWAKE == ESP.getResetInfoPtr()->reason )
+  {
+    g_wakeTimer.begin();
+    isConfigCached = sensor::loadConfigCache( g_iniStorage );
+    g_wakeTimer.end( sensor::WAKE_PHASE_INI_READ );
   }
-  
-  // sensor::SensorIniFileStorage iniStorage;
-  // Read the Ini file 
-  if ( false == senConFile.readIniFile(g_iniStorage) )
+
+  if ( false == isConfigCached )
   {
-    SERIAL_PLN("FATAL ERROR: Failed to read the ini file"); 
-    printScreenLine("ini file error.");
+    sensor::SensorConfigFile senConFile;
 
-    if ( true == g_isInSetupMode )
+    // Mount the LittleFS  
+    if ( false == mountFileSystem() )  
+    { 
+      SERIAL_PLN("FATAL ERROR: LittleFS.begin() failed"); 
+      printScreenLine("File system error.");
+    
+      if ( true == g_isInSetupMode )
+      {
+        delay(2000);
+        handleSetupMode();
+        return;
+      }
+
+      delay(35000); // TODO find-up a better error strategy
+      ESP.restart();
+    }
+    
+    // Read the Ini file 
+    g_wakeTimer.begin();
+    bool isIniRead = senConFile.loadConfig(g_iniStorage);
+    g_wakeTimer.end( sensor::WAKE_PHASE_INI_READ );
+    if ( false == isIniRead )
     {
-      delay(2000);
-      handleSetupMode();
-      return;
+      SERIAL_PLN("FATAL ERROR: Failed to read the ini file"); 
+      printScreenLine("ini file error.");
+
+      if ( true == g_isInSetupMode )
+      {
+        delay(2000);
+        handleSetupMode();
+        return;
+      }
+
+      delay(35000); // TODO find-up a better error strategy
+      ESP.restart();
     }
 
-    delay(35000); // TODO find-up a better error strategy
-    ESP.restart();
+    if ( false == g_isInSetupMode ) { sensor::storeConfigCache( g_iniStorage ); }
   }
+
+  g_requestHeader.build( g_iniStorage.server_address, influx::SERVER_REQ_URL_V2,
+                         g_iniStorage.data_measurement_org, g_iniStorage.data_measurement_bucket,
+                         g_iniStorage.server_auth_token );
   
   // Set-up screen
   u8g2.setContrast( g_iniStorage.display_contrast); // 155 - Home; 127 - Office
   u8g2.setDisplayRotation( g_iniStorage.display_rotation == true ? U8G2_R0 : U8G2_R2 );
   
   // Set-up BME280 sensor
+  g_wakeTimer.begin();
   Wire.begin(BME280_SDA, BME280_SCL);
   //printScreenLine("Checking BME Sensors.");
   #ifdef SENSOR_BME280
@@ -1454,6 +2374,8 @@ void setupFull()
     printScreenLine( "Sensors Error!");
     delay(10000);
   }
+  g_wakeTimer.end( sensor::WAKE_PHASE_SENSOR );
+  if ( false == g_isInSetupMode ) { planCadence(); }
 
   g_dispIcons.allFields = 0b00000000;
   convertSensorDataToChar();
@@ -1464,7 +2386,29 @@ void setupFull()
     SERIAL_PLN("WiFi is disabled. Updating and showing sensor data.")
     g_dispIcons.fields.pclosed = true;
     drawScreen();
-    ESP.deepSleep(  g_iniStorage.upload_freq * 10e5, WAKE_RF_DISABLED );
+    ESP.deepSleep(  getSleepInterval() * 10e5, WAKE_RF_DISABLED );
+  }
+
+  if ( false == g_isInSetupMode && ( 1 < g_iniStorage.batch_size || true == isSendOnDeltaEnabled() ) )
+  {
+    handleSensorModeBuffered(); // Returns only if the readings must be uploaded
+  }
+
+  if ( false == g_isInSetupMode && sensor::CADENCE_SENSOR_ONLY == g_cadence.mode )
+  {
+    // The battery is nearly empty: the readings wait in the upload backlog, the radio stays off
+    SERIAL_PLN("Battery critical. Sensor only wake-up.");
+    storeBacklog();
+    g_dispIcons.fields.pclosed = true;
+    drawScreen();
+    goToDeepSleep( WAKE_RF_DISABLED );
+  }
+
+  if ( false == g_isInSetupMode && false == g_isBufferedMode && true == g_isRadioOffWake )
+  {
+    // The battery has recovered after a sensor-only wake-up, the radio needs a deep sleep to start
+    SERIAL_PLN("Radio is off. Re-wake for the upload.");
+    goToDeepSleep( getNextWakeRfMode(), RADIO_REWAKE_TIME );
   }
 
   if ( true == g_isInSetupMode )
@@ -1495,8 +2439,8 @@ void loopEmpty()
 //-- handleSetupModeLoop ---------------------------------------------------------------------------
 void loopWebServer()
 {
-  // handle HTTP requests and clients
-  server.handleClient();
+  // The HTTP requests are handled asynchronously, only the config writes and the restart are left
+  g_webConfMan.loop();
 
   // // handle OTA requests and clients
   // ArduinoOTA.handle();
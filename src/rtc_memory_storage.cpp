@@ -0,0 +1,91 @@
+#include "rtc_memory_storage.h"
+
+#include <GSiDebug.h>
+
+using namespace sensor;
+
+//-- calculateCrc32 --------------------------------------------------------------------------------
+uint32_t sensor::calculateCrc32(const void *data, size_t length, uint32_t crc /* 0 */)
+{
+  const uint8_t *bytes = static_cast<const uint8_t *>( data );
+
+  crc = ~crc;
+  while ( 0 < length-- )
+  {
+    crc ^= *bytes++;
+    for ( uint8_t i = 0; i < 8; ++i ) { crc = ( crc >> 1 ) ^ ( 0xEDB88320 & ( 0 - ( crc & 1 ) ) ); }
+  }
+  return ~crc;
+}
+
+//-- readRtcRecord ---------------------------------------------------------------------------------
+bool sensor::readRtcRecord(uint8_t block, uint32_t *data, size_t size)
+{
+  uint32_t crc = 0;
+  if ( false == ESP.rtcUserMemoryRead( block, &crc, sizeof(crc) ) )  { return false; }
+  if ( false == ESP.rtcUserMemoryRead( block + 1, data, size ) )     { return false; }
+
+  if ( crc != calculateCrc32( data, size ) )
+  {
+    SERIAL_PF("RTC record @%d: CRC mismatch\n", block);
+    return false;
+  }
+  return true;
+}
+
+//-- writeRtcRecord --------------------------------------------------------------------------------
+bool sensor::writeRtcRecord(uint8_t block, const uint32_t *data, size_t size)
+{
+  uint32_t crc = calculateCrc32( data, size );
+  if ( false == ESP.rtcUserMemoryWrite( block + 1, const_cast<uint32_t *>( data ), size ) ) { return false; }
+  return ESP.rtcUserMemoryWrite( block, &crc, sizeof(crc) );
+}
+
+//-- invalidateRtcRecord ---------------------------------------------------------------------------
+// Stores an inverted CRC, so the next read fails whatever the content is.
+bool sensor::invalidateRtcRecord(uint8_t block, size_t size)
+{
+  uint32_t crc  = 0;
+  uint32_t word = 0;
+  for ( size_t offset = 0; offset < size; offset += sizeof(word) )
+  {
+    ESP.rtcUserMemoryRead( block + 1 + offset / sizeof(word), &word, sizeof(word) );
+    crc = calculateCrc32( &word, sizeof(word), crc );
+  }
+  crc = ~crc;
+  return ESP.rtcUserMemoryWrite( block, &crc, sizeof(crc) );
+}
+
+//-- RtcReadingBuffer::push ------------------------------------------------------------------------
+void RtcReadingBuffer::push(const RtcReading &reading)
+{
+  if ( RTC_BATCH_MAX == count )
+  {
+    SERIAL_PLN("Reading buffer full, the oldest reading is dropped.");
+    head = ( head + 1 ) % RTC_BATCH_MAX;
+    --count;
+  }
+  readings[ ( head + count ) % RTC_BATCH_MAX ] = reading;
+  ++count;
+}
+
+//-- RtcReadingBuffer::at --------------------------------------------------------------------------
+const RtcReading &RtcReadingBuffer::at(uint8_t index) const
+{
+  return readings[ ( head + index ) % RTC_BATCH_MAX ];
+}
+
+//-- RtcReadingBuffer::removeOldest ----------------------------------------------------------------
+void RtcReadingBuffer::removeOldest(uint8_t removeCount)
+{
+  removeCount = std::min( removeCount, count );
+  head   = ( head + removeCount ) % RTC_BATCH_MAX;
+  count -= removeCount;
+}
+
+//-- RtcReadingBuffer::clear -----------------------------------------------------------------------
+void RtcReadingBuffer::clear()
+{
+  head  = 0;
+  count = 0;
+}
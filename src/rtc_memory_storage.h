@@ -0,0 +1,216 @@
+#ifndef __RTC_MEMORY_STORAGE_H__
+#define __RTC_MEMORY_STORAGE_H__
+
+#include <Arduino.h>
+
+#include "sensor_config_file_management.h"
+
+namespace sensor
+{
+
+//-- RTC USER MEMORY -------------------------------------------------------------------------------
+// The RTC user memory (512 bytes) survives ESP.deepSleep() but not a power loss, so every record
+// is protected by a CRC32 stored in the block in front of it.
+// The memory is addressed in 4 byte blocks. The first 32 blocks (128 bytes) are used by eboot for
+// the OTA command, the records of the application start at block 32 (see the layout below).
+const uint8_t RTC_BLOCK_FIRST = 32;
+const uint8_t RTC_BLOCK_END   = 128;
+
+//-- WIFI FAST RECONNECT CACHE ---------------------------------------------------------------------
+// How many warm wake-ups are allowed without a full RF calibration
+const uint16_t RTC_RF_CAL_INTERVAL = 64;
+// The static IP config is dropped after this many seconds and a new DHCP lease is requested
+const uint32_t RTC_WIFI_LEASE_MAX_AGE = 4 * 3600;
+
+//-- RF calibration policy of the next wake-up
+enum RfCalPolicy : uint8_t
+{
+  RF_CAL_POLICY_FULL = 0, // default SDK behaviour (WAKE_RF_DEFAULT)
+  RF_CAL_POLICY_SKIP = 1, // the AP is known, skip the calibration (WAKE_NO_RFCAL)
+};
+
+struct RtcWiFiCache
+{
+  uint8_t  bssid[6]    = { 0 };
+  uint8_t  channel     = 0;
+  uint8_t  rfCalPolicy = RF_CAL_POLICY_FULL;
+
+  // The last DHCP lease
+  uint32_t localIp    = 0;
+  uint32_t gateway    = 0;
+  uint32_t subnetMask = 0;
+  uint32_t dns        = 0;
+
+  uint32_t leaseAge        = 0; // seconds since the lease has been received
+  uint16_t wakesSinceRfCal = 0;
+  uint16_t reserved        = 0;
+};
+
+//-- READING BUFFER --------------------------------------------------------------------------------
+// Readings collected across the deep sleeps in buffered mode (batching and send-on-delta)
+const uint8_t RTC_BATCH_MAX = MAX_DATA_BATCH_SIZE;
+
+// flags of RtcReadingBuffer
+const uint8_t RTC_FLAG_RADIO_OFF      = 0x01; // the current wake-up was programmed with WAKE_RF_DISABLED
+const uint8_t RTC_FLAG_UPLOAD_PENDING = 0x02; // deep sleep only to switch on the radio, upload at once
+const uint8_t RTC_FLAG_HAS_REPORTED   = 0x04; // lastTempr and lastHumid are set
+const uint8_t RTC_FLAG_SENSOR_ONLY    = 0x08; // the battery governor has switched off the uploads
+
+struct RtcReading // fixed point values to fit into 12 bytes
+{
+  uint32_t clock   = 0; // device clock (ms) at the time of the measurement
+  int16_t  tempr   = 0; // 1/100 oC
+  uint16_t humid   = 0; // 1/100 %
+  uint16_t press   = 0; // 1/10 hPa
+  uint8_t  battery = 0; // %
+  uint8_t  reserved = 0;
+};
+
+struct RtcReadingBuffer
+{
+  // The device clock (ms) is advanced by the awake and the programmed sleep time at every deep
+  // sleep. It only measures the time elapsed between the readings, it is not a wall clock.
+  // It also time stamps the upload backlog, it wraps around after 49 days.
+  uint32_t clock = 0;
+  uint8_t  head  = 0; // index of the oldest reading
+  uint8_t  count = 0;
+  uint8_t  flags = 0;
+  uint8_t  reserved = 0;
+
+  // Send-on-delta: the last reported values and the number of wake-ups without a report since then
+  int16_t  lastTempr   = 0; // 1/100 oC
+  uint16_t lastHumid   = 0; // 1/100 %
+  uint16_t silentWakes = 0;
+  uint16_t backlogCount = 0; // readings in the upload backlog file, it is only opened if needed
+
+  RtcReading readings[RTC_BATCH_MAX];
+
+  //-- push: if the buffer is full, the oldest reading is overwritten
+  void push(const RtcReading &reading);
+  //-- at: 0 is the oldest reading
+  const RtcReading &at(uint8_t index) const;
+  //-- removeOldest: e.g. after they have been moved to the upload backlog
+  void removeOldest(uint8_t removeCount);
+  void clear();
+};
+
+//-- WAKE-UP TIMING --------------------------------------------------------------------------------
+// Phases of a sensor wake-up, the names are the field names of the health measurement
+enum WakePhase : uint8_t
+{
+  WAKE_PHASE_BOOT = 0,  // until setup() starts
+  WAKE_PHASE_FS_MOUNT,  // LittleFS.begin()
+  WAKE_PHASE_INI_READ,  // config flash cache or loadConfig(): snapshot or ini file
+  WAKE_PHASE_SENSOR,    // setupBME280() and readSensors()
+  WAKE_PHASE_WIFI,      // WiFi association (and DHCP)
+  WAKE_PHASE_DNS,       // server address resolution
+  WAKE_PHASE_TLS,       // MFLN probe, TCP connection and TLS handshake
+  WAKE_PHASE_REQUEST,   // writing the HTTP request
+  WAKE_PHASE_STATUS,    // reading the HTTP status
+  WAKE_PHASE_COUNT
+};
+
+struct RtcWakeTiming
+{
+  uint32_t durations[WAKE_PHASE_COUNT] = { 0 }; // us
+  uint32_t total = 0; // us, from the start of the core to the end of the upload
+};
+
+//-- TLS SESSION -----------------------------------------------------------------------------------
+// The BearSSL::Session object (br_ssl_session_parameters) for an abbreviated handshake
+const uint8_t RTC_TLS_SESSION_SIZE = 88;
+
+struct RtcTlsSession
+{
+  uint32_t serverHash = 0; // CRC32 of the server address and port the session belongs to
+  uint8_t  parameters[RTC_TLS_SESSION_SIZE] = { 0 };
+};
+
+// Result of the Maximum Fragment Length probe of the server, it is done once
+struct RtcTlsMfln
+{
+  uint32_t serverHash = 0;
+  uint16_t maxFragmentLength = 0; // 0 - the server does not support MFLN
+  uint16_t reserved = 0;
+};
+
+//-- HISTORY STORE ---------------------------------------------------------------------------------
+// The newest block appended to the history segments, so a wake-up does not have to open them
+struct RtcHistoryCursor
+{
+  uint32_t sequence = 0;
+  uint32_t reserved = 0;
+};
+
+//-- WALL CLOCK ------------------------------------------------------------------------------------
+// The wall clock at a device clock value (RtcReadingBuffer::clock + millis()), taken from the Date
+// header of the last upload response (SNTP for the UDP transports). The device clock carries it
+// across the deep sleeps, so the readings are time stamped without SNTP. It drifts with the sleep
+// timer until it is set again.
+struct RtcWallClock
+{
+  uint32_t epoch = 0; // s
+  uint32_t clock = 0; // device clock (ms) at epoch
+};
+
+//-- CONFIG FLASH CACHE ----------------------------------------------------------------------------
+// The generation of the config copy in the flash, see config_flash_cache.h
+struct RtcConfigGeneration
+{
+  uint32_t generation = 0;
+};
+
+//-- RTC USER MEMORY LAYOUT ------------------------------------------------------------------------
+// A record occupies its CRC block and sizeof / 4 data blocks, the next record starts after them
+constexpr uint8_t getRtcBlockAfter(uint8_t block, size_t size) { return block + 1 + size / 4; }
+
+const uint8_t RTC_BLOCK_WIFI_CACHE     = RTC_BLOCK_FIRST;
+const uint8_t RTC_BLOCK_READING_BUFFER = getRtcBlockAfter( RTC_BLOCK_WIFI_CACHE,     sizeof(RtcWiFiCache) );
+const uint8_t RTC_BLOCK_WAKE_TIMING    = getRtcBlockAfter( RTC_BLOCK_READING_BUFFER, sizeof(RtcReadingBuffer) );
+const uint8_t RTC_BLOCK_TLS_SESSION    = getRtcBlockAfter( RTC_BLOCK_WAKE_TIMING,    sizeof(RtcWakeTiming) );
+const uint8_t RTC_BLOCK_TLS_MFLN       = getRtcBlockAfter( RTC_BLOCK_TLS_SESSION,    sizeof(RtcTlsSession) );
+const uint8_t RTC_BLOCK_CONFIG_GEN     = getRtcBlockAfter( RTC_BLOCK_TLS_MFLN,       sizeof(RtcTlsMfln) );
+const uint8_t RTC_BLOCK_HISTORY_CURSOR = getRtcBlockAfter( RTC_BLOCK_CONFIG_GEN,     sizeof(RtcConfigGeneration) );
+const uint8_t RTC_BLOCK_WALL_CLOCK     = getRtcBlockAfter( RTC_BLOCK_HISTORY_CURSOR, sizeof(RtcHistoryCursor) );
+
+static_assert( getRtcBlockAfter( RTC_BLOCK_WALL_CLOCK, sizeof(RtcWallClock) ) <= RTC_BLOCK_END,
+               "The RTC records do not fit into the RTC user memory" );
+
+//-- calculateCrc32 --------------------------------------------------------------------------------
+// Standard (reflected, 0xEDB88320) CRC32. Pass the previous result as crc to continue a calculation.
+uint32_t calculateCrc32(const void *data, size_t length, uint32_t crc = 0);
+
+//-- readRtcRecord / writeRtcRecord ----------------------------------------------------------------
+// Size must be a multiple of 4. The record occupies size / 4 + 1 blocks starting at block.
+bool readRtcRecord(uint8_t block, uint32_t *data, size_t size);
+bool writeRtcRecord(uint8_t block, const uint32_t *data, size_t size);
+bool invalidateRtcRecord(uint8_t block, size_t size);
+
+//-- loadRtcRecord ---------------------------------------------------------------------------------
+// returns false if the record is missing or corrupted (e.g. after power-on)
+template <typename T>
+bool loadRtcRecord(uint8_t block, T &record)
+{
+  static_assert( 0 == sizeof(T) % 4, "RTC records must be a multiple of 4 bytes" );
+  return readRtcRecord( block, reinterpret_cast<uint32_t *>( &record ), sizeof(T) );
+}
+
+//-- saveRtcRecord ---------------------------------------------------------------------------------
+template <typename T>
+bool saveRtcRecord(uint8_t block, const T &record)
+{
+  static_assert( 0 == sizeof(T) % 4, "RTC records must be a multiple of 4 bytes" );
+  return writeRtcRecord( block, reinterpret_cast<const uint32_t *>( &record ), sizeof(T) );
+}
+
+//-- clearRtcRecord --------------------------------------------------------------------------------
+template <typename T>
+bool clearRtcRecord(uint8_t block)
+{
+  static_assert( 0 == sizeof(T) % 4, "RTC records must be a multiple of 4 bytes" );
+  return invalidateRtcRecord( block, sizeof(T) );
+}
+
+}; // namespace
+
+#endif // __RTC_MEMORY_STORAGE_H__
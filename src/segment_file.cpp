@@ -0,0 +1,61 @@
+#include "segment_file.h"
+
+#include <LittleFS.h>
+
+#include <GSiDebug.h>
+
+using namespace sensor;
+
+const char SEGMENT_EXTENSION[] = ".bin";
+
+//-- parseSegmentNumber ----------------------------------------------------------------------------
+// The other files of the directory are not segments, false is returned for them
+static bool parseSegmentNumber(const String &fileName, uint32_t &number)
+{
+  const char *name = fileName.c_str();
+  char *end = NULL;
+  number = strtoul( name, &end, 10 );
+  return end != name && 0 == strcmp( end, SEGMENT_EXTENSION );
+}
+
+//-- getSegmentPath --------------------------------------------------------------------------------
+void sensor::getSegmentPath(const char *directory, uint32_t number, char *path)
+{
+  snprintf( path, SEGMENT_PATH_MAX_LENGTH, "%s%u%s", directory, static_cast<unsigned>( number ), SEGMENT_EXTENSION );
+}
+
+//-- findSegments ----------------------------------------------------------------------------------
+bool sensor::findSegments(const char *directory, uint32_t &first, uint32_t &last)
+{
+  bool isFound = false;
+  Dir dir = LittleFS.openDir( directory );
+  while ( true == dir.next() )
+  {
+    uint32_t number = 0;
+    if ( true == dir.isDirectory() || false == parseSegmentNumber( dir.fileName(), number ) ) { continue; }
+
+    first   = ( true == isFound ? std::min( first, number ) : number );
+    last    = ( true == isFound ? std::max( last, number ) : number );
+    isFound = true;
+  }
+  return isFound;
+}
+
+//-- removeSegments --------------------------------------------------------------------------------
+void sensor::removeSegments(const char *directory, uint32_t number)
+{
+  uint32_t first = 0;
+  uint32_t last  = 0;
+  if ( false == findSegments( directory, first, last ) ) { return; }
+
+  char path[SEGMENT_PATH_MAX_LENGTH];
+  for ( ; first < number && first <= last; ++first )
+  {
+    getSegmentPath( directory, first, path );
+    if ( true == LittleFS.exists( path ) )
+    {
+      SERIAL_PF("Segment removed: %s\n", path);
+      LittleFS.remove( path );
+    }
+  }
+}
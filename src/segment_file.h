@@ -0,0 +1,32 @@
+#ifndef __SEGMENT_FILE_H__
+#define __SEGMENT_FILE_H__
+
+#include <Arduino.h>
+
+namespace sensor
+{
+
+//-- SEGMENT FILES ---------------------------------------------------------------------------------
+// An append-only log kept in the numbered files of a directory: "<directory><number>.bin". LittleFS
+// writes a file copy-on-write, so a write into the middle of a file rewrites the rest of the file,
+// while an append rewrites its last block only. The records are therefore only appended, and the
+// oldest ones are dropped a whole file at a time. The numbers increase and are never reused.
+// A LittleFS file update becomes visible at once when the file is closed: a reset during an
+// append loses the append, it never leaves a partial record.
+const size_t SEGMENT_PATH_MAX_LENGTH = 32;
+
+//-- getSegmentPath --------------------------------------------------------------------------------
+// path must have room for SEGMENT_PATH_MAX_LENGTH characters
+void getSegmentPath(const char *directory, uint32_t number, char *path);
+
+//-- findSegments ----------------------------------------------------------------------------------
+// The first and the last number in the directory, returns false if there is no segment
+bool findSegments(const char *directory, uint32_t &first, uint32_t &last);
+
+//-- removeSegments --------------------------------------------------------------------------------
+// The segments with a number below the given one
+void removeSegments(const char *directory, uint32_t number);
+
+}; // namespace
+
+#endif // __SEGMENT_FILE_H__
@@ -1,353 +1,419 @@
 
 #include "sensor_ini_file_storage.h"
 #include "sensor_config_file_management.h"
+#include "rtc_memory_storage.h"
+#include "config_schema.h"
 
-#include <SPIFFSIniFile.h>
 #include <LittleFS.h>
 
 #include <GSiDebug.h>
 
 using namespace sensor;
 
-bool SensorConfigFile::readIniFile(SensorIniFileStorage &iniFileStorage)
+//-- Header of the binary config snapshot, SensorIniFileStorage follows it
+struct IniSnapshotHeader
+{
+  uint32_t magic       = INI_SNAPSHOT_MAGIC;
+  uint16_t version     = INI_SNAPSHOT_VERSION;
+  uint16_t storageSize = sizeof( SensorIniFileStorage );
+  uint32_t iniFileSize = 0; // size of the ini file the snapshot was made of
+  uint32_t iniFileCrc  = 0; // CRC32 of the ini file, an edit may keep its size
+  uint32_t crc         = 0; // CRC32 of the storage
+};
+
+struct IniSnapshot
 {
-  const size_t INI_BUFFER_LEN = 512;
-  char iniBuffer[INI_BUFFER_LEN];
+  IniSnapshotHeader    header;
+  SensorIniFileStorage storage;
+};
 
-  //-- Initialise, load and validate the Ini file --------------------------------------------------
-  // Open the Ini file  
-  SPIFFSIniFile ini(INI_FILENAME, (char *)"r" );
-  if (false == ini.open() ) 
+//-- getIniFileCrc ---------------------------------------------------------------------------------
+// the size and the CRC32 of the ini file, both are 0 if the file does not exist
+static void getIniFileCrc(uint32_t &size, uint32_t &crc)
+{
+  size = 0;
+  crc  = 0;
+  File iniFile = LittleFS.open( INI_FILENAME, "r" );
+  if ( false == iniFile ) { return; }
+
+  uint8_t buffer[128];
+  size_t  length = 0;
+  while ( 0 < ( length = iniFile.read( buffer, sizeof( buffer ) ) ) )
   {
-    SERIAL_PF( "Ini file '%s' does not exisit\n", INI_FILENAME);
-    return false;
+    crc   = calculateCrc32( buffer, length, crc );
+    size += length;
   }
-  SERIAL_PLN("Ini file exists");
+  iniFile.close();
+}
+
+//-- Record of the config journal. It is followed by the value (padded to 4 bytes) and the CRC32 of
+//   the record and the value.
+struct IniJournalRecord
+{
+  uint32_t fieldHash = 0;
+  uint16_t size      = 0;
+  uint16_t reserved  = 0;
+};
+
+const size_t INI_JOURNAL_WRITE_MAX_SIZE = 128; // BSSID, channel, connection attempts fit into it
+
+//-- alignJournalSize ------------------------------------------------------------------------------
+static size_t alignJournalSize(size_t size) { return ( size + 3 ) & ~static_cast<size_t>( 3 ); }
 
-  // Check the file is valid. This can be used to warn if any lines
-  // are longer than the buffer.
-  if ( false == ini.validate(iniBuffer, INI_BUFFER_LEN) )
+//-- loadConfig ------------------------------------------------------------------------------------
+bool SensorConfigFile::loadConfig(SensorIniFileStorage &iniFileStorage)
+{
+  if ( false == readSnapshot( iniFileStorage ) ) 
   {
-    SERIAL_PF( "ini file '%s' is not valid\n", ini.getFilename() );
-    printErrorMessage(ini.getError());
-    return false;
+    SERIAL_PLN("No valid config snapshot. Reading the ini file.");
+    if ( false == readIniFile( iniFileStorage ) ) { return false; }
+
+    writeSnapshot( iniFileStorage );
   }
+  return replayJournal( iniFileStorage );
+}
+
+//-- saveChanges -----------------------------------------------------------------------------------
+bool SensorConfigFile::saveChanges(const SensorIniFileStorage &iniFileStorage, ConfigFieldMask changedFields)
+{
+  uint8_t buffer[INI_JOURNAL_WRITE_MAX_SIZE];
+  size_t  length = 0;
+
+  for ( uint8_t i = 0; i < CONFIG_FIELD_COUNT && 0 != changedFields; ++i )
+  {
+    if ( 0 == ( changedFields & ( 1ULL << i ) ) ) { continue; }
+    changedFields &= ~( 1ULL << i );
+
+    const ConfigField &field = CONFIG_FIELDS[i];
+    size_t recordLength = sizeof( IniJournalRecord ) + alignJournalSize( field.size ) + sizeof( uint32_t );
+    if ( sizeof( buffer ) < length + recordLength ) 
+    { 
+      length = 0; // too many changes for the journal
+      break; 
+    }
+
+    IniJournalRecord record;
+    record.fieldHash = field.hash;
+    record.size      = field.size;
+    uint8_t *start = buffer + length;
+    memset( start, 0, recordLength );
+    memcpy( start, &record, sizeof( record ) );
+    memcpy( start + sizeof( record ), reinterpret_cast<const uint8_t *>( &iniFileStorage ) + field.offset, field.size );
+
+    uint32_t crc = calculateCrc32( start, recordLength - sizeof( crc ) );
+    memcpy( start + recordLength - sizeof( crc ), &crc, sizeof( crc ) );
+    length += recordLength;
+  }
+
+  File journalFile = LittleFS.open( INI_JOURNAL_FILENAME, "a" );
+  if ( 0 == length || false == journalFile || INI_JOURNAL_MAX_SIZE < journalFile.size() + length )
+  {
+    // Compaction: the ini file gets every change, the journal is removed by writeIniFile()
+    if ( true == journalFile ) { journalFile.close(); }
+    SERIAL_PLN("Config journal full, rewriting the ini file.");
+    return writeIniFile( iniFileStorage );
+  }
+
+  bool result = ( length == journalFile.write( buffer, length ) );
+  journalFile.close();
+  SERIAL_PF("Config journal: %u bytes appended\n", static_cast<unsigned>( length ) );
+  return result;
+}
+
+//-- replayJournal ---------------------------------------------------------------------------------
+bool SensorConfigFile::replayJournal(SensorIniFileStorage &iniFileStorage)
+{
+  File journalFile = LittleFS.open( INI_JOURNAL_FILENAME, "r" );
+  if ( false == journalFile ) { return true; } // nothing has changed since the ini file
+
+  uint8_t buffer[INI_JOURNAL_WRITE_MAX_SIZE];
+  uint8_t recordCount = 0;
+  while ( sizeof( IniJournalRecord ) == journalFile.read( buffer, sizeof( IniJournalRecord ) ) )
+  {
+    IniJournalRecord record;
+    memcpy( &record, buffer, sizeof( record ) );
+
+    size_t recordLength = sizeof( record ) + alignJournalSize( record.size ) + sizeof( uint32_t );
+    if ( sizeof( buffer ) < recordLength ) { break; }
+
+    size_t restLength = recordLength - sizeof( record );
+    if ( restLength != journalFile.read( buffer + sizeof( record ), restLength ) ) { break; }
+
+    uint32_t crc = 0;
+    memcpy( &crc, buffer + recordLength - sizeof( crc ), sizeof( crc ) );
+    if ( crc != calculateCrc32( buffer, recordLength - sizeof( crc ) ) ) { break; }
 
-  uint8_t res = 0;
-
-  //-- Process the ini file content ----------------------------------------------------------------
-    // [network]
-      // wifi_enabled=true
-      // wifi_ap_ssid=*****
-      // wifi_ap_pwd=*****
-      // wifi_ap_bssid=00-00-00-00-00-00
-      // wifi_ap_channel=*
-      // wifi_con_delay=150
-      // wifi_max_con_attempts=240
-    SERIAL_PF("[%s]\n", INI_NET_SECTION);
-
-    bool value = false;
-    res += !parseIniBool(ini, INI_NET_SECTION, INI_NET_WIFI_ENABLED, iniBuffer, INI_BUFFER_LEN, value ); 
-      iniFileStorage.wifi_enabled = value; 
-    res += !parseIniString(ini, INI_NET_SECTION, INI_NET_WIFI_AP_SSID,           iniBuffer, INI_BUFFER_LEN, iniFileStorage.wifi_ap_ssid, MAX_LEN_SSID ); 
-    res += !parseIniString(ini, INI_NET_SECTION, INI_NET_WIFI_AP_PWD,            iniBuffer, INI_BUFFER_LEN, iniFileStorage.wifi_ap_pwd,  MAX_LEN_PWD  ); 
-    res += !parseIniNumber(ini, INI_NET_SECTION, INI_NET_WIFI_CON_DELAY,         iniBuffer, INI_BUFFER_LEN, iniFileStorage.wifi_con_delay); 
-    res += !parseIniNumber(ini, INI_NET_SECTION, INI_NET_WIFI_MAX_CON_ATTEMPTS,  iniBuffer, INI_BUFFER_LEN, iniFileStorage.wifi_max_con_attempts); 
-
-    //-- BSSID
-    if ( false == ini.getMACAddress(INI_NET_SECTION, INI_NET_WIFI_AP_BSSID, iniBuffer, INI_BUFFER_LEN, iniFileStorage.wifi_ap_bssid ) )
+    int8_t index = findConfigField( record.fieldHash );
+    if ( 0 <= index && CONFIG_FIELDS[index].size == record.size )
     {
-      SERIAL_PF("Error parsing: %s / %s => ", INI_NET_SECTION, INI_NET_WIFI_AP_BSSID);
-      printErrorMessage(ini.getError());
-      return false;
+      memcpy( reinterpret_cast<uint8_t *>( &iniFileStorage ) + CONFIG_FIELDS[index].offset, 
+              buffer + sizeof( record ), record.size );
+      ++recordCount;
     }
-    
-    #ifdef GSI_DEBUG
-      const uint8_t *mac = iniFileStorage.wifi_ap_bssid;
-      SERIAL_PF("wifi_ap_bssid: %x-%x-%x-%x-%x-%x\n", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-    #endif
-    //-- Channel
-    res += !parseIniNumber(ini, INI_NET_SECTION, INI_NET_WIFI_AP_CHANNEL, iniBuffer, INI_BUFFER_LEN, iniFileStorage.wifi_ap_channel); 
-
-  //------------------------------------------------------------------
-    // [data upload]
-      // upload_freq=180   ; seconds
-      // upload_timeout=20 ; seconds
-      // device_id=TSH06   ; ThermoSensor Home 06
-      // location=usBedR   ; upstairs Bed Room
-      // data_measurement_org=mine
-      // data_measurement_bucket=ts_bucket
-      // data_measurement_name=devThermoSensor
-    SERIAL_PF("[%s]\n", INI_DATA_SECTION);
-    res += !parseIniNumber(ini, INI_DATA_SECTION, INI_DATA_FREQ,               iniBuffer, INI_BUFFER_LEN, iniFileStorage.upload_freq); 
-    res += !parseIniNumber(ini, INI_DATA_SECTION, INI_DATA_UPLOAD_TIMEOUT,     iniBuffer, INI_BUFFER_LEN, iniFileStorage.upload_timeout ); 
-    res += !parseIniString(ini, INI_DATA_SECTION, INI_DATA_DEVICE_ID,          iniBuffer, INI_BUFFER_LEN, iniFileStorage.device_id, MAX_LEN_DEVICE_ID ); 
-    res += !parseIniString(ini, INI_DATA_SECTION, INI_DATA_LOCATION,           iniBuffer, INI_BUFFER_LEN, iniFileStorage.location, MAX_LEN_LOCATION ); 
-    res += !parseIniString(ini, INI_DATA_SECTION, INI_DATA_MEASUREMENT_ORG,    iniBuffer, INI_BUFFER_LEN, iniFileStorage.data_measurement_org, MAX_LEN_DATA_MEASUREMENT_ORG ); 
-    res += !parseIniString(ini, INI_DATA_SECTION, INI_DATA_MEASUREMENT_BUCKET, iniBuffer, INI_BUFFER_LEN, iniFileStorage.data_measurement_bucket, MAX_LEN_DATA_MEASUREMENT_BUCKET ); 
-    res += !parseIniString(ini, INI_DATA_SECTION, INI_DATA_MEASUREMENT_NAME,   iniBuffer, INI_BUFFER_LEN, iniFileStorage.data_measurement_name, MAX_LEN_DATA_MEASUREMENT_NAME ); 
-  
-
-  //------------------------------------------------------------------
-    // [server config]
-      // server_address=eu-central-1-1.aws.cloud2.influxdata.com
-      // server_port=443
-      // server_auth_token=**
-    SERIAL_PF("[%s]\n", INI_SERVER_SECTION);
-    res += !parseIniString(ini, INI_SERVER_SECTION, INI_SERVER_ADDRESS,    iniBuffer, INI_BUFFER_LEN, iniFileStorage.server_address, MAX_LEN_SERVER_ADDRESS ); 
-    res += !parseIniNumber(ini, INI_SERVER_SECTION, INI_SERVER_PORT,       iniBuffer, INI_BUFFER_LEN, iniFileStorage.server_port); 
-    res += !parseIniString(ini, INI_SERVER_SECTION, INI_SERVER_AUTH_TOKEN, iniBuffer, INI_BUFFER_LEN, iniFileStorage.server_auth_token, MAX_LEN_SERVER_AUTH_TOKEN ); 
-
-
-  //------------------------------------------------------------------
-    // [display]
-      // display_contrast=137
-      // display_rotation=false
-    SERIAL_PF("[%s]\n", INI_DISP_SECTION);
-    res += !parseIniNumber(ini, INI_DISP_SECTION, INI_DISP_CONTRAST, iniBuffer, INI_BUFFER_LEN, iniFileStorage.display_contrast); 
-    res += !parseIniBool(ini, INI_DISP_SECTION, INI_DISP_ROTATION, iniBuffer, INI_BUFFER_LEN, value ); 
-      iniFileStorage.display_rotation = value;
-  
-  //------------------------------------------------------------------
-    // [bme sensor]
-      // bme_sensor_temp_correction=0.0
-    SERIAL_PF("[%s]\n", INI_SENSOR_SECTION);
-    res += !parseIniNumber(ini, INI_SENSOR_SECTION, INI_SENSOR_TEMP_CORRECTION,  iniBuffer, INI_BUFFER_LEN, iniFileStorage.sensor_temp_correction ); 
-
-  //------------------------------------------------------------------
-    // [battery]
-    SERIAL_PF("[%s]\n", INI_BATTERY_SECTION);
-    res += !parseIniNumber(ini, INI_BATTERY_SECTION, INI_BATTERY_MIN_LEVEL, iniBuffer, INI_BUFFER_LEN, iniFileStorage.batteryMinLevel ); 
-    res += !parseIniNumber(ini, INI_BATTERY_SECTION, INI_BATTERY_MAX_LEVEL, iniBuffer, INI_BUFFER_LEN, iniFileStorage.batteryMaxLevel ); 
-
-  ini.close();
-  return !res;
+  }
+  journalFile.close();
+
+  SERIAL_PF("Config journal: %d records replayed\n", recordCount );
+  return true;
 }
-  
-//--------------------------------------------------------------------------------------------------
-bool SensorConfigFile::writeIniFile(const SensorIniFileStorage &iniFileStorage)
+
+//-- readSnapshot ----------------------------------------------------------------------------------
+bool SensorConfigFile::readSnapshot(SensorIniFileStorage &iniFileStorage)
 {
-  SERIAL_PLN("Writing the new Ini file.");
+  File snapshotFile = LittleFS.open( INI_SNAPSHOT_FILENAME, "r" );
+  if ( false == snapshotFile ) { return false; }
 
-  // Create a back-up file from the original
-  if (false == LittleFS.rename(INI_FILENAME, INI_FILENAME_BACKUP) )
+  IniSnapshot snapshot;
+  size_t length = snapshotFile.read( reinterpret_cast<uint8_t *>( &snapshot ), sizeof( snapshot ) );
+  snapshotFile.close();
+
+  if ( sizeof( snapshot ) != length || 
+       INI_SNAPSHOT_MAGIC != snapshot.header.magic || 
+       INI_SNAPSHOT_VERSION != snapshot.header.version || 
+       sizeof( SensorIniFileStorage ) != snapshot.header.storageSize )
   {
-    SERIAL_PLN("Error creating ini file back-up.");
+    SERIAL_PLN("Config snapshot: unknown format.");
     return false;
   }
-
-  // Create a new ini file
-  File iniFile = LittleFS.open(INI_FILENAME, "w");
-  if ( false == iniFile )
+  if ( snapshot.header.crc != calculateCrc32( &snapshot.storage, sizeof( snapshot.storage ) ) )
   {
-    SERIAL_PLN("Error creating ini file.");
+    SERIAL_PLN("Config snapshot: CRC mismatch.");
     return false;
   }
-
-  // [network]
-  iniFile.printf("[%s]\n", INI_NET_SECTION);
-  iniFile.printf("%s=%s\n", INI_NET_WIFI_ENABLED, (true == iniFileStorage.wifi_enabled ? "true" : "false" ) );
-  iniFile.printf("%s=%s\n", INI_NET_WIFI_AP_SSID, iniFileStorage.wifi_ap_ssid );
-  iniFile.printf("%s=%s\n", INI_NET_WIFI_AP_PWD, iniFileStorage.wifi_ap_pwd );
-  const uint8_t *mac = iniFileStorage.wifi_ap_bssid; 
-  iniFile.printf("%s=%x-%x-%x-%x-%x-%x\n", INI_NET_WIFI_AP_BSSID, mac[0], mac[1], mac[2], mac[3], mac[4], mac[5] );
-  iniFile.printf("%s=%d\n", INI_NET_WIFI_AP_CHANNEL, iniFileStorage.wifi_ap_channel );
-  iniFile.printf("%s=%d\n", INI_NET_WIFI_CON_DELAY, iniFileStorage.wifi_con_delay );
-  iniFile.printf("%s=%d\n", INI_NET_WIFI_MAX_CON_ATTEMPTS, iniFileStorage.wifi_max_con_attempts );
-
-  // [data upload]
-  iniFile.printf("[%s]\n", INI_DATA_SECTION);
-  iniFile.printf("%s=%d\n", INI_DATA_FREQ, iniFileStorage.upload_freq );
-  iniFile.printf("%s=%d\n", INI_DATA_UPLOAD_TIMEOUT, iniFileStorage.upload_timeout );
-  iniFile.printf("%s=%s\n", INI_DATA_DEVICE_ID, iniFileStorage.device_id );
-  iniFile.printf("%s=%s\n", INI_DATA_LOCATION, iniFileStorage.location );
-  iniFile.printf("%s=%s\n", INI_DATA_MEASUREMENT_ORG, iniFileStorage.data_measurement_org);
-  iniFile.printf("%s=%s\n", INI_DATA_MEASUREMENT_BUCKET, iniFileStorage.data_measurement_bucket);
-  iniFile.printf("%s=%s\n", INI_DATA_MEASUREMENT_NAME, iniFileStorage.data_measurement_name);
-
-
-  // [server config]
-  iniFile.printf("[%s]\n", INI_SERVER_SECTION);
-  iniFile.printf("%s=%s\n", INI_SERVER_ADDRESS, iniFileStorage.server_address);
-  iniFile.printf("%s=%d\n", INI_SERVER_PORT, iniFileStorage.server_port );
-  iniFile.printf("%s=%s\n", INI_SERVER_AUTH_TOKEN, iniFileStorage.server_auth_token);
-
-
-  // [display]
-  iniFile.printf("[%s]\n", INI_DISP_SECTION);
-  iniFile.printf("%s=%d\n", INI_DISP_CONTRAST, iniFileStorage.display_contrast );
-  iniFile.printf("%s=%s\n", INI_DISP_ROTATION, (true == iniFileStorage.display_rotation ? "true" : "false" ) );
-
-  // [bme sensor]
-  iniFile.printf("[%s]\n", INI_SENSOR_SECTION);
-  iniFile.printf("%s=%1.1f\n", INI_SENSOR_TEMP_CORRECTION, iniFileStorage.sensor_temp_correction );
-
-  // [battery]
-  iniFile.printf("[%s]\n", INI_BATTERY_SECTION);
-  iniFile.printf("%s=%d\n", INI_BATTERY_MIN_LEVEL, iniFileStorage.batteryMinLevel );
-  iniFile.printf("%s=%d\n", INI_BATTERY_MAX_LEVEL, iniFileStorage.batteryMaxLevel );
-
-  iniFile.close();
-
-  SERIAL_PLN("Reading back the Ini file.");
-  iniFile = LittleFS.open(INI_FILENAME, "r");
-  if ( false == iniFile )
+  uint32_t iniFileSize = 0;
+  uint32_t iniFileCrc  = 0;
+  getIniFileCrc( iniFileSize, iniFileCrc );
+  if ( snapshot.header.iniFileSize != iniFileSize || snapshot.header.iniFileCrc != iniFileCrc )
   {
-    SERIAL_PLN("Error opening ini file.");
+    SERIAL_PLN("Config snapshot: the ini file has changed.");
     return false;
   }
 
-  String str;
-  do
-  {
-    str = iniFile.readStringUntil('\n');
-    SERIAL_PLN( str.c_str() );
-  } 
-  while ( str.length() != 0 );
+  memcpy( &iniFileStorage, &snapshot.storage, sizeof( iniFileStorage ) );
+  return true;
+}
 
-  iniFile.close();
+//-- writeSnapshot ---------------------------------------------------------------------------------
+// The snapshot is written into a temporary file and renamed, a reset never leaves a partial one.
+bool SensorConfigFile::writeSnapshot(const SensorIniFileStorage &iniFileStorage)
+{
+  IniSnapshotHeader header;
+  getIniFileCrc( header.iniFileSize, header.iniFileCrc );
+  header.crc = calculateCrc32( &iniFileStorage, sizeof( iniFileStorage ) );
 
-  // Remove the back-up file
-  if ( false == LittleFS.remove(INI_FILENAME_BACKUP) )
+  File snapshotFile = LittleFS.open( INI_SNAPSHOT_FILENAME_TMP, "w" );
+  if ( false == snapshotFile )
   {
-    SERIAL_PLN("Error removing back-up file.");
+    SERIAL_PLN("Error creating config snapshot.");
+    return false;
   }
+  size_t length = snapshotFile.write( reinterpret_cast<const uint8_t *>( &header ), sizeof( header ) );
+  length += snapshotFile.write( reinterpret_cast<const uint8_t *>( &iniFileStorage ), sizeof( iniFileStorage ) );
+  snapshotFile.close();
 
+  if ( sizeof( header ) + sizeof( iniFileStorage ) != length ||
+       false == LittleFS.rename( INI_SNAPSHOT_FILENAME_TMP, INI_SNAPSHOT_FILENAME ) )
+  {
+    SERIAL_PLN("Error writing config snapshot.");
+    LittleFS.remove( INI_SNAPSHOT_FILENAME_TMP );
+    return false;
+  }
+  SERIAL_PLN("Config snapshot written.");
   return true;
 }
 
+//-- INI FILE PARSER -------------------------------------------------------------------------------
+const size_t INI_LINE_MAX_LENGTH = 320;  // the longest values are 255 characters
+const size_t INI_READ_CHUNK_SIZE = 128;
 
-//== FILE MANAGEMENT ===============================================================================
-//-- printErrorMessage -----------------------------------------------------------------------------
-void SensorConfigFile::printErrorMessage(uint8_t errorCode, bool eol /*true */ )
+struct IniParseState
 {
-  switch ( errorCode ) {
-  case SPIFFSIniFile::errorNoError:
-    Serial.print("no error");
-    break;
-  case SPIFFSIniFile::errorFileNotFound:
-    Serial.print("file not found");
-    break;
-  case SPIFFSIniFile::errorFileNotOpen:
-    Serial.print("file not open");
-    break;
-  case SPIFFSIniFile::errorBufferTooSmall:
-    Serial.print("buffer too small");
-    break;
-  case SPIFFSIniFile::errorSeekError:
-    Serial.print("seek error");
-    break;
-  case SPIFFSIniFile::errorSectionNotFound:
-    Serial.print("section not found");
-    break;
-  case SPIFFSIniFile::errorKeyNotFound:
-    Serial.print("key not found");
-    break;
-  case SPIFFSIniFile::errorEndOfFile:
-    Serial.print("end of file");
-    break;
-  case SPIFFSIniFile::errorUnknownError:
-    Serial.print("unknown error");
-    break;
-  default:
-    Serial.print("unknown error value");
-    break;
-  }
-  if (eol)
-    Serial.println();
+  uint32_t sectionHash = 0;
+  ConfigFieldMask foundFields = 0;     // bit per CONFIG_FIELDS index
+  ConfigFieldMask malformedFields = 0; 
+};
+
+//-- trimIniText -----------------------------------------------------------------------------------
+// removes the white spaces in place at the end, returns the first non-white space character
+static char *trimIniText(char *text)
+{
+  while ( isspace( *text ) ) { ++text; }
+
+  char *end = text + strlen( text );
+  while ( end > text && isspace( *( end - 1 ) ) ) { --end; }
+  *end = 0;
+
+  return text;
 }
 
-//-- parseIniString char* --------------------------------------------------------------------------
-bool SensorConfigFile::parseIniString(const SPIFFSIniFile &ini, const char *INI_SECTION, const char *INI_ITEM, 
-                    char *iniBuffer, const size_t &INI_BUFFER_LEN, char *storage, uint16_t maxLen )
+//-- parseIniLine ----------------------------------------------------------------------------------
+static void parseIniLine(char *line, bool isTruncated, IniParseState &state, SensorIniFileStorage &iniFileStorage)
 {
-  if ( false == ini.getValue(INI_SECTION, INI_ITEM, iniBuffer, INI_BUFFER_LEN, storage, maxLen ) )
+  line = trimIniText( line );
+  if ( 0 == *line || ';' == *line || '#' == *line ) { return; }
+
+  if ( '[' == *line )
   {
-    SERIAL_PF("Error parsing: %s / %s => ", INI_SECTION, INI_ITEM); printErrorMessage(ini.getError());
-    return false;
+    char *end = strchr( line, ']' );
+    if ( NULL != end ) { *end = 0; }
+    state.sectionHash = hashConfigName( trimIniText( line + 1 ) );
+    return;
+  }
+
+  char *separator = strchr( line, '=' );
+  if ( NULL == separator ) { return; }
+  *separator = 0;
+
+  const char *key = trimIniText( line );
+  int8_t index = findConfigField( hashConfigKey( state.sectionHash, key ) );
+  if ( 0 > index ) 
+  { 
+    SERIAL_PF("Unknown ini key: %s\n", key );
+    return;
+  }
+
+  const ConfigField &field = CONFIG_FIELDS[index];
+  state.foundFields |= ( 1ULL << index );
+  if ( true == isTruncated || 
+       false == parseConfigValue( field, trimIniText( separator + 1 ), iniFileStorage ) )
+  {
+    state.malformedFields |= ( 1ULL << index );
   }
-  SERIAL_PF("%s = %s\n", INI_ITEM, storage);
-  return true;
 }
 
-//-- parseIniNumber uint8_t ------------------------------------------------------------------------
-bool SensorConfigFile::parseIniNumber(const SPIFFSIniFile &ini, const char *INI_SECTION, const char *INI_ITEM, 
-                    char *iniBuffer, const size_t &INI_BUFFER_LEN, uint8_t &storage )
+//-- readIniFile -----------------------------------------------------------------------------------
+bool SensorConfigFile::readIniFile(SensorIniFileStorage &iniFileStorage)
 {
-  uint16_t value = 0;
-  if ( false == ini.getValue(INI_SECTION, INI_ITEM, iniBuffer, INI_BUFFER_LEN, value ) )
+  File iniFile = LittleFS.open( INI_FILENAME, "r" );
+  if ( false == iniFile ) 
   {
-    SERIAL_PF("Error parsing: %s / %s => ", INI_SECTION, INI_ITEM); printErrorMessage(ini.getError());
+    SERIAL_PF( "Ini file '%s' does not exisit\n", INI_FILENAME);
     return false;
   }
-  storage = static_cast<uint8_t>( value );
-  SERIAL_PF("%s = %d\n", INI_ITEM, storage);
-  return true;
-}  
+  SERIAL_PLN("Ini file exists");
 
-//-- parseIniNumber int8_t ------------------------------------------------------------------------
-bool SensorConfigFile::parseIniNumber(const SPIFFSIniFile &ini, const char *INI_SECTION, const char *INI_ITEM, 
-                    char *iniBuffer, const size_t &INI_BUFFER_LEN, int8_t &storage )
-{
-  int value = 0; // int comes from the library
-  if ( false == ini.getValue(INI_SECTION, INI_ITEM, iniBuffer, INI_BUFFER_LEN, value ) )
+  IniParseState state;
+  char   line[INI_LINE_MAX_LENGTH];
+  size_t lineLength  = 0;
+  bool   isTruncated = false;
+
+  char   chunk[INI_READ_CHUNK_SIZE];
+  size_t chunkLength = 0;
+  while ( 0 < ( chunkLength = iniFile.read( reinterpret_cast<uint8_t *>( chunk ), sizeof( chunk ) ) ) )
   {
-    SERIAL_PF("Error parsing: %s / %s => ", INI_SECTION, INI_ITEM); printErrorMessage(ini.getError());
-    return false;
+    for ( size_t i = 0; i < chunkLength; ++i )
+    {
+      if ( '\n' == chunk[i] )
+      {
+        line[lineLength] = 0;
+        parseIniLine( line, isTruncated, state, iniFileStorage );
+        lineLength  = 0;
+        isTruncated = false;
+      }
+      else if ( sizeof( line ) - 1 > lineLength ) { line[lineLength++] = chunk[i]; }
+      else                                        { isTruncated = true; }
+    }
   }
-  storage = static_cast<int8_t>( value );
-  SERIAL_PF("%s = %d\n", INI_ITEM, storage);
-  return true;
-}  
+  line[lineLength] = 0;
+  parseIniLine( line, isTruncated, state, iniFileStorage ); // no new line at the end of the file
+  iniFile.close();
 
-//-- parseIniNumber uint16_t -----------------------------------------------------------------------
-bool SensorConfigFile::parseIniNumber(const SPIFFSIniFile &ini, const char *INI_SECTION, const char *INI_ITEM, 
-                    char *iniBuffer, const size_t &INI_BUFFER_LEN, uint16_t &storage )
-{
-  if ( false == ini.getValue(INI_SECTION, INI_ITEM, iniBuffer, INI_BUFFER_LEN, storage ) )
+  // Every problem is reported at once, the optional keys may be missing from the older ini files
+  bool result = true;
+  for ( uint8_t i = 0; i < CONFIG_FIELD_COUNT; ++i )
   {
-    SERIAL_PF("Error parsing: %s / %s => ", INI_SECTION, INI_ITEM); printErrorMessage(ini.getError());
-    return false;
+    const ConfigField &field = CONFIG_FIELDS[i];
+    if ( 0 == ( state.foundFields & ( 1ULL << i ) ) )
+    {
+      if ( 0 == ( field.flags & CONFIG_FLAG_REQUIRED ) ) { continue; }
+      SERIAL_PF("Missing ini key: %s / %s\n", field.section, field.key );
+      result = false;
+    }
+    else if ( 0 != ( state.malformedFields & ( 1ULL << i ) ) )
+    {
+      SERIAL_PF("Malformed ini value: %s / %s\n", field.section, field.key );
+      result = false;
+    }
   }
-  SERIAL_PF("%s = %d\n", INI_ITEM, storage);
-  return true;
-}  
+  return result;
+}
 
-//-- parseIniNumber int32_t -----------------------------------------------------------------------
-bool SensorConfigFile::parseIniNumber(const SPIFFSIniFile &ini, const char *INI_SECTION, const char *INI_ITEM, 
-                    char *iniBuffer, const size_t &INI_BUFFER_LEN, int32_t &storage )
+//--------------------------------------------------------------------------------------------------
+bool SensorConfigFile::writeIniFile(const SensorIniFileStorage &iniFileStorage)
 {
-  if ( false == ini.getValue(INI_SECTION, INI_ITEM, iniBuffer, INI_BUFFER_LEN, storage ) )
+  SERIAL_PLN("Writing the new Ini file.");
+
+  // The old snapshot must not survive a failed write, the next boot falls back to the ini file.
+  // The journal is kept until its changes are in the new ini file.
+  LittleFS.remove( INI_SNAPSHOT_FILENAME );
+
+  // Create a back-up file from the original
+  if (false == LittleFS.rename(INI_FILENAME, INI_FILENAME_BACKUP) )
   {
-    SERIAL_PF("Error parsing: %s / %s => ", INI_SECTION, INI_ITEM); printErrorMessage(ini.getError());
+    SERIAL_PLN("Error creating ini file back-up.");
     return false;
   }
-  SERIAL_PF("%s = %d\n", INI_ITEM, storage);
-  return true;
-}  
 
-//-- parseIniNumber float --------------------------------------------------------------------------
-bool SensorConfigFile::parseIniNumber(const SPIFFSIniFile &ini, const char *INI_SECTION, const char *INI_ITEM, 
-                    char *iniBuffer, const size_t &INI_BUFFER_LEN, float &storage )
-{
-  if ( false == ini.getValue(INI_SECTION, INI_ITEM, iniBuffer, INI_BUFFER_LEN, storage ) )
+  // Create a new ini file
+  File iniFile = LittleFS.open(INI_FILENAME, "w");
+  if ( false == iniFile )
   {
-    SERIAL_PF("Error parsing: %s / %s => ", INI_SECTION, INI_ITEM); printErrorMessage(ini.getError());
+    SERIAL_PLN("Error creating ini file.");
     return false;
   }
-  SERIAL_PF("%s = %f\n", INI_ITEM, storage);
-  return true;
-}  
 
-//-- parseIniNumber bool --------------------------------------------------------------------------
-bool SensorConfigFile::parseIniBool(const SPIFFSIniFile &ini, const char *INI_SECTION, const char *INI_ITEM, 
-                  char *iniBuffer, const size_t &INI_BUFFER_LEN, bool &storage )
-{
-  if ( false == ini.getValue(INI_SECTION, INI_ITEM, iniBuffer, INI_BUFFER_LEN, storage ) )
+  const char *section = NULL;
+  bool isWritten = true; // a full file system fails every write, the new line of a field too
+  for ( uint8_t i = 0; i < CONFIG_FIELD_COUNT; ++i )
+  {
+    const ConfigField &field = CONFIG_FIELDS[i];
+    if ( NULL == section || 0 != strcmp( section, field.section ) )
+    {
+      section = field.section;
+      iniFile.print('[');  iniFile.print( section );  iniFile.print( "]\n" );
+    }
+    iniFile.print( field.key );  iniFile.print('=');
+    printConfigValue( iniFile, field, iniFileStorage );
+    isWritten = ( 1 == iniFile.print('\n') ) && isWritten;
+  }
+
+  iniFile.close();
+  if ( false == isWritten )
   {
-    SERIAL_PF("Error parsing: %s / %s => ", INI_SECTION, INI_ITEM); printErrorMessage(ini.getError());
+    SERIAL_PLN("Error writing ini file.");
     return false;
   }
-  SERIAL_PF("%s = %s\n", INI_ITEM, ( true == storage ? "true" : "false") );
+
+  // The journaled changes are part of the new ini file now
+  LittleFS.remove( INI_JOURNAL_FILENAME );
+
+  #ifdef GSI_DEBUG
+    SERIAL_PLN("Reading back the Ini file.");
+    iniFile = LittleFS.open(INI_FILENAME, "r");
+    if ( false == iniFile )
+    {
+      SERIAL_PLN("Error opening ini file.");
+      return false;
+    }
+
+    String str;
+    do
+    {
+      str = iniFile.readStringUntil('\n');
+      SERIAL_PLN( str.c_str() );
+    } 
+    while ( str.length() != 0 );
+
+    iniFile.close();
+  #endif
+
+  // Remove the back-up file
+  if ( false == LittleFS.remove(INI_FILENAME_BACKUP) )
+  {
+    SERIAL_PLN("Error removing back-up file.");
+  }
+
+  writeSnapshot( iniFileStorage );
+
   return true;
-}  
+}
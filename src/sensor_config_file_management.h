@@ -3,8 +3,7 @@
 
 #include <Arduino.h>
 
-class SPIFFSIniFile;
-
+#include "config_schema.h"
 
 namespace sensor
 {
@@ -32,18 +31,36 @@ const char INI_DATA_LOCATION[]           = "location";    // max length is 15 ch
 const char INI_DATA_MEASUREMENT_ORG[]    = "data_measurement_org"; // e.g. mine 
 const char INI_DATA_MEASUREMENT_BUCKET[] = "data_measurement_bucket"; // e.g. ts_bucket 
 const char INI_DATA_MEASUREMENT_NAME[]   = "data_measurement_name"; // e.g. homeThermoSensor, devThermoSensor 
+const char INI_DATA_BATCH_SIZE[]         = "batch_size";  // readings per upload, 1 - upload on every wake-up
+const char INI_DATA_TEMP_DEADBAND[]      = "temp_deadband";    // oC, smaller changes are not uploaded, 0 - off
+const char INI_DATA_HUM_DEADBAND[]       = "hum_deadband";     // %, smaller changes are not uploaded, 0 - off
+const char INI_DATA_MAX_SILENT_WAKES[]   = "max_silent_wakes"; // heartbeat: upload at least every N wake-ups
+const char INI_DATA_HISTORY_ENABLED[]    = "history_enabled";  // the uploaded readings are kept in /history/
+const char INI_DATA_BACKLOG_DRAIN_MAX[]  = "backlog_drain_max"; // failed uploads: readings re-sent per wake-up, 0 - off
 
 const uint8_t MAX_LEN_DEVICE_ID               =  15;  
 const uint8_t MAX_LEN_LOCATION                =  15;  
 const uint8_t MAX_LEN_DATA_MEASUREMENT_ORG    =  31;
 const uint8_t MAX_LEN_DATA_MEASUREMENT_BUCKET =  31;
 const uint8_t MAX_LEN_DATA_MEASUREMENT_NAME   =  31;
+const uint8_t MAX_DATA_BATCH_SIZE             =  10;  // limited by the RTC memory
 
 //-----------
 const char INI_SERVER_SECTION[]    = "server config";
 const char INI_SERVER_ADDRESS[]    = "server_address";  // max length is 255 characters, eu-central-1-1.aws.cloud2.influxdata.com
 const char INI_SERVER_PORT[]       = "server_port";  // 4443
 const char INI_SERVER_AUTH_TOKEN[] = "server_auth_token";  // max length is 255 characters, access token
+const char INI_SERVER_TLS_PROFILE[] = "tls_profile";       // 0 - default, 1 - small buffers, 2 - small + ECDSA only
+const char INI_SERVER_GZIP_MIN_SIZE[] = "gzip_min_size";   // bytes, larger multi-point bodies are gzip compressed, 0 - off
+const char INI_SERVER_TRANSPORT[]     = "server_transport"; // 0 - HTTPS, 1 - UDP, 2 - UDP with acknowledgements
+
+const uint8_t TLS_PROFILE_DEFAULT     = 0; // BearSSL defaults: 16 KB receive buffer, all the cipher suites
+const uint8_t TLS_PROFILE_SMALL       = 1; // MFLN probed once, the buffers are sized to it
+const uint8_t TLS_PROFILE_SMALL_ECDSA = 2; // as TLS_PROFILE_SMALL, ECDHE-ECDSA-AES128-GCM-SHA256 only
+
+const uint8_t SERVER_TRANSPORT_HTTPS   = 0; // InfluxDB v2 write API
+const uint8_t SERVER_TRANSPORT_UDP     = 1; // line protocol datagrams to a relay on the LAN, a lost datagram is not noticed
+const uint8_t SERVER_TRANSPORT_UDP_ACK = 2; // as SERVER_TRANSPORT_UDP, with sequences and acknowledgements
 
 const uint8_t MAX_LEN_SERVER_ADDRESS    = 255;
 const uint8_t MAX_LEN_SERVER_AUTH_TOKEN = 255;
@@ -54,58 +71,55 @@ const char INI_DISP_CONTRAST[]  = "display_contrast";
 const char INI_DISP_ROTATION[]  = "display_rotation";
 
 //-----------
-const char INI_SENSOR_SECTION[]         = "sensor";
-const char INI_SENSOR_TEMP_CORRECTION[] = "sensor_temp_correction";
+const char INI_SENSOR_SECTION[]            = "sensor";
+const char INI_SENSOR_TEMP_CORRECTION[]    = "sensor_temp_correction";
+const char INI_SENSOR_TELEMETRY_INTERVAL[] = "sensor_telemetry_interval"; // ms, the live readings of setup mode
 
 
 const char INI_BATTERY_SECTION[]   = "battery";
 const char INI_BATTERY_MIN_LEVEL[] = "battery_min_level";  // The A0 level at 2.75V
 const char INI_BATTERY_MAX_LEVEL[] = "battery_max_level";  // The A0 level at 4.20V
+const char INI_BATTERY_LOW_LEVEL[]      = "battery_low_level";      // %, the sleep interval grows below it, 0 - off
+const char INI_BATTERY_CRITICAL_LEVEL[] = "battery_critical_level"; // %, sensor-only wake-ups below it
 
 // The config file name
 const char INI_FILENAME[]        = "/sensor_config.ini";
 const char INI_FILENAME_BACKUP[] = "/sensor_config.ini.bu";
 
+// Binary snapshot of SensorIniFileStorage, it is rebuilt from the ini file if missing or stale
+const char INI_SNAPSHOT_FILENAME[]     = "/sensor_config.bin";
+const char INI_SNAPSHOT_FILENAME_TMP[] = "/sensor_config.bin.tmp";
+const uint32_t INI_SNAPSHOT_MAGIC   = 0x47534953; // "SISG"
+const uint16_t INI_SNAPSHOT_VERSION = 7; // increase it when SensorIniFileStorage or the header changes
+
+// Journal of the fields changed by the device itself (e.g. BSSID and channel), it is replayed over
+// the snapshot. When it grows over INI_JOURNAL_MAX_SIZE, the ini file is rewritten.
+const char INI_JOURNAL_FILENAME[] = "/sensor_config.jnl";
+const size_t INI_JOURNAL_MAX_SIZE = 1024;
+
 struct SensorIniFileStorage;
 
 //--------------------------------------------------------------------------------------------------
 class SensorConfigFile
 {
 public:
+  //-- loadConfig: from the snapshot if it is up-to-date, otherwise from the ini file (and the
+  //   snapshot is rewritten)
+  bool loadConfig(SensorIniFileStorage &iniFileStorage);
+
+  //-- readIniFile: one pass over the file, every missing and malformed key is reported
   bool readIniFile(SensorIniFileStorage &iniFileStorage);
   static bool writeIniFile(const SensorIniFileStorage &iniFileStorage);
 
-  void printErrorMessage(uint8_t errorCode, bool eol = true);
-
-private:
-  //-- parseIniString char* --------------------------------------------------------------------------
-  bool parseIniString(const SPIFFSIniFile &ini, const char *INI_SECTION, const char *INI_ITEM, 
-                    char *iniBuffer, const size_t &INI_BUFFER_LEN, char *storage, uint16_t maxLen );
-
-  //-- parseIniNumber uint8_t ------------------------------------------------------------------------
-  bool parseIniNumber(const SPIFFSIniFile &ini, const char *INI_SECTION, const char *INI_ITEM, 
-                      char *iniBuffer, const size_t &INI_BUFFER_LEN, uint8_t &storage );
-
-  //-- parseIniNumber int8_t ------------------------------------------------------------------------
-  bool parseIniNumber(const SPIFFSIniFile &ini, const char *INI_SECTION, const char *INI_ITEM, 
-                      char *iniBuffer, const size_t &INI_BUFFER_LEN, int8_t &storage );
-
-
-  //-- parseIniNumber uint16_t -----------------------------------------------------------------------
-  bool parseIniNumber(const SPIFFSIniFile &ini, const char *INI_SECTION, const char *INI_ITEM, 
-                      char *iniBuffer, const size_t &INI_BUFFER_LEN, uint16_t &storage );
-
-  //-- parseIniNumber int32_t -----------------------------------------------------------------------
-  bool parseIniNumber(const SPIFFSIniFile &ini, const char *INI_SECTION, const char *INI_ITEM, 
-                      char *iniBuffer, const size_t &INI_BUFFER_LEN, int32_t &storage );
+  //-- saveChanges: appends the changed fields (CONFIG_FIELD_MASK bits) to the journal in one write
+  static bool saveChanges(const SensorIniFileStorage &iniFileStorage, ConfigFieldMask changedFields);
 
-  //-- parseIniNumber float --------------------------------------------------------------------------
-  bool parseIniNumber(const SPIFFSIniFile &ini, const char *INI_SECTION, const char *INI_ITEM, 
-                      char *iniBuffer, const size_t &INI_BUFFER_LEN, float &storage );
+  //-- replayJournal: applies the journal, a torn record at the end is dropped
+  static bool replayJournal(SensorIniFileStorage &iniFileStorage);
 
-  //-- parseIniNumber bool --------------------------------------------------------------------------
-  bool parseIniBool(const SPIFFSIniFile &ini, const char *INI_SECTION, const char *INI_ITEM, 
-                    char *iniBuffer, const size_t &INI_BUFFER_LEN, bool &storage );
+  //-- readSnapshot: false if the snapshot is missing, corrupted or older than the ini file
+  static bool readSnapshot(SensorIniFileStorage &iniFileStorage);
+  static bool writeSnapshot(const SensorIniFileStorage &iniFileStorage);
 };
 
 }; // sensor
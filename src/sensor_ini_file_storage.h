@@ -25,11 +25,20 @@ struct SensorIniFileStorage
   char data_measurement_org[32]    = { 0 };
   char data_measurement_bucket[32] = { 0 };
   char data_measurement_name[32]   = { 0 };
+  uint8_t batch_size = 1; // 1 - 10, readings collected in the RTC memory before an upload
+  float temp_deadband = 0;  // send-on-delta, 0 - the temperature is not checked
+  float hum_deadband  = 0;  // send-on-delta, 0 - the humidity is not checked
+  uint16_t max_silent_wakes = 10;
+  bool history_enabled = false; // local history of the readings, see HistoryStore
+  uint16_t backlog_drain_max = 60;  // 0 - the readings of the failed uploads are dropped, see getBacklogDrainCount
 
   // server config section
   char server_address[256]    = { 0 }; // 255 + 1 (0)
   uint16_t server_port        = 0;
   char server_auth_token[256] = { 0 }; // 255 + 1 (0)
+  uint8_t tls_profile         = 0; // TLS_PROFILE_DEFAULT
+  uint16_t gzip_min_size      = 512; // 0 - the bodies are sent uncompressed
+  uint8_t server_transport    = 0; // SERVER_TRANSPORT_HTTPS
 
   // display section
   uint8_t display_contrast = 0; // 0 - 255
@@ -37,10 +46,13 @@ struct SensorIniFileStorage
 
   // sensor temp correction
   float sensor_temp_correction = 0;
+  uint16_t sensor_telemetry_interval = 1000; // ms
 
   // battery levels
   uint16_t batteryMinLevel = 0;
   uint16_t batteryMaxLevel = 0;
+  uint8_t  batteryLowLevel      = 30; // %
+  uint8_t  batteryCriticalLevel = 10; // %
 };
 
 }; // namespace 
@@ -0,0 +1,64 @@
+#include "telemetry_stream.h"
+
+#include <GSiDebug.h>
+
+using namespace sensor;
+
+//-- formatJsonNumber ------------------------------------------------------------------------------
+// NAN is not a json number, it is sent as null
+static void formatJsonNumber(char *buffer, size_t size, float value, uint8_t decimals)
+{
+  if ( true == isnan( value ) ) { snprintf( buffer, size, "null" ); }
+  else                          { snprintf( buffer, size, "%.*f", decimals, value ); }
+}
+
+//-- TelemetryStream::begin ------------------------------------------------------------------------
+void TelemetryStream::begin(AsyncWebServer &server, TelemetrySampler sampler, uint16_t interval)
+{
+  m_sampler  = sampler;
+  m_interval = interval;
+
+  m_events.onConnect( [](AsyncEventSourceClient *client) 
+  {
+    SERIAL_PF("Telemetry client connected, last event: %u\n", client->lastId());
+  } );
+  server.addHandler( &m_events );
+}
+
+//-- TelemetryStream::loop -------------------------------------------------------------------------
+void TelemetryStream::loop()
+{
+  if ( nullptr == m_sampler || 0 == m_events.count() )  { return; }
+  if ( m_interval > millis() - m_lastSample )            { return; }
+  m_lastSample = millis();
+
+  TelemetrySample sample;
+  m_sampler( sample );
+
+  char event[TELEMETRY_EVENT_MAX_LENGTH] = { 0 };
+  if ( 0 == formatEvent( sample, event, sizeof( event ) ) )
+  {
+    SERIAL_PLN("Telemetry event too long.");
+    return;
+  }
+  m_events.send( event, TELEMETRY_EVENT_NAME, ++m_eventId );
+}
+
+//-- TelemetryStream::formatEvent ------------------------------------------------------------------
+size_t TelemetryStream::formatEvent(const TelemetrySample &sample, char *buffer, size_t size) const
+{
+  char temperature[12] = { 0 };
+  char humidity[12]    = { 0 };
+  char pressure[12]    = { 0 };
+  formatJsonNumber( temperature, sizeof( temperature ), sample.temperature, 2 );
+  formatJsonNumber( humidity,    sizeof( humidity ),    sample.humidity,    2 );
+  formatJsonNumber( pressure,    sizeof( pressure ),    sample.pressure,    1 );
+
+  int length = snprintf( buffer, size, 
+    "{\"temperature\":%s,\"humidity\":%s,\"pressure\":%s,\"battery_adc\":%d,\"battery\":%u,"
+    "\"free_heap\":%u}",
+    temperature, humidity, pressure, sample.batteryAdc, sample.battery, 
+    static_cast<unsigned>( sample.freeHeap ) );
+
+  return ( 0 > length || size <= static_cast<size_t>( length ) ? 0 : length );
+}
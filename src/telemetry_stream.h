@@ -0,0 +1,55 @@
+#ifndef __TELEMETRY_STREAM_H__
+#define __TELEMETRY_STREAM_H__
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+namespace sensor
+{
+
+//-- TELEMETRY STREAM ------------------------------------------------------------------------------
+// Live readings of setup mode as Server-Sent Events, for the calibration of the temperature
+// correction and the battery levels. The sensors are read once per interval and the same event is
+// sent to every client, nothing is read while there is no client.
+const char   TELEMETRY_STREAM_URI[]      = "/api/events";
+const char   TELEMETRY_EVENT_NAME[]      = "reading";
+const size_t TELEMETRY_EVENT_MAX_LENGTH  = 192;
+
+struct TelemetrySample
+{
+  float    temperature = NAN; // oC, the correction is applied
+  float    humidity    = NAN; // %
+  float    pressure    = NAN; // hPa, NAN without a BME280
+  int16_t  batteryAdc  = 0;   // raw A0, the battery levels are set in these units
+  uint8_t  battery     = 0;   // %
+  uint32_t freeHeap    = 0;   // bytes
+};
+
+//-- TelemetrySampler: reads the sensors into the sample
+typedef void (*TelemetrySampler)(TelemetrySample &sample);
+
+class TelemetryStream
+{
+public:
+  TelemetryStream(): m_events( TELEMETRY_STREAM_URI ) {}
+
+  //-- begin: interval in ms
+  void begin(AsyncWebServer &server, TelemetrySampler sampler, uint16_t interval);
+
+  //-- loop: samples and sends an event if the interval has elapsed
+  void loop();
+
+private:
+  //-- formatEvent: the json data of the event, returns the length (0 if it does not fit)
+  size_t formatEvent(const TelemetrySample &sample, char *buffer, size_t size) const;
+
+  AsyncEventSource  m_events;
+  TelemetrySampler  m_sampler    = nullptr;
+  uint16_t          m_interval   = 0;
+  uint32_t          m_lastSample = 0;
+  uint32_t          m_eventId    = 0;
+};
+
+}; // namespace
+
+#endif // __TELEMETRY_STREAM_H__
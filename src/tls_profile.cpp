@@ -0,0 +1,74 @@
+#include "tls_profile.h"
+#include "tls_session_cache.h"
+#include "rtc_memory_storage.h"
+#include "sensor_config_file_management.h"
+
+#include <GSiDebug.h>
+
+using namespace sensor;
+
+const uint16_t TLS_MFLN_PROBE_LENGTH = 512;   // the responses of the server are a few hundred bytes
+const uint16_t TLS_RECV_BUFFER_FULL  = 16384; // without MFLN the server may send full records
+const uint16_t TLS_XMIT_BUFFER_SMALL = 512;   // longer requests are sent in more records
+
+const uint16_t TLS_FAST_CIPHERS[] = { BR_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256 };
+
+//-- A negative probe of this wake-up, it is cached by confirmTlsProfile()
+static uint32_t s_unconfirmedServerHash = 0;
+
+//-- getMaxFragmentLength --------------------------------------------------------------------------
+// returns 0 if the server does not support MFLN. The probe fails on a network error too, so only a
+// positive answer is cached here.
+static uint16_t getMaxFragmentLength(const char *serverAddress, uint16_t serverPort)
+{
+  RtcTlsMfln cache;
+  uint32_t serverHash = calculateTlsServerHash( serverAddress, serverPort );
+  if ( true == loadRtcRecord( RTC_BLOCK_TLS_MFLN, cache ) && serverHash == cache.serverHash )
+  {
+    return cache.maxFragmentLength;
+  }
+
+  bool isSupported = BearSSL::WiFiClientSecure::probeMaxFragmentLength( serverAddress, serverPort, 
+                                                                         TLS_MFLN_PROBE_LENGTH );
+  SERIAL_PF("MFLN %d probe: %s\n", TLS_MFLN_PROBE_LENGTH, ( true == isSupported ? "supported" : "not supported" ) );
+  if ( false == isSupported )
+  {
+    s_unconfirmedServerHash = serverHash;
+    return 0;
+  }
+
+  cache.serverHash = serverHash;
+  cache.maxFragmentLength = TLS_MFLN_PROBE_LENGTH;
+  saveRtcRecord( RTC_BLOCK_TLS_MFLN, cache );
+  return cache.maxFragmentLength;
+}
+
+//-- confirmTlsProfile -----------------------------------------------------------------------------
+void sensor::confirmTlsProfile(const char *serverAddress, uint16_t serverPort)
+{
+  uint32_t serverHash = calculateTlsServerHash( serverAddress, serverPort );
+  if ( 0 == s_unconfirmedServerHash || serverHash != s_unconfirmedServerHash ) { return; }
+
+  RtcTlsMfln cache;
+  cache.serverHash = serverHash;
+  cache.maxFragmentLength = 0;
+  saveRtcRecord( RTC_BLOCK_TLS_MFLN, cache );
+  s_unconfirmedServerHash = 0;
+}
+
+//-- applyTlsProfile -------------------------------------------------------------------------------
+void sensor::applyTlsProfile(BearSSL::WiFiClientSecure &client, const char *serverAddress, uint16_t serverPort,
+                             uint8_t profile)
+{
+  if ( TLS_PROFILE_DEFAULT == profile ) { return; }
+
+  // BearSSL asks for MFLN in the client hello if the receive buffer is smaller than a full record
+  uint16_t maxFragmentLength = getMaxFragmentLength( serverAddress, serverPort );
+  if ( 0 != maxFragmentLength ) { client.setBufferSizes( maxFragmentLength, maxFragmentLength ); }
+  else                          { client.setBufferSizes( TLS_RECV_BUFFER_FULL, TLS_XMIT_BUFFER_SMALL ); }
+
+  if ( TLS_PROFILE_SMALL_ECDSA == profile )
+  {
+    client.setCiphers( TLS_FAST_CIPHERS, sizeof( TLS_FAST_CIPHERS ) / sizeof( TLS_FAST_CIPHERS[0] ) );
+  }
+}
@@ -0,0 +1,25 @@
+#ifndef __TLS_PROFILE_H__
+#define __TLS_PROFILE_H__
+
+#include <Arduino.h>
+#include <WiFiClientSecureBearSSL.h>
+
+namespace sensor
+{
+
+//-- applyTlsProfile -------------------------------------------------------------------------------
+// Sets the buffer sizes and the cipher list of the client by the profile (TLS_PROFILE_*).
+// Must be called before connect(). The Maximum Fragment Length support of the server is probed
+// until the server answers, the answer is kept in the RTC memory.
+void applyTlsProfile(BearSSL::WiFiClientSecure &client, const char *serverAddress, uint16_t serverPort,
+                     uint8_t profile);
+
+//-- confirmTlsProfile -----------------------------------------------------------------------------
+// Must be called when the connection succeeded. A failed MFLN probe is cached as "not supported"
+// only then: the server was reachable, so it was its answer and not a network error. Otherwise the
+// probe is repeated by the next wake-up.
+void confirmTlsProfile(const char *serverAddress, uint16_t serverPort);
+
+}; // namespace
+
+#endif // __TLS_PROFILE_H__
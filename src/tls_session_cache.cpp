@@ -0,0 +1,65 @@
+#include "tls_session_cache.h"
+#include "rtc_memory_storage.h"
+
+#include <GSiDebug.h>
+
+using namespace sensor;
+
+// The parameters are private in BearSSL::Session, the whole object is copied. It holds the
+// br_ssl_session_parameters only, no pointers.
+static_assert( sizeof( BearSSL::Session ) == sizeof( br_ssl_session_parameters ), 
+               "BearSSL::Session is expected to hold the session parameters only" );
+static_assert( sizeof( BearSSL::Session ) <= RTC_TLS_SESSION_SIZE, 
+               "RTC_TLS_SESSION_SIZE is too small for the BearSSL session" );
+
+//-- hasSessionId ----------------------------------------------------------------------------------
+// A server without session resumption leaves the id empty, the session is not worth keeping
+static bool hasSessionId(const uint8_t *session)
+{
+  br_ssl_session_parameters parameters;
+  memcpy( &parameters, session, sizeof( parameters ) );
+  return 0 != parameters.session_id_len;
+}
+
+//-- calculateTlsServerHash ------------------------------------------------------------------------
+uint32_t sensor::calculateTlsServerHash(const char *serverAddress, uint16_t serverPort)
+{
+  uint32_t hash = calculateCrc32( serverAddress, strlen( serverAddress ) );
+  return calculateCrc32( &serverPort, sizeof( serverPort ), hash );
+}
+
+//-- loadTlsSession --------------------------------------------------------------------------------
+bool sensor::loadTlsSession(const char *serverAddress, uint16_t serverPort, BearSSL::Session &session)
+{
+  RtcTlsSession cache;
+  if ( false == loadRtcRecord( RTC_BLOCK_TLS_SESSION, cache ) ) { return false; }
+
+  if ( cache.serverHash != calculateTlsServerHash( serverAddress, serverPort ) )
+  {
+    SERIAL_PLN("TLS session: belongs to another server.");
+    return false;
+  }
+
+  if ( false == hasSessionId( cache.parameters ) ) { return false; }
+  memcpy( static_cast<void *>( &session ), cache.parameters, sizeof( BearSSL::Session ) );
+
+  SERIAL_PLN("TLS session: offered for resumption.");
+  return true;
+}
+
+//-- saveTlsSession --------------------------------------------------------------------------------
+bool sensor::saveTlsSession(const char *serverAddress, uint16_t serverPort, BearSSL::Session &session)
+{
+  RtcTlsSession cache;
+  cache.serverHash = calculateTlsServerHash( serverAddress, serverPort );
+  memcpy( cache.parameters, static_cast<const void *>( &session ), sizeof( BearSSL::Session ) );
+  if ( false == hasSessionId( cache.parameters ) ) { return false; } // the server does not support it
+
+  return saveRtcRecord( RTC_BLOCK_TLS_SESSION, cache );
+}
+
+//-- clearTlsSession -------------------------------------------------------------------------------
+void sensor::clearTlsSession()
+{
+  clearRtcRecord<RtcTlsSession>( RTC_BLOCK_TLS_SESSION );
+}
@@ -0,0 +1,31 @@
+#ifndef __TLS_SESSION_CACHE_H__
+#define __TLS_SESSION_CACHE_H__
+
+#include <Arduino.h>
+#include <WiFiClientSecureBearSSL.h>
+
+namespace sensor
+{
+
+//-- TLS SESSION CACHE -----------------------------------------------------------------------------
+// The parameters of the last TLS session are kept in the RTC memory, so the next wake-up can offer
+// them to the server for an abbreviated handshake instead of a full ECDHE one.
+
+//-- loadTlsSession --------------------------------------------------------------------------------
+// returns false if there is no valid session for the server, the session is left empty
+bool loadTlsSession(const char *serverAddress, uint16_t serverPort, BearSSL::Session &session);
+
+//-- saveTlsSession --------------------------------------------------------------------------------
+// after a successful handshake, the client has updated the session parameters
+bool saveTlsSession(const char *serverAddress, uint16_t serverPort, BearSSL::Session &session);
+
+//-- clearTlsSession -------------------------------------------------------------------------------
+void clearTlsSession();
+
+//-- calculateTlsServerHash ------------------------------------------------------------------------
+// Identifies the server of the cached TLS data
+uint32_t calculateTlsServerHash(const char *serverAddress, uint16_t serverPort);
+
+}; // namespace
+
+#endif // __TLS_SESSION_CACHE_H__
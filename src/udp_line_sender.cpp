@@ -0,0 +1,97 @@
+#include "udp_line_sender.h"
+
+#include <GSiDebug.h>
+
+using namespace sensor;
+
+//-- UdpLineSender::UdpLineSender ------------------------------------------------------------------
+UdpLineSender::UdpLineSender(UDP &udp, const IPAddress &serverIp, uint16_t serverPort, bool isAcknowledged,
+                             uint32_t firstSequence):
+  m_udp(udp), m_serverIp(serverIp), m_serverPort(serverPort), m_isAcknowledged(isAcknowledged),
+  m_sequence(firstSequence)
+{}
+
+//-- UdpLineSender::write --------------------------------------------------------------------------
+// A full buffer sends the complete lines, the line being printed is moved to the start
+size_t UdpLineSender::write(uint8_t c)
+{
+  if ( true == m_hasFailed ) { return 0; }
+
+  if ( sizeof( m_buffer ) == m_used )
+  {
+    if ( 0 == m_lineStart )
+    {
+      SERIAL_PLN("UDP: the line does not fit into a datagram.");
+      m_hasFailed = true;
+      return 0;
+    }
+    m_hasFailed = ( false == sendDatagram( m_lineStart ) );
+    memmove( m_buffer, m_buffer + m_lineStart, m_used - m_lineStart );
+    m_used     -= m_lineStart;
+    m_lineStart = 0;
+    if ( true == m_hasFailed ) { return 0; }
+  }
+
+  m_buffer[m_used++] = c;
+  if ( '\n' == c ) { m_lineStart = m_used; }
+  return 1;
+}
+
+//-- UdpLineSender::end ----------------------------------------------------------------------------
+bool UdpLineSender::end()
+{
+  if ( false == m_hasFailed && 0 < m_used ) { m_hasFailed = ( false == sendDatagram( m_used ) ); }
+  m_used      = 0;
+  m_lineStart = 0;
+  return ( false == m_hasFailed );
+}
+
+//-- UdpLineSender::sendDatagram -------------------------------------------------------------------
+// The first length bytes of the buffer, until the relay acknowledges them
+bool UdpLineSender::sendDatagram(size_t length)
+{
+  char sequence[UDP_SEQUENCE_MAX_SIZE + 1] = { 0 };
+  int  sequenceLength = ( true == m_isAcknowledged ?
+                          snprintf( sequence, sizeof( sequence ), "#seq %u\n", static_cast<unsigned>( m_sequence ) ) : 0 );
+
+  for ( uint8_t attempt = 0; attempt < UDP_MAX_ATTEMPTS; ++attempt )
+  {
+    bool isSent = ( 1 == m_udp.beginPacket( m_serverIp, m_serverPort ) );
+    isSent = isSent && sequenceLength == static_cast<int>( m_udp.write( reinterpret_cast<const uint8_t *>( sequence ), sequenceLength ) );
+    isSent = isSent && length == m_udp.write( m_buffer, length );
+    isSent = ( 1 == m_udp.endPacket() ) && isSent;
+
+    if ( true == isSent && ( false == m_isAcknowledged || true == waitForAck() ) )
+    {
+      ++m_sequence;
+      return true;
+    }
+    SERIAL_PF("UDP: datagram %u is not %s.\n", static_cast<unsigned>( m_sequence ), ( isSent ? "acknowledged" : "sent" ) );
+  }
+  return false;
+}
+
+//-- UdpLineSender::waitForAck ---------------------------------------------------------------------
+// The answers of the earlier attempts (the ack of a retransmitted datagram) are skipped
+bool UdpLineSender::waitForAck()
+{
+  uint32_t start = millis();
+  while ( millis() - start < UDP_ACK_TIMEOUT )
+  {
+    if ( 0 == m_udp.parsePacket() )
+    {
+      delay( 1 );
+      continue;
+    }
+
+    char ack[24] = { 0 };
+    int  length  = m_udp.read( ack, sizeof( ack ) - 1 );
+    unsigned sequence = 0;
+    if ( 0 < length && m_serverIp == m_udp.remoteIP() &&
+         1 == sscanf( ack, "ack %u", &sequence ) && m_sequence == sequence )
+    {
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,58 @@
+#ifndef __UDP_LINE_SENDER_H__
+#define __UDP_LINE_SENDER_H__
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#include <Udp.h>
+
+namespace sensor
+{
+
+//-- UDP LINE PROTOCOL RELAY -----------------------------------------------------------------------
+// The line protocol is sent in UDP datagrams to a listener on the LAN (e.g. the socket_listener of
+// Telegraf), no TCP connection and no TLS handshake. A line is never split between two datagrams.
+// With acknowledgements every datagram starts with a comment line, which the line protocol parsers
+// skip:
+//   #seq <sequence>\n
+// and the relay answers with the datagram "ack <sequence>" to the source port. A datagram without
+// an answer is sent again, the relay drops the duplicates by the sequence.
+const size_t   UDP_DATAGRAM_MAX_SIZE = 1024; // below the Ethernet MTU, no IP fragmentation
+const size_t   UDP_SEQUENCE_MAX_SIZE = 16;   // "#seq 4294967295\n"
+const uint16_t UDP_LOCAL_PORT        = 50094;
+const uint16_t UDP_ACK_TIMEOUT       = 50;   // ms, round trip on the LAN is a few ms
+const uint8_t  UDP_MAX_ATTEMPTS      = 5;    // sending the same datagram
+
+//-- UdpLineSender ---------------------------------------------------------------------------------
+// The printed lines are collected in a datagram, it is sent when the next line does not fit into it
+// or by end(). The UDP socket must be open (begin() of WiFiUDP with UDP_LOCAL_PORT).
+class UdpLineSender : public Print
+{
+public:
+  //-- firstSequence: e.g. random, so the sequences of two wake-ups do not collide at the relay
+  UdpLineSender(UDP &udp, const IPAddress &serverIp, uint16_t serverPort, bool isAcknowledged,
+                uint32_t firstSequence);
+
+  //-- end: sends the rest of the lines, returns false if any of the datagrams failed
+  bool end();
+
+  using Print::write;
+  size_t write(uint8_t c) override;
+
+private:
+  bool sendDatagram(size_t length);
+  bool waitForAck();
+
+  UDP       &m_udp;
+  IPAddress  m_serverIp;
+  uint16_t   m_serverPort;
+  bool       m_isAcknowledged;
+  uint32_t   m_sequence;
+  uint8_t    m_buffer[UDP_DATAGRAM_MAX_SIZE - UDP_SEQUENCE_MAX_SIZE];
+  size_t     m_used      = 0;
+  size_t     m_lineStart = 0; // the line being printed, the lines before it are complete
+  bool       m_hasFailed = false;
+};
+
+}; // namespace
+
+#endif // __UDP_LINE_SENDER_H__
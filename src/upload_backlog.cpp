@@ -0,0 +1,166 @@
+#include "upload_backlog.h"
+#include "segment_file.h"
+
+#include <LittleFS.h>
+
+#include <GSiDebug.h>
+
+using namespace sensor;
+
+static_assert( 16 == sizeof( BacklogRecord ), "a record must be 16 bytes" );
+
+//-- UploadBacklog::open ---------------------------------------------------------------------------
+// Without segments the counters continue from the head, the segment numbers are not reused. The
+// head file may be missing (nothing uploaded yet) or behind the oldest segment (a reset before it
+// was written), the head is moved to the oldest reading on the file system then.
+bool UploadBacklog::open()
+{
+  if ( true == m_isOpen ) { return true; }
+
+  m_head = 0;
+  File headFile = LittleFS.open( BACKLOG_HEAD_FILENAME, "r" );
+  if ( true == headFile )
+  {
+    if ( sizeof( m_head ) != headFile.read( reinterpret_cast<uint8_t *>( &m_head ), sizeof( m_head ) ) ) { m_head = 0; }
+    headFile.close();
+  }
+  m_tail = m_head;
+
+  uint32_t first = 0;
+  uint32_t last  = 0;
+  if ( true == findSegments( BACKLOG_DIRECTORY, first, last ) )
+  {
+    char path[SEGMENT_PATH_MAX_LENGTH];
+    getSegmentPath( BACKLOG_DIRECTORY, last, path );
+    File file = LittleFS.open( path, "r" );
+    m_tail = last * BACKLOG_SEGMENT_RECORDS + ( true == file ? file.size() / sizeof( BacklogRecord ) : 0 );
+    if ( true == file ) { file.close(); }
+
+    m_head = std::max( m_head, first * BACKLOG_SEGMENT_RECORDS );
+    m_head = std::max( m_head, m_tail - std::min( m_tail, BACKLOG_CAPACITY ) );
+    m_head = std::min( m_head, m_tail );
+  }
+
+  m_isOpen = true;
+  return true;
+}
+
+//-- UploadBacklog::close --------------------------------------------------------------------------
+void UploadBacklog::close()
+{
+  if ( true == m_file ) { m_file.close(); }
+  m_isOpen = false;
+}
+
+//-- UploadBacklog::writeHead ----------------------------------------------------------------------
+// The segments behind the head are removed after the head has been written
+bool UploadBacklog::writeHead()
+{
+  File headFile = LittleFS.open( BACKLOG_HEAD_FILENAME, "w" );
+  bool isWritten = ( true == headFile && 
+                     sizeof( m_head ) == headFile.write( reinterpret_cast<const uint8_t *>( &m_head ), sizeof( m_head ) ) );
+  if ( true == headFile ) { headFile.close(); }
+  if ( false == isWritten )
+  {
+    SERIAL_PLN("Backlog: head write failed.");
+    return false;
+  }
+
+  if ( true == m_file && m_fileSegment < m_head / BACKLOG_SEGMENT_RECORDS ) { m_file.close(); }
+  removeSegments( BACKLOG_DIRECTORY, m_head / BACKLOG_SEGMENT_RECORDS );
+  return true;
+}
+
+//-- UploadBacklog::append -------------------------------------------------------------------------
+bool UploadBacklog::append(const RtcReading *readings, uint8_t readingCount)
+{
+  if ( false == m_isOpen ) { return false; }
+  if ( true == m_file ) { m_file.close(); } // it may be the segment written now
+
+  uint8_t written = 0;
+  while ( written < readingCount )
+  {
+    char path[SEGMENT_PATH_MAX_LENGTH];
+    getSegmentPath( BACKLOG_DIRECTORY, m_tail / BACKLOG_SEGMENT_RECORDS, path );
+    File file = LittleFS.open( path, "a" );
+    if ( false == file )
+    {
+      SERIAL_PLN("Backlog: record write failed.");
+      break;
+    }
+
+    // Up to the end of the segment
+    uint8_t part = std::min<uint32_t>( readingCount - written, BACKLOG_SEGMENT_RECORDS - m_tail % BACKLOG_SEGMENT_RECORDS );
+    bool isWritten = true;
+    for ( uint8_t i = 0; i < part && true == isWritten; ++i )
+    {
+      BacklogRecord record;
+      record.reading = readings[written + i];
+      record.crc = calculateCrc32( &record.reading, sizeof( record.reading ) );
+      isWritten = ( sizeof( record ) == file.write( reinterpret_cast<const uint8_t *>( &record ), sizeof( record ) ) );
+    }
+    file.close();
+    if ( false == isWritten )
+    {
+      SERIAL_PLN("Backlog: record write failed.");
+      break;
+    }
+    written += part;
+    m_tail  += part;
+  }
+
+  if ( BACKLOG_CAPACITY < count() )
+  {
+    SERIAL_PF("Backlog full, %u readings dropped.\n", count() - BACKLOG_CAPACITY);
+    m_head = m_tail - BACKLOG_CAPACITY;
+    writeHead();
+  }
+  return written == readingCount;
+}
+
+//-- UploadBacklog::read ---------------------------------------------------------------------------
+// The readings are read in order, the segment stays open for the next one
+bool UploadBacklog::read(uint32_t index, RtcReading &reading)
+{
+  if ( false == m_isOpen || count() <= index ) { return false; }
+
+  uint32_t position = m_head + index;
+  uint32_t segment  = position / BACKLOG_SEGMENT_RECORDS;
+  if ( false == m_file || m_fileSegment != segment )
+  {
+    if ( true == m_file ) { m_file.close(); }
+    char path[SEGMENT_PATH_MAX_LENGTH];
+    getSegmentPath( BACKLOG_DIRECTORY, segment, path );
+    m_file = LittleFS.open( path, "r" );
+    m_fileSegment = segment;
+  }
+
+  BacklogRecord record;
+  if ( false == m_file || 
+       false == m_file.seek( ( position % BACKLOG_SEGMENT_RECORDS ) * sizeof( record ) ) ||
+       sizeof( record ) != m_file.read( reinterpret_cast<uint8_t *>( &record ), sizeof( record ) ) ||
+       record.crc != calculateCrc32( &record.reading, sizeof( record.reading ) ) )
+  {
+    SERIAL_PF("Backlog: record %u is corrupted.\n", position);
+    return false;
+  }
+  reading = record.reading;
+  return true;
+}
+
+//-- UploadBacklog::remove -------------------------------------------------------------------------
+bool UploadBacklog::remove(uint32_t readingCount)
+{
+  if ( false == m_isOpen ) { return false; }
+  m_head += std::min( readingCount, count() );
+  return writeHead();
+}
+
+//-- UploadBacklog::clear --------------------------------------------------------------------------
+bool UploadBacklog::clear()
+{
+  if ( false == m_isOpen ) { return false; }
+  if ( 0 < count() ) { SERIAL_PF("Backlog: %u readings without time stamp dropped.\n", count()); }
+  m_head = m_tail;
+  return writeHead();
+}
@@ -0,0 +1,71 @@
+#ifndef __UPLOAD_BACKLOG_H__
+#define __UPLOAD_BACKLOG_H__
+
+#include <Arduino.h>
+#include <FS.h>
+
+#include "rtc_memory_storage.h"
+
+namespace sensor
+{
+
+//-- UPLOAD BACKLOG --------------------------------------------------------------------------------
+// Store-and-forward queue of the readings which could not be uploaded (no WiFi, server error).
+// The records are appended to segment files of BACKLOG_SEGMENT_RECORDS (see segment_file.h). The
+// uploaded readings are dropped by moving the head, which is kept in a small file of its own:
+// LittleFS replaces it as a whole when it is closed. A segment is removed when the head has passed
+// it. When the backlog is full, the oldest readings are dropped.
+const char     BACKLOG_DIRECTORY[]     = "/backlog/";
+const char     BACKLOG_HEAD_FILENAME[] = "/backlog/head.bin";
+const uint32_t BACKLOG_CAPACITY        = 1024; // readings, 2 days of 3-minute readings
+const uint16_t BACKLOG_SEGMENT_RECORDS = 64;   // 1 KB segment files
+
+// RtcReadingBuffer::backlogCount before the file has been opened after a power-on
+const uint16_t BACKLOG_COUNT_UNKNOWN = 0xFFFF;
+
+//-- A record of a reading, the CRC detects a corrupted one (LittleFS checks its metadata only)
+struct BacklogRecord
+{
+  RtcReading reading;
+  uint32_t   crc = 0;
+};
+
+//-- UploadBacklog ---------------------------------------------------------------------------------
+// LittleFS must be mounted. The time stamps are calculated from RtcReading::clock like for the
+// reading buffer, so the readings are only valid while the device clock runs (see clear()).
+// Head and tail are running counters, the record of a reading is in the segment index /
+// BACKLOG_SEGMENT_RECORDS.
+class UploadBacklog
+{
+public:
+  //-- open: the tail is found from the segments, an open backlog is kept
+  bool open();
+  void close();
+
+  //-- append: the records of a segment are written at once
+  bool append(const RtcReading *readings, uint8_t readingCount);
+
+  uint32_t count() const { return m_tail - m_head; }
+
+  //-- read: 0 is the oldest reading. Returns false if the record is corrupted.
+  bool read(uint32_t index, RtcReading &reading);
+
+  //-- remove: the oldest readings, after the server has accepted them
+  bool remove(uint32_t readingCount);
+
+  //-- clear: after a power loss the device clock restarts, the readings cannot be time stamped
+  bool clear();
+
+private:
+  bool writeHead();
+
+  File     m_file;            // the segment being read
+  uint32_t m_fileSegment = 0;
+  uint32_t m_head   = 0;      // the oldest reading
+  uint32_t m_tail   = 0;      // the next reading
+  bool     m_isOpen = false;
+};
+
+}; // namespace
+
+#endif // __UPLOAD_BACKLOG_H__
@@ -0,0 +1,66 @@
+#include "wake_timing.h"
+
+#include <GSiDebug.h>
+
+using namespace sensor;
+
+//-- Health measurement, the fields are in the order of WakePhase
+const size_t HEALTH_FIELD_COUNT = WAKE_PHASE_COUNT + 1;
+
+const LineSchema<2, HEALTH_FIELD_COUNT> HEALTH_LINE_SCHEMA =
+{
+  { "deviceId", "location" },
+  {
+    { "t_boot",    LINE_FIELD_INTEGER, 0 },
+    { "t_fs",      LINE_FIELD_INTEGER, 0 },
+    { "t_ini",     LINE_FIELD_INTEGER, 0 },
+    { "t_sensor",  LINE_FIELD_INTEGER, 0 },
+    { "t_wifi",    LINE_FIELD_INTEGER, 0 },
+    { "t_dns",     LINE_FIELD_INTEGER, 0 },
+    { "t_tls",     LINE_FIELD_INTEGER, 0 },
+    { "t_request", LINE_FIELD_INTEGER, 0 },
+    { "t_status",  LINE_FIELD_INTEGER, 0 },
+    { "t_total",   LINE_FIELD_INTEGER, 0 },
+  }
+};
+
+//-- WakeTimer::end --------------------------------------------------------------------------------
+void WakeTimer::end(WakePhase phase)
+{
+  m_timing.durations[phase] = micros() - m_phaseStart;
+  SERIAL_PF("Phase %s: %lu us\n", HEALTH_LINE_SCHEMA.fields[phase].key, static_cast<unsigned long>( m_timing.durations[phase] ) );
+}
+
+//-- WakeTimer::add --------------------------------------------------------------------------------
+void WakeTimer::add(WakePhase phase)
+{
+  m_timing.durations[phase] += micros() - m_phaseStart;
+  SERIAL_PF("Phase %s: %lu us\n", HEALTH_LINE_SCHEMA.fields[phase].key, static_cast<unsigned long>( m_timing.durations[phase] ) );
+}
+
+//-- WakeTimer::finish -----------------------------------------------------------------------------
+void WakeTimer::finish()
+{
+  m_timing.total = micros();
+  SERIAL_PF("Wake-up total: %lu us\n", static_cast<unsigned long>( m_timing.total ) );
+  saveRtcRecord( RTC_BLOCK_WAKE_TIMING, m_timing );
+}
+
+//-- WakeTimer::loadPrevious -----------------------------------------------------------------------
+bool WakeTimer::loadPrevious(RtcWakeTiming &timing) const
+{
+  return loadRtcRecord( RTC_BLOCK_WAKE_TIMING, timing );
+}
+
+//-- WakeTimer::printLine --------------------------------------------------------------------------
+size_t WakeTimer::printLine(Print &out, const RtcWakeTiming &timing, const char *measurement, 
+                            const char *deviceId, const char *location)
+{
+  LinePoint<2, HEALTH_FIELD_COUNT> point;
+  point.tagValues[0] = deviceId;
+  point.tagValues[1] = location;
+  for ( uint8_t i = 0; i < WAKE_PHASE_COUNT; ++i ) { point.fieldValues[i] = timing.durations[i]; }
+  point.fieldValues[WAKE_PHASE_COUNT] = timing.total;
+
+  return encodeLine( out, measurement, "Health", HEALTH_LINE_SCHEMA, point );
+}
@@ -0,0 +1,46 @@
+#ifndef __WAKE_TIMING_H__
+#define __WAKE_TIMING_H__
+
+#include <Arduino.h>
+
+#include "rtc_memory_storage.h"
+#include "line_protocol.h"
+
+namespace sensor
+{
+
+//-- WakeTimer -------------------------------------------------------------------------------------
+// Measures the phases of a wake-up in microseconds. The record of a wake-up is kept in the RTC
+// memory and it is uploaded as a health measurement by the next successful POST.
+class WakeTimer
+{
+public:
+  //-- begin: start of a phase
+  void begin() { m_phaseStart = micros(); }
+
+  //-- end: the time since begin() is stored for the phase
+  //   The boot phase needs no begin(), it is measured from the start of the core.
+  void end(WakePhase phase);
+
+  //-- add: as end(), for the further parts of a phase measured in pieces
+  void add(WakePhase phase);
+
+  //-- finish: stores the total awake time and saves the record to the RTC memory
+  void finish();
+
+  //-- loadPrevious: the record of the previous wake-up, false if there is none
+  bool loadPrevious(RtcWakeTiming &timing) const;
+
+  //-- printLine: line protocol of the health measurement ("<measurement>Health,...")
+  //   returns the length of the line
+  static size_t printLine(Print &out, const RtcWakeTiming &timing, const char *measurement, 
+                          const char *deviceId, const char *location);
+
+private:
+  uint32_t m_phaseStart = 0;
+  RtcWakeTiming m_timing;
+};
+
+}; // namespace
+
+#endif // __WAKE_TIMING_H__
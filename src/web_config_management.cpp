@@ -2,12 +2,18 @@
 // #include <config_file_management.h>
 
 
-// #include <ESP8266WebServer.h>
 #include <LittleFS.h>
 // #include <FS.h>
 
 #include "sensor_ini_file_storage.h"
 #include "sensor_config_file_management.h"
+#include "config_schema.h"
+#include "http_request_writer.h"
+#include "history_store.h"
+#include "upload_backlog.h"
+
+#include <algorithm>
+#include <new>
 
 //-- Logging
 //#define GSI_DEBUG
@@ -15,272 +21,532 @@
 
 using namespace sensor;
 
-//-- JS FILE SETTINGS AND CONSTANTS ----------------------------------------------------------------
-const char JS_FILENAME[]           = "/sensor_config.js";
-const char JS_FILENAME_BACKUP[]    = "/sensor_config.js.bu";
-const char JS_FILE_LINE[]          = "\tdocument.getElementById(\"%s\").%s = %s;\n";
-const char JS_FILE_LINE_QUOTES_S[] = "\tdocument.getElementById(\"%s\").%s = \"%s\";\n";
-const char JS_FILE_LINE_QUOTES_D[] = "\tdocument.getElementById(\"%s\").%s = \"%d\";\n";
-const char JS_FILE_LINE_QUOTES_F[] = "\tdocument.getElementById(\"%s\").%s = \"%f\";\n";
-const char JS_FILE_LINE_QUOTES_F1_1[] = "\tdocument.getElementById(\"%s\").%s = \"%1.1f\";\n";
+//-- CONFIG API SETTINGS AND CONSTANTS -------------------------------------------------------------
+const char CONFIG_API_URI[] = "/api/config";
 
-const char JS_FILE_CHECKED[]       = "checked";
-const char JS_FILE_VALUE[]         = "value";
-const char JS_FILE_STYLE_DISPLAY[] = "style.display";
+//-- STATIC FILE SETTINGS AND CONSTANTS ------------------------------------------------------------
+struct MimeType
+{
+  const char *extension;
+  const char *type;
+};
 
-const char JS_FILE_NONE[]          = "none";
-const char JS_FILE_BLOCK[]         = "block";
+const MimeType MIME_TYPES[] =
+{
+  { ".html",        "text/html"                  },
+  { ".htm",         "text/html"                  },
+  { ".css",         "text/css"                   },
+  { ".js",          "application/javascript"     },
+  { ".json",        "application/json"           },
+  { ".png",         "image/png"                  },
+  { ".jpg",         "image/jpeg"                 },
+  { ".gif",         "image/gif"                  },
+  { ".ico",         "image/x-icon"               },
+  { ".svg",         "image/svg+xml"              },
+  { ".xml",         "text/xml"                   },
+  { ".webmanifest", "application/manifest+json"  },
+  { ".ini",         "text/plain"                 },
+};
+
+const char DEFAULT_CONTENT_TYPE[] = "text/plain";
+
+const char ASSETS_ID_FILENAME[] = "/assets.id";
+const char CONFIG_FILE_PREFIX[] = "/sensor_config.";
+const char ICON_DIRECTORY[]     = "/i/";
+const char INDEX_FILENAME[]     = "index.html";
+const char GZIP_EXTENSION[]     = ".gz";
+const char RESTART_PATH[]       = "/restart";
+const char SUBMIT_PATH[]        = "/submit.html";
+const char SUBMIT_EN_PATH[]     = "/submit_en.html";
+const char CACHE_ICONS[]        = "max-age=604800";
+const char CACHE_PAGES[]        = "no-cache";
+const char CACHE_NO_STORE[]     = "no-store";
 
 const char NOT_FOUND[] = " not found\n";
+const char INVALID[]   = " is invalid\n";
+const char BUSY[]      = "The previous configuration is being saved, try again.";
+const char NOT_SAVED[] = "Error saving the configuration!";
 
-//-- handleFileRead --------------------------------------------------------------------------------
-// send the right file to the client (if it exists)
-bool WebConfigManagement::handleFileRead(String path, ESP8266WebServer& server, SensorIniFileStorage &iniFileStorage) 
-{ 
-  SERIAL_PLN("handleFileRead: " + path);
-  if ( path.endsWith("/") ) { path += "index.html"; }   // If a folder is requested, send the index file
-  
-  if ( path.endsWith("/restart") ) 
-  { 
-    String response (
-      "<!DOCTYPE HTML PUBLIC \"-//W3C//DTD HTML 4.01//EN\">"
-      "<html><center><h1>Restart</h1></center></html>"
-    );
-    
-    server.send(200, "text/html", response);
-    delay(1000);
-    ESP.restart();    // Restart the device
-  }
+//-- JsonStringPrint -------------------------------------------------------------------------------
+// Escapes the quotes, the backslashes and the control characters of a value printed into a json string
+class JsonStringPrint : public Print
+{
+public:
+  explicit JsonStringPrint(Print &out): m_out(out) {}
 
-  if ( path.endsWith("/submit.html") || path.endsWith("/submit_en.html") ) 
-  { 
-    String err; 
-    if (false == processSubmit( server, err, iniFileStorage ) )
+  size_t write(uint8_t c) override
+  {
+    if ( 0x20 > c )
     {
-      err += "\nError processing and saving the configuration!";
-      server.send(200, "text/plain", err);
-
-      return false;
+      char escaped[7] = { 0 };
+      snprintf( escaped, sizeof( escaped ), "\\u%04x", c );
+      return m_out.print( escaped );
     }
-  } 
 
-  String contentType = getContentType(path);            // Get the MIME type
-  // if ( SPIFFS.exists(path) )                            // If the file exists 
-  if ( LittleFS.exists(path) )                            // If the file exists 
+    size_t length = 0;
+    if ( '"' == c || '\\' == c ) { length += m_out.write('\\'); }
+    return length + m_out.write( c );
+  }
+
+private:
+  Print &m_out;
+};
+
+//-- printConfigJson -------------------------------------------------------------------------------
+// HttpBodyWriter of GET /api/config: the form fields as a json object
+static void printConfigJson(Print &out, const void *context)
+{
+  const SensorIniFileStorage &iniFileStorage = *static_cast<const SensorIniFileStorage *>( context );
+  JsonStringPrint jsonString( out );
+
+  char separator = '{';
+  for ( uint8_t i = 0; i < CONFIG_FIELD_COUNT; ++i )
   {
-    // File file = SPIFFS.open(path, "r");                 // Open it
-    File file = LittleFS.open(path, "r");                 // Open it
-    /*size_t sent =*/ server.streamFile(file, contentType); // And send it to the client
-    file.close();                                       // Then close the file again
-    return true;
+    const ConfigField &field = CONFIG_FIELDS[i];
+    if ( 0 == ( field.flags & CONFIG_FLAG_FORM ) ) { continue; }
+
+    out.print( separator );  out.print( '"' );  out.print( field.key );  out.print( "\":" );
+    if ( CONFIG_TYPE_STRING == field.type || CONFIG_TYPE_MAC == field.type )
+    {
+      out.print( '"' );
+      printConfigValue( jsonString, field, iniFileStorage );
+      out.print( '"' );
+    }
+    else
+    {
+      printConfigValue( out, field, iniFileStorage );
+    }
+    separator = ',';
   }
-  SERIAL_PLN( F("\tFile not found") );
-  return false;                                         // If the file doesn't exist, return false
+  if ( '{' == separator ) { out.print( separator ); }
+  out.print( '}' );
 }
 
+//-- WindowPrint -----------------------------------------------------------------------------------
+// Keeps the bytes [offset, offset + size) of the printed text. An asynchronous response asks for its
+// content piece by piece, every piece is rendered again from the start without a buffer.
+class WindowPrint : public Print
+{
+public:
+  WindowPrint(uint8_t *buffer, size_t size, size_t offset): m_buffer(buffer), m_size(size), m_offset(offset) {}
+
+  using Print::write;
+  size_t write(uint8_t c) override
+  {
+    if ( m_offset <= m_position && m_position < m_offset + m_size ) { m_buffer[ m_position - m_offset ] = c; }
+    ++m_position;
+    return 1;
+  }
 
-//-- getContentType --------------------------------------------------------------------------------
-// convert the file extension to the MIME type
-String WebConfigManagement::getContentType(String filename)
-{ 
-  if      ( filename.endsWith(".html") ) { return "text/html";              } 
-  else if ( filename.endsWith(".css")  ) { return "text/css";               } 
-  else if ( filename.endsWith(".js")   ) { return "application/javascript"; } 
-  else if ( filename.endsWith(".ico")  ) { return "image/x-icon";           } 
-  return "text/plain";
-}
+  size_t length() const { return ( m_position <= m_offset ? 0 : std::min( m_position - m_offset, m_size ) ); }
 
+private:
+  uint8_t *m_buffer;
+  size_t   m_size;
+  size_t   m_offset;
+  size_t   m_position = 0;
+};
 
-//-- generateJsFile --------------------------------------------------------------------------------
-bool WebConfigManagement::generateJsFile(const SensorIniFileStorage &iniFileStorage)
+//-- begin -----------------------------------------------------------------------------------------
+void WebConfigManagement::begin(AsyncWebServer& server, SensorIniFileStorage &iniFileStorage)
 {
-  SERIAL_PLN("Generating a new js file.");
+  m_iniFileStorage = &iniFileStorage;
+  buildRoutes();
+
+  server.on( CONFIG_API_URI, HTTP_GET, [this](AsyncWebServerRequest *request) { sendConfig( request ); } );
+  server.on( CONFIG_API_URI, HTTP_PUT, [this](AsyncWebServerRequest *request) { updateConfig( request ); } );
+  server.addHandler( this );
+}
 
-  // Create a back-up file from the original
-  if (false == LittleFS.rename(JS_FILENAME, JS_FILENAME_BACKUP) )
+//-- loop ------------------------------------------------------------------------------------------
+void WebConfigManagement::loop()
+{
+  if ( true == m_isIniWritePending )
   {
-    SERIAL_PLN("Error creating js file back-up.");
-    return false;
+    m_isIniWritePending = false;
+    bool result = sensor::SensorConfigFile::writeIniFile( *m_iniFileStorage ); // New config, new ini file
+    SERIAL_PF("Write submitted config: %d\n", result);
+    answerSubmit( result );
   }
 
-  // Create a new js file
-  File jsFile = LittleFS.open(JS_FILENAME, "w");
-  if ( false == jsFile )
+  if ( true == m_isRestartRequested && WEB_RESTART_DELAY <= millis() - m_restartTime )
   {
-    SERIAL_PLN("Error creating js file.");
-    return false;
+    ESP.restart();    // Restart the device
   }
+}
 
-  jsFile.println( F("function setValues()\n{") );
-  // [network]
-  jsFile.printf( JS_FILE_LINE, INI_NET_WIFI_ENABLED, JS_FILE_CHECKED, (true == iniFileStorage.wifi_enabled ? "true" : "false" ) );
-  jsFile.printf( JS_FILE_LINE, INI_NET_WIFI_ENABLED, JS_FILE_VALUE,   (true == iniFileStorage.wifi_enabled ? "true" : "false" ) );
-  jsFile.printf( JS_FILE_LINE_QUOTES_S, INI_NET_WIFI_AP_SSID, JS_FILE_VALUE, iniFileStorage.wifi_ap_ssid );
-  jsFile.printf( JS_FILE_LINE_QUOTES_S, INI_NET_WIFI_AP_PWD,  JS_FILE_VALUE, iniFileStorage.wifi_ap_pwd );
-  jsFile.printf( JS_FILE_LINE_QUOTES_D, INI_NET_WIFI_CON_DELAY,         JS_FILE_VALUE, iniFileStorage.wifi_con_delay );
-  jsFile.printf( JS_FILE_LINE_QUOTES_D, INI_NET_WIFI_MAX_CON_ATTEMPTS,  JS_FILE_VALUE, iniFileStorage.wifi_max_con_attempts );
-  
-  // [data upload]
-  jsFile.printf( JS_FILE_LINE_QUOTES_D, INI_DATA_FREQ,               JS_FILE_VALUE, iniFileStorage.upload_freq );
-  jsFile.printf( JS_FILE_LINE_QUOTES_D, INI_DATA_UPLOAD_TIMEOUT,     JS_FILE_VALUE, iniFileStorage.upload_timeout );
-  jsFile.printf( JS_FILE_LINE_QUOTES_S, INI_DATA_DEVICE_ID,          JS_FILE_VALUE, iniFileStorage.device_id );
-  jsFile.printf( JS_FILE_LINE_QUOTES_S, INI_DATA_LOCATION,           JS_FILE_VALUE, iniFileStorage.location );
-  jsFile.printf( JS_FILE_LINE_QUOTES_S, INI_DATA_MEASUREMENT_ORG,    JS_FILE_VALUE, iniFileStorage.data_measurement_org );
-  jsFile.printf( JS_FILE_LINE_QUOTES_S, INI_DATA_MEASUREMENT_BUCKET, JS_FILE_VALUE, iniFileStorage.data_measurement_bucket );
-  jsFile.printf( JS_FILE_LINE_QUOTES_S, INI_DATA_MEASUREMENT_NAME,   JS_FILE_VALUE, iniFileStorage.data_measurement_name );
-
-  // server config
-  jsFile.printf( JS_FILE_LINE_QUOTES_S, INI_SERVER_ADDRESS,    JS_FILE_VALUE, iniFileStorage.server_address );
-  jsFile.printf( JS_FILE_LINE_QUOTES_D, INI_SERVER_PORT,       JS_FILE_VALUE, iniFileStorage.server_port );
-  jsFile.printf( JS_FILE_LINE_QUOTES_S, INI_SERVER_AUTH_TOKEN, JS_FILE_VALUE, iniFileStorage.server_auth_token );
-
-
-  // [display]
-  jsFile.printf( JS_FILE_LINE_QUOTES_D, INI_DISP_CONTRAST,    JS_FILE_VALUE, iniFileStorage.display_contrast );
-  jsFile.printf( JS_FILE_LINE, INI_DISP_ROTATION, JS_FILE_CHECKED, (true == iniFileStorage.display_rotation ? "true" : "false" ) );
-  
-  // [sensor]
-  jsFile.printf( JS_FILE_LINE_QUOTES_F1_1, INI_SENSOR_TEMP_CORRECTION, JS_FILE_VALUE, iniFileStorage.sensor_temp_correction );
+//-- sendConfig ------------------------------------------------------------------------------------
+// The json is rendered from the storage while it is sent
+void WebConfigManagement::sendConfig(AsyncWebServerRequest *request)
+{
+  LengthCounter length;
+  printConfigJson( length, m_iniFileStorage );
 
-  // [battery]
-  jsFile.printf( JS_FILE_LINE_QUOTES_D, INI_BATTERY_MIN_LEVEL, JS_FILE_VALUE, iniFileStorage.batteryMinLevel );
-  jsFile.printf( JS_FILE_LINE_QUOTES_D, INI_BATTERY_MAX_LEVEL, JS_FILE_VALUE, iniFileStorage.batteryMaxLevel );
+  const SensorIniFileStorage *iniFileStorage = m_iniFileStorage;
+  AsyncWebServerResponse *response = request->beginResponse( "application/json", length.length(),
+    [iniFileStorage](uint8_t *buffer, size_t maxLen, size_t index) -> size_t
+    {
+      WindowPrint window( buffer, maxLen, index );
+      printConfigJson( window, iniFileStorage );
+      return window.length();
+    } );
+  response->addHeader( "Cache-Control", CACHE_NO_STORE );
+  request->send( response );
+}
+
+//-- updateConfig ----------------------------------------------------------------------------------
+// The body is urlencoded like the form, so the form fields are parsed by the server
+void WebConfigManagement::updateConfig(AsyncWebServerRequest *request)
+{
+  if ( true == m_isIniWritePending )
+  {
+    request->send( 503, "text/plain", BUSY );
+    return;
+  }
 
+  String err;
+  if ( false == processSubmit( request, err ) )
+  {
+    err += "\nError processing and saving the configuration!";
+    request->send( 400, "text/plain", err );
+    return;
+  }
+  deferResponse( request ); // 204 when the ini file has been written
+}
 
-  jsFile.println("}");
+//-- deferResponse ---------------------------------------------------------------------------------
+// The request is answered by loop() after the ini file has been written, the client waits for it.
+// If the client closes the connection before, the request is deleted by the server.
+void WebConfigManagement::deferResponse(AsyncWebServerRequest *request)
+{
+  m_pendingRequest = request;
+  request->onDisconnect( [this, request]() 
+  { 
+    if ( request == m_pendingRequest ) { m_pendingRequest = nullptr; } 
+  } );
+}
 
-  jsFile.close();
+//-- answerSubmit ----------------------------------------------------------------------------------
+// The api gets 204 or the error, the posted form gets its page or the error
+void WebConfigManagement::answerSubmit(bool isSaved)
+{
+  AsyncWebServerRequest *request = m_pendingRequest;
+  m_pendingRequest = nullptr;
+  if ( nullptr == request ) { return; } // the client is gone
 
-  // Remove the back-up file
-  if ( false == LittleFS.remove(JS_FILENAME_BACKUP) )
+  if ( HTTP_PUT == request->method() )
+  {
+    if ( true == isSaved ) { request->send( 204 ); }
+    else                   { request->send( 500, "text/plain", NOT_SAVED ); }
+  }
+  else if ( false == isSaved )
+  {
+    request->send( 200, "text/plain", NOT_SAVED );
+  }
+  else if ( false == handleFileRead( request, true ) )
   {
-    SERIAL_PLN("Error removing js back-up file.");
+    request->send( 404, "text/plain", "404: Not Found" );
   }
+}
+
+//-- canHandle -------------------------------------------------------------------------------------
+bool WebConfigManagement::canHandle(AsyncWebServerRequest *request)
+{
+  if ( 0 == ( request->method() & ( HTTP_GET | HTTP_HEAD | HTTP_POST ) ) ) { return false; }
+
+  char path[WEB_PATH_MAX_LENGTH] = { 0 };
+  if ( 0 == resolvePath( request->url(), path, sizeof(path) ) ) { return false; }
+  if ( nullptr == findRoute( path ) )                           { return false; }
 
+  request->addInterestingHeader( "If-None-Match" );
   return true;
 }
 
+//-- handleRequest ---------------------------------------------------------------------------------
+void WebConfigManagement::handleRequest(AsyncWebServerRequest *request)
+{
+  if ( false == handleFileRead( request ) )
+  {
+    request->send(404, "text/plain", "404: Not Found"); // otherwise, respond with a 404 (Not Found) error
+  }
+}
 
-//-- processSubmit ---------------------------------------------------------------------------------
-bool WebConfigManagement::processSubmit(ESP8266WebServer& server, String &error, SensorIniFileStorage &iniFileStorage)
+//-- resolvePath -----------------------------------------------------------------------------------
+// If a folder is requested, the index file is sent. There is room for the ".gz" extension too.
+size_t WebConfigManagement::resolvePath(const String &uri, char *path, size_t size) const
 {
-  bool result = true;
+  size_t length = uri.length();
+  if ( size < length + sizeof(INDEX_FILENAME) + sizeof(GZIP_EXTENSION) ) { return 0; }
 
-  error = "";
-  bool value = false;
+  memcpy( path, uri.c_str(), length );
+  path[length] = 0;
+  if ( 0 == length || '/' == path[length - 1] ) 
+  { 
+    strcpy( path + length, INDEX_FILENAME );
+    length += strlen( INDEX_FILENAME );
+  }
+  return length;
+}
+
+//-- handleFileRead --------------------------------------------------------------------------------
+// send the right file to the client (if it exists)
+bool WebConfigManagement::handleFileRead(AsyncWebServerRequest *request, bool isSubmitSaved) 
+{ 
+  SERIAL_PF("handleFileRead: %s\n", request->url().c_str());
+
+  char path[WEB_PATH_MAX_LENGTH] = { 0 };
+  size_t length = resolvePath( request->url(), path, sizeof(path) );
+  const WebRoute *route = ( 0 == length ? nullptr : findRoute( path ) );
+  if ( nullptr == route )
+  {
+    SERIAL_PLN( F("\tFile not found") );
+    return false;                                       // If the file doesn't exist, return false
+  }
+  
+  if ( 0 != ( route->flags & WEB_ROUTE_RESTART ) ) 
+  { 
+    AsyncWebServerResponse *response = request->beginResponse(200, "text/html", 
+      "<!DOCTYPE HTML PUBLIC \"-//W3C//DTD HTML 4.01//EN\">"
+      "<html><center><h1>Restart</h1></center></html>"
+    );
+    response->addHeader( "Connection", "close" );
+    request->send( response );
 
-  // [network]
-  parseSubmit(server, error, INI_NET_WIFI_ENABLED, value );  iniFileStorage.wifi_enabled = value; 
-  parseSubmit(server, error, INI_NET_WIFI_AP_SSID, iniFileStorage.wifi_ap_ssid, MAX_LEN_SSID );
-  parseSubmit(server, error, INI_NET_WIFI_AP_PWD,  iniFileStorage.wifi_ap_pwd, MAX_LEN_PWD );
-    memset(iniFileStorage.wifi_ap_bssid, 0, sizeof(uint8_t) * 6 ); // clean out BSSID
+    m_isRestartRequested = true;
+    m_restartTime = millis();
+    return true;
+  }
 
-  parseSubmit(server, error, INI_NET_WIFI_CON_DELAY,        iniFileStorage.wifi_con_delay );
-  parseSubmit(server, error, INI_NET_WIFI_MAX_CON_ATTEMPTS, iniFileStorage.wifi_max_con_attempts );
+  // The form is posted here if the page could not use the api
+  if ( 0 != ( route->flags & WEB_ROUTE_SUBMIT ) && HTTP_POST == request->method() && false == isSubmitSaved ) 
+  { 
+    if ( true == m_isIniWritePending )
+    {
+      request->send( 200, "text/plain", BUSY );
+      return true;
+    }
 
-  // [data upload]
-  parseSubmit(server, error, INI_DATA_FREQ,               iniFileStorage.upload_freq );
-  parseSubmit(server, error, INI_DATA_UPLOAD_TIMEOUT,     iniFileStorage.upload_timeout );
-  parseSubmit(server, error, INI_DATA_DEVICE_ID,          iniFileStorage.device_id, MAX_LEN_DEVICE_ID );
-  parseSubmit(server, error, INI_DATA_LOCATION,           iniFileStorage.location, MAX_LEN_LOCATION );
-  parseSubmit(server, error, INI_DATA_MEASUREMENT_ORG,    iniFileStorage.data_measurement_org, MAX_LEN_DATA_MEASUREMENT_ORG );
-  parseSubmit(server, error, INI_DATA_MEASUREMENT_BUCKET, iniFileStorage.data_measurement_bucket, MAX_LEN_DATA_MEASUREMENT_BUCKET );
-  parseSubmit(server, error, INI_DATA_MEASUREMENT_NAME,   iniFileStorage.data_measurement_name, MAX_LEN_DATA_MEASUREMENT_NAME );
+    String err; 
+    if (false == processSubmit( request, err ) )
+    {
+      err += "\nError processing and saving the configuration!";
+      request->send(200, "text/plain", err);
+      return true;
+    }
+    deferResponse( request ); // the page is sent when the ini file has been written
+    return true;
+  } 
 
+  char etag[11] = { 0 };
+  if ( 0 != route->etag )
+  {
+    snprintf( etag, sizeof( etag ), "\"%08x\"", static_cast<unsigned>( route->etag ) );
+  }
+  const char *cacheControl = ( 0 != ( route->flags & WEB_ROUTE_ICON ) ? CACHE_ICONS : CACHE_PAGES );
 
-  // [server confing]
-  parseSubmit(server, error, INI_SERVER_ADDRESS,     iniFileStorage.server_address, MAX_LEN_SERVER_ADDRESS );
-  parseSubmit(server, error, INI_SERVER_PORT,        iniFileStorage.server_port );
-  parseSubmit(server, error, INI_SERVER_AUTH_TOKEN,  iniFileStorage.server_auth_token, MAX_LEN_SERVER_AUTH_TOKEN );
+  AsyncWebServerResponse *response = nullptr;
+  AsyncWebHeader *ifNoneMatch = request->getHeader( "If-None-Match" );
+  if ( 0 != etag[0] && nullptr != ifNoneMatch && 0 == strcmp( etag, ifNoneMatch->value().c_str() ) )
+  {
+    response = request->beginResponse( 304 );
+  }
+  else
+  {
+    if ( 0 != ( route->flags & WEB_ROUTE_GZIP ) ) { strcpy( path + length, GZIP_EXTENSION ); }
+    File file = LittleFS.open(path, "r");               // Open it
+    if ( false == file )
+    {
+      SERIAL_PF("\tFile cannot be opened: %s\n", path);
+      return false;
+    }
+    SERIAL_PF("\t%s: %u bytes\n", path, static_cast<unsigned>( route->size ));
 
+    // The response adds "Content-Encoding: gzip" for a .gz file of a path without the extension,
+    // and closes the file when it has been sent
+    path[length] = 0;
+    response = request->beginResponse( file, path, route->contentType );
+  }
 
-  // [display]
-  parseSubmit(server, error, INI_DISP_CONTRAST,           iniFileStorage.display_contrast );
-  parseSubmit(server, error, INI_DISP_ROTATION, value );  iniFileStorage.display_rotation = value; 
+  if ( 0 != etag[0] ) { response->addHeader( "ETag", etag ); }
+  response->addHeader( "Cache-Control", cacheControl );
+  request->send( response );
+  return true;
+}
 
-  // [sensor]
-  parseSubmit(server, error, INI_SENSOR_TEMP_CORRECTION, iniFileStorage.sensor_temp_correction); 
 
-  // [battery]
-  parseSubmit(server, error, INI_BATTERY_MIN_LEVEL, iniFileStorage.batteryMinLevel); 
-  parseSubmit(server, error, INI_BATTERY_MAX_LEVEL, iniFileStorage.batteryMaxLevel); 
+//-- getContentType --------------------------------------------------------------------------------
+// convert the file extension to the MIME type
+const char *WebConfigManagement::getContentType(const char *filename)
+{ 
+  size_t length = strlen( filename );
+  for ( const MimeType &mimeType : MIME_TYPES )
+  {
+    size_t extensionLength = strlen( mimeType.extension );
+    if ( extensionLength <= length && 0 == strcmp( filename + length - extensionLength, mimeType.extension ) )
+    {
+      return mimeType.type;
+    }
+  }
+  return DEFAULT_CONTENT_TYPE;
+}
 
 
-  if ( 0 < error.length() ) { SERIAL_PLN(error); result = false; }
+//-- buildRoutes -----------------------------------------------------------------------------------
+// The ETag of a file changes with the id of the file system image (see tools/compress_assets.py)
+void WebConfigManagement::buildRoutes()
+{
+  m_routeCount    = 0;
+  m_pathPoolUsed  = 0;
 
-  result = generateJsFile(iniFileStorage); // New config, new js file
-  result |= sensor::SensorConfigFile::writeIniFile( iniFileStorage ); // New config, new ini file
+  String assetsId;
+  File file = LittleFS.open(ASSETS_ID_FILENAME, "r");
+  if ( true == file )
+  {
+    assetsId = file.readStringUntil('\n');
+    assetsId.trim();
+    file.close();
+  }
+  SERIAL_PF("Assets id: %s\n", assetsId.c_str());
 
-  // u8g2.setContrast(iniFileStorage.display_contrast); // 155 - Home; 127 - Office
-  // drawScreen();
+  WebRoute restart = { 0, 0, 0, 0, "text/html", WEB_ROUTE_RESTART };
+  addRoute( restart, RESTART_PATH );
+  addRoutes( "/", assetsId );
 
-  return result;
+  SERIAL_PF("Web routes: %d\n", m_routeCount);
 }
 
 
-//-- parseSubmit char* -----------------------------------------------------------------------------
-bool WebConfigManagement::parseSubmit(ESP8266WebServer& server, String &error, const char *INI_ITEM, 
-                                      char *storage, const uint8_t MAX_LEN)
+//-- addRoutes -------------------------------------------------------------------------------------
+// The files of the directory and its subdirectories. The files written by the device are not 
+// served, the config is available on the api.
+void WebConfigManagement::addRoutes(const String &directory, const String &assetsId)
 {
-  if ( true == server.hasArg( INI_ITEM ) ) 
+  Dir dir = LittleFS.openDir( directory );
+  while ( true == dir.next() )
   {
-    SERIAL_PF("%s = %s\n", INI_ITEM, server.arg( INI_ITEM ).c_str() );
-    strcpy( storage, server.arg(INI_ITEM).substring(0, MAX_LEN).c_str() );
-    SERIAL_PF("\tStorage: \"%s\"\n", storage );
-    return true;
-  } else { error += INI_ITEM; error += NOT_FOUND; return false; }
+    String path = directory + dir.fileName();
+    if ( true == dir.isDirectory() )
+    {
+      if ( path + "/" != HISTORY_DIRECTORY && path + "/" != BACKLOG_DIRECTORY ) { addRoutes( path + "/", assetsId ); }
+      continue;
+    }
+    if ( true == path.startsWith( CONFIG_FILE_PREFIX ) || path == ASSETS_ID_FILENAME ) { continue; }
+
+    WebRoute route = { 0, 0, static_cast<uint32_t>( dir.fileSize() ), 0, nullptr, 0 };
+    if ( true == path.endsWith( GZIP_EXTENSION ) )
+    {
+      path.remove( path.length() - strlen( GZIP_EXTENSION ) );
+      route.flags |= WEB_ROUTE_GZIP;
+    }
+    if ( WEB_PATH_MAX_LENGTH < path.length() + sizeof(GZIP_EXTENSION) )
+    {
+      SERIAL_PF("Web route: path too long: %s\n", path.c_str());
+      continue;
+    }
+
+    route.pathHash    = hashConfigName( path.c_str() );
+    route.contentType = getContentType( path.c_str() );
+    if ( true == path.startsWith( ICON_DIRECTORY ) )                           { route.flags |= WEB_ROUTE_ICON; }
+    if ( path.endsWith( SUBMIT_PATH ) || path.endsWith( SUBMIT_EN_PATH ) )    { route.flags |= WEB_ROUTE_SUBMIT; }
+    if ( 0 < assetsId.length() )
+    {
+      route.etag = hashConfigName( assetsId.c_str(), route.pathHash ^ route.size );
+      if ( 0 == route.etag ) { route.etag = 1; }
+    }
+    addRoute( route, path.c_str() );
+  }
 }
 
-//-- parseSubmit uint8_t ---------------------------------------------------------------------------
-bool WebConfigManagement::parseSubmit(ESP8266WebServer& server, String &error, const char *INI_ITEM, 
-                                      uint8_t &storage)
+
+//-- addRoute --------------------------------------------------------------------------------------
+// The path is copied into the path pool, the hash of the route is calculated here
+bool WebConfigManagement::addRoute(WebRoute route, const char *path)
 {
-  if ( true == server.hasArg( INI_ITEM ) ) 
+  size_t size = strlen( path ) + 1;
+  if ( WEB_ROUTE_MAX <= m_routeCount || WEB_PATH_POOL_SIZE < m_pathPoolUsed + size )
   {
-    SERIAL_PF("%s = %s\n", INI_ITEM, server.arg( INI_ITEM ).c_str() );
-    storage = static_cast<uint8_t>( atoi( server.arg(INI_ITEM).c_str() ) );
-    return true;
-  } else { error += INI_ITEM; error += NOT_FOUND; return false;}
+    SERIAL_PLN("Web route table full.");
+    return false;
+  }
+  if ( nullptr != findRoute( path ) )
+  {
+    SERIAL_PF("Web route: duplicate path %s\n", path);
+    return false;
+  }
+
+  memcpy( m_pathPool + m_pathPoolUsed, path, size );
+  route.pathHash   = hashConfigName( path );
+  route.pathOffset = m_pathPoolUsed;
+  m_pathPoolUsed  += size;
+
+  m_routes[ m_routeCount++ ] = route;
+  return true;
 }
 
-//-- parseSubmit uint16_t --------------------------------------------------------------------------
-bool WebConfigManagement::parseSubmit(ESP8266WebServer& server, String &error, const char *INI_ITEM,
-                                      uint16_t &storage)
+
+//-- findRoute -------------------------------------------------------------------------------------
+// The hash filters the routes, the path decides
+const WebRoute *WebConfigManagement::findRoute(const char *path) const
 {
-  if ( true == server.hasArg( INI_ITEM ) ) 
+  uint32_t pathHash = hashConfigName( path );
+  for ( uint8_t i = 0; i < m_routeCount; ++i )
   {
-    SERIAL_PF("%s = %s\n", INI_ITEM, server.arg( INI_ITEM ).c_str() );
-    storage = static_cast<uint16_t>( atoi( server.arg(INI_ITEM).c_str() ) );
-    return true;
-  } else { error += INI_ITEM; error += NOT_FOUND; return false;}
+    if ( pathHash == m_routes[i].pathHash && 0 == strcmp( path, m_pathPool + m_routes[i].pathOffset ) ) 
+    { 
+      return &m_routes[i]; 
+    }
+  }
+  return nullptr;
 }
 
-//-- parseSubmit float -----------------------------------------------------------------------------
-bool WebConfigManagement::parseSubmit(ESP8266WebServer& server, String &error, const char *INI_ITEM,
-                                      float &storage)
+
+//-- processSubmit ---------------------------------------------------------------------------------
+// The form is parsed into a copy, the config is only changed if every field is valid
+bool WebConfigManagement::processSubmit(AsyncWebServerRequest *request, String &error)
 {
-  if ( true == server.hasArg( INI_ITEM ) ) 
+  error = "";
+
+  // The storage is too large for the stack of the TCP callbacks
+  SensorIniFileStorage *submitted = new (std::nothrow) SensorIniFileStorage( *m_iniFileStorage );
+  if ( nullptr == submitted )
   {
-    SERIAL_PF("%s = %s\n", INI_ITEM, server.arg( INI_ITEM ).c_str() );
-    storage = atof( server.arg(INI_ITEM).c_str() );
-    return true;
-  } else { error += INI_ITEM; error += NOT_FOUND; return false;}
-}
+    error = "Out of memory\n";
+    return false;
+  }
 
-//-- parseSubmit bool ------------------------------------------------------------------------------
-bool WebConfigManagement::parseSubmit(ESP8266WebServer& server, String &error, const char *INI_ITEM,
-                                      bool &storage)
-{
-  if ( true == server.hasArg( INI_ITEM ) ) 
+  for ( uint8_t i = 0; i < CONFIG_FIELD_COUNT; ++i )
   {
-    SERIAL_PF("%s = %s\n", INI_ITEM, server.arg( INI_ITEM ).c_str() );
-    storage = true;
-    return true;
-  } 
-  else 
+    const ConfigField &field = CONFIG_FIELDS[i];
+    if ( 0 == ( field.flags & CONFIG_FLAG_FORM ) ) { continue; }
+
+    AsyncWebParameter *param = request->getParam( field.key, true );
+    if ( CONFIG_TYPE_BOOL == field.type ) 
+    {
+      // An unchecked checkbox is not submitted
+      parseConfigValue( field, ( nullptr != param ? "true" : "false" ), *submitted );
+    }
+    else if ( nullptr == param ) 
+    { 
+      error += field.key; error += NOT_FOUND; 
+    }
+    else if ( false == parseConfigValue( field, param->value().c_str(), *submitted ) )
+    {
+      error += field.key; error += INVALID;
+    }
+  }
+
+  if ( 0 < error.length() ) 
   { 
-    SERIAL_PF("%s = %s (Checkbox not present)\n", INI_ITEM, "false" );
-    storage = false;
-    return false;
+    delete submitted;
+    SERIAL_PLN(error); 
+    return false; // neither the config nor the ini file is changed
   }
-}
\ No newline at end of file
+
+  memset(submitted->wifi_ap_bssid, 0, sizeof(uint8_t) * 6 ); // clean out BSSID, the AP may have changed
+  *m_iniFileStorage = *submitted;
+  delete submitted;
+
+  m_isIniWritePending = true; // New config, new ini file
+
+  return true;
+}
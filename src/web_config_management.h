@@ -2,52 +2,111 @@
 #define __WEB_CONFIG_MANAGEMENT_H__
 
 #include <Arduino.h>
-#include <ESP8266WebServer.h>
-
-// class ESP8266WebServer;
+#include <ESPAsyncWebServer.h>
 
 namespace sensor
 {
 
 struct SensorIniFileStorage;
 
-class WebConfigManagement
+const uint8_t  WEB_ROUTE_MAX       = 24;
+const size_t   WEB_PATH_MAX_LENGTH = 64;   // LittleFS path of a file, with the ".gz" extension
+const size_t   WEB_PATH_POOL_SIZE  = 768;  // the paths of the routes, one after the other
+const uint32_t WEB_RESTART_DELAY   = 1000; // ms, the response of /restart is sent before it
+
+//-- flags of WebRoute
+const uint8_t WEB_ROUTE_GZIP    = 0x01; // the file is stored as <path>.gz
+const uint8_t WEB_ROUTE_ICON    = 0x02; // cached by the browser, the others are revalidated
+const uint8_t WEB_ROUTE_SUBMIT  = 0x04; // a posted form is processed before the file is sent
+const uint8_t WEB_ROUTE_RESTART = 0x08; // there is no file, the device restarts
+
+//-- WebRoute --------------------------------------------------------------------------------------
+// A static file of the config portal. The table is built from LittleFS when the server starts, so
+// a request is resolved by the hash of its path, without a file system probe. The path itself is
+// compared too, two paths may have the same hash.
+struct WebRoute
+{
+  uint32_t    pathHash;    // hashConfigName( path ), the same FNV-1a as the config keys
+  uint16_t    pathOffset;  // of the path in the path pool
+  uint32_t    size;        // of the stored file
+  uint32_t    etag;        // 0 - no validation
+  const char *contentType;
+  uint8_t     flags;
+};
+
+//-- WebConfigManagement ---------------------------------------------------------------------------
+// The config portal on the asynchronous web server (ESPAsyncWebServer). The requests are handled in
+// the callbacks of the TCP stack, concurrently and without blocking the loop. The work that must
+// not run there (writing the ini file, restart) is done by loop(). A submitted config is answered
+// after it has been written, so the page shows a failed write.
+class WebConfigManagement : public AsyncWebHandler
 {
 
 public:
 
-  //-- handleFileRead ------------------------------------------------------------------------------
-  // send the right file to the client (if it exists)
-  bool handleFileRead(String path, ESP8266WebServer& server, SensorIniFileStorage &iniFileStorage);
+  //-- begin ---------------------------------------------------------------------------------------
+  // builds the route table and registers the static files and the config api, before the server 
+  // starts
+  void begin(AsyncWebServer& server, SensorIniFileStorage &iniFileStorage);
+
+  //-- loop ----------------------------------------------------------------------------------------
+  // writes the submitted config and answers its request, restarts the device when it is requested
+  void loop();
+
+  //-- AsyncWebHandler: the static files of the route table
+  bool canHandle(AsyncWebServerRequest *request) override;
+  void handleRequest(AsyncWebServerRequest *request) override;
+  bool isRequestHandlerTrivial() override { return false; } // the posted form must be parsed
 
 
 private:
-  //-- getContentType ------------------------------------------------------------------------------
-  // convert the file extension to the MIME type
-  String getContentType(String filename);
+  //-- handleFileRead ------------------------------------------------------------------------------
+  // send the right file to the client (if it exists). isSubmitSaved: the posted form has already
+  // been processed and written, the page is sent only.
+  bool handleFileRead(AsyncWebServerRequest *request, bool isSubmitSaved = false);
 
-  //-- generateJsFile ------------------------------------------------------------------------------
-  bool generateJsFile(const SensorIniFileStorage &iniFileStorage);
+  //-- resolvePath: the LittleFS path of the uri (index.html for a folder), 0 if it is too long
+  size_t resolvePath(const String &uri, char *path, size_t size) const;
 
-  //-- processSubmit -------------------------------------------------------------------------------
-  bool processSubmit(ESP8266WebServer& server, String &error, SensorIniFileStorage &iniFileStorage);
+  //-- getContentType ------------------------------------------------------------------------------
+  // convert the file extension to the MIME type
+  const char *getContentType(const char *filename);
 
-  //-- parseSubmit ---------------------------------------------------------------------------------
-  bool parseSubmit(ESP8266WebServer& server, String &error, const char *INI_ITEM, char *storage, 
-                  const uint8_t MAX_LEN);
-  
-  //-- parseSubmit uint8_t -------------------------------------------------------------------------
-  bool parseSubmit(ESP8266WebServer& server, String &error, const char *INI_ITEM, uint8_t &storage);
+  //-- buildRoutes ---------------------------------------------------------------------------------
+  void buildRoutes();
+  void addRoutes(const String &directory, const String &assetsId);
+  bool addRoute(WebRoute route, const char *path);
 
-  //-- parseSubmit uint16_t ------------------------------------------------------------------------
-  bool parseSubmit(ESP8266WebServer& server, String &error, const char *INI_ITEM, uint16_t &storage);
+  //-- findRoute: nullptr if the path is unknown
+  const WebRoute *findRoute(const char *path) const;
 
-  //-- parseSubmit float ---------------------------------------------------------------------------
-  bool parseSubmit(ESP8266WebServer& server, String &error, const char *INI_ITEM, float &storage);
+  //-- sendConfig ----------------------------------------------------------------------------------
+  // GET /api/config: the form fields as json
+  void sendConfig(AsyncWebServerRequest *request);
 
-  //-- parseSubmit bool ----------------------------------------------------------------------------
-  bool parseSubmit(ESP8266WebServer& server, String &error, const char *INI_ITEM, bool &storage);
+  //-- updateConfig --------------------------------------------------------------------------------
+  // PUT /api/config: urlencoded form fields, the response is 204 or the errors as text
+  void updateConfig(AsyncWebServerRequest *request);
 
+  //-- processSubmit -------------------------------------------------------------------------------
+  // the ini file is written by loop()
+  bool processSubmit(AsyncWebServerRequest *request, String &error);
+
+  //-- deferResponse, answerSubmit -----------------------------------------------------------------
+  // the request of the submit waits for the result of the write in loop()
+  void deferResponse(AsyncWebServerRequest *request);
+  void answerSubmit(bool isSaved);
+
+  SensorIniFileStorage *m_iniFileStorage = nullptr;
+  bool     m_isIniWritePending  = false;
+  AsyncWebServerRequest *m_pendingRequest = nullptr; // answered by loop(), nullptr if the client is gone
+  bool     m_isRestartRequested = false;
+  uint32_t m_restartTime        = 0; // millis() of the restart request
+
+  WebRoute m_routes[WEB_ROUTE_MAX];
+  uint8_t  m_routeCount = 0;
+  char     m_pathPool[WEB_PATH_POOL_SIZE];
+  uint16_t m_pathPoolUsed = 0;
 };
 
 }; // namespace
@@ -0,0 +1,136 @@
+#ifndef __ARDUINO_STUB_H__
+#define __ARDUINO_STUB_H__
+
+//-- ARDUINO STUB ----------------------------------------------------------------------------------
+// The part of the ESP8266 Arduino core which the pure modules use, for the native test env. The
+// clock is simulated: millis() returns g_stubMillis, delay() advances it.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <math.h>
+#include <algorithm>
+#include <string>
+
+#define PROGMEM
+#define F( TEXT ) TEXT
+
+//-- millis, delay ---------------------------------------------------------------------------------
+inline uint32_t g_stubMillis = 0;
+
+inline unsigned long millis() { return g_stubMillis; }
+inline void delay(unsigned long ms) { g_stubMillis += ms; }
+inline void yield() {}
+
+#define constrain( VALUE, LOW, HIGH ) ( (VALUE) < (LOW) ? (LOW) : ( (VALUE) > (HIGH) ? (HIGH) : (VALUE) ) )
+
+//-- String ----------------------------------------------------------------------------------------
+class String
+{
+public:
+  String(const char *text = "") : m_text( NULL == text ? "" : text ) {}
+  String(const std::string &text) : m_text( text ) {}
+
+  const char *c_str() const { return m_text.c_str(); }
+  unsigned int length() const { return m_text.size(); }
+
+  bool startsWith(const char *prefix) const { return 0 == m_text.compare( 0, strlen( prefix ), prefix ); }
+  bool endsWith(const char *suffix) const
+  {
+    size_t length = strlen( suffix );
+    return length <= m_text.size() && 0 == m_text.compare( m_text.size() - length, length, suffix );
+  }
+  void remove(unsigned int index) { m_text.erase( std::min<size_t>( index, m_text.size() ) ); }
+  void trim()
+  {
+    size_t start = m_text.find_first_not_of( " \t\r\n" );
+    m_text = ( std::string::npos == start ? "" : m_text.substr( start, m_text.find_last_not_of( " \t\r\n" ) - start + 1 ) );
+  }
+
+  String &operator+=(const char *text) { m_text += text; return *this; }
+  String &operator+=(const String &text) { m_text += text.m_text; return *this; }
+  String operator+(const char *text) const { return String( m_text + text ); }
+  String operator+(const String &text) const { return String( m_text + text.m_text ); }
+  bool operator==(const char *text) const { return m_text == text; }
+  bool operator!=(const char *text) const { return m_text != text; }
+  bool operator==(const String &text) const { return m_text == text.m_text; }
+
+private:
+  std::string m_text;
+};
+
+//-- Print -----------------------------------------------------------------------------------------
+class Print
+{
+public:
+  virtual ~Print() {}
+
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *data, size_t size)
+  {
+    size_t written = 0;
+    while ( 0 < size-- && 1 == write( *data++ ) ) { ++written; }
+    return written;
+  }
+  size_t write(const char *data, size_t size) { return write( reinterpret_cast<const uint8_t *>( data ), size ); }
+  size_t write(const char *text) { return write( text, strlen( text ) ); }
+
+  size_t print(const char *text) { return write( text ); }
+  size_t print(const String &text) { return write( text.c_str() ); }
+  size_t print(char c) { return write( static_cast<uint8_t>( c ) ); }
+  size_t print(int value) { return print( static_cast<long>( value ) ); }
+  size_t print(unsigned value) { return print( static_cast<unsigned long>( value ) ); }
+  size_t print(long value) { return printf( "%ld", value ); }
+  size_t print(unsigned long value) { return printf( "%lu", value ); }
+  size_t print(double value, int digits = 2) { return printf( "%.*f", digits, value ); }
+
+  size_t println() { return write( "\r\n" ); }
+  template <typename T> size_t println(T value) { return print( value ) + println(); }
+
+  size_t printf(const char *format, ...) __attribute__(( format( printf, 2, 3 ) ))
+  {
+    char text[256];
+    va_list args;
+    va_start( args, format );
+    int length = vsnprintf( text, sizeof( text ), format, args );
+    va_end( args );
+    return ( 0 < length ? write( text, std::min<size_t>( length, sizeof( text ) - 1 ) ) : 0 );
+  }
+
+  virtual void flush() {}
+};
+
+//-- Stream ----------------------------------------------------------------------------------------
+class Stream : public Print
+{
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  String readStringUntil(char terminator)
+  {
+    std::string text;
+    for ( int c = read(); -1 != c && terminator != c; c = read() ) { text.push_back( static_cast<char>( c ) ); }
+    return String( text );
+  }
+};
+
+//-- EspClass --------------------------------------------------------------------------------------
+// No RTC memory on the host, the records are never found
+class EspClass
+{
+public:
+  void restart() {}
+  bool rtcUserMemoryRead(uint32_t, uint32_t *, size_t) { return false; }
+  bool rtcUserMemoryWrite(uint32_t, uint32_t *, size_t) { return false; }
+  uint32_t random() { return static_cast<uint32_t>( rand() ); }
+};
+
+inline EspClass ESP;
+
+#endif // __ARDUINO_STUB_H__
@@ -0,0 +1,213 @@
+#ifndef __ESP_ASYNC_WEB_SERVER_STUB_H__
+#define __ESP_ASYNC_WEB_SERVER_STUB_H__
+
+#include <Arduino.h>
+#include <FS.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+//-- ESP ASYNC WEB SERVER STUB ---------------------------------------------------------------------
+// The request is built by the test, the response sent to it is kept for the checks. The server
+// dispatches a request like the real one: the registered uris first, then the handlers.
+
+enum WebRequestMethod : uint8_t
+{
+  HTTP_GET     = 0x01,
+  HTTP_POST    = 0x02,
+  HTTP_DELETE  = 0x04,
+  HTTP_PUT     = 0x08,
+  HTTP_PATCH   = 0x10,
+  HTTP_HEAD    = 0x20,
+  HTTP_OPTIONS = 0x40,
+  HTTP_ANY     = 0x7F,
+};
+typedef uint8_t WebRequestMethodComposite;
+
+typedef std::function<size_t(uint8_t *buffer, size_t maxLen, size_t index)> AwsResponseFiller;
+
+//-- AsyncWebHeader, AsyncWebParameter -------------------------------------------------------------
+class AsyncWebHeader
+{
+public:
+  AsyncWebHeader(const String &name, const String &value): m_name(name), m_value(value) {}
+  const String &name() const { return m_name; }
+  const String &value() const { return m_value; }
+
+private:
+  String m_name;
+  String m_value;
+};
+
+class AsyncWebParameter
+{
+public:
+  AsyncWebParameter(const String &name, const String &value, bool isForm): m_name(name), m_value(value), m_isForm(isForm) {}
+  const String &name() const { return m_name; }
+  const String &value() const { return m_value; }
+  bool isPost() const { return m_isForm; }
+
+private:
+  String m_name;
+  String m_value;
+  bool   m_isForm;
+};
+
+//-- AsyncWebServerResponse ------------------------------------------------------------------------
+// content: the text of the response, the file or the output of the filler
+class AsyncWebServerResponse
+{
+public:
+  void addHeader(const String &name, const String &value) { headers.emplace_back( name, value ); }
+
+  const AsyncWebHeader *getHeader(const char *name) const
+  {
+    for ( const AsyncWebHeader &header : headers ) { if ( header.name() == name ) { return &header; } }
+    return nullptr;
+  }
+
+  int         code = 0;
+  String      contentType;
+  std::string content;
+  String      filePath; // of a file response
+  std::vector<AsyncWebHeader> headers;
+};
+
+//-- AsyncWebServerRequest -------------------------------------------------------------------------
+class AsyncWebServerRequest
+{
+public:
+  AsyncWebServerRequest(WebRequestMethodComposite method, const char *url): m_method(method), m_url(url) {}
+
+  //-- for the tests: the request
+  void addParam(const char *name, const char *value, bool isForm = true) { m_params.emplace_back( name, value, isForm ); }
+  void addHeader(const char *name, const char *value) { m_headers.emplace_back( name, value ); }
+  void disconnect() { if ( nullptr != m_onDisconnect ) { m_onDisconnect(); } }
+
+  //-- for the tests: the response, nullptr while the request is not answered
+  const AsyncWebServerResponse *response() const { return m_response.get(); }
+
+  WebRequestMethodComposite method() const { return m_method; }
+  const String &url() const { return m_url; }
+
+  void addInterestingHeader(const String &) {}
+  AsyncWebHeader *getHeader(const String &name)
+  {
+    for ( AsyncWebHeader &header : m_headers ) { if ( header.name() == name ) { return &header; } }
+    return nullptr;
+  }
+  AsyncWebParameter *getParam(const String &name, bool isPost = false, bool = false)
+  {
+    for ( AsyncWebParameter &param : m_params ) { if ( param.name() == name && param.isPost() == isPost ) { return &param; } }
+    return nullptr;
+  }
+
+  void onDisconnect(std::function<void()> onDisconnect) { m_onDisconnect = onDisconnect; }
+
+  AsyncWebServerResponse *beginResponse(int code, const String &contentType = String(), const String &content = String())
+  {
+    AsyncWebServerResponse *response = new AsyncWebServerResponse();
+    response->code        = code;
+    response->contentType = contentType;
+    response->content     = content.c_str();
+    return response;
+  }
+
+  AsyncWebServerResponse *beginResponse(File file, const String &path, const String &contentType = String(), bool = false)
+  {
+    AsyncWebServerResponse *response = beginResponse( 200, contentType );
+    response->filePath = path;
+    for ( int c = file.read(); -1 != c; c = file.read() ) { response->content.push_back( static_cast<char>( c ) ); }
+    file.close();
+    return response;
+  }
+
+  //-- The filler is asked for small pieces, as by the TCP stack
+  AsyncWebServerResponse *beginResponse(const String &contentType, size_t length, AwsResponseFiller filler)
+  {
+    AsyncWebServerResponse *response = beginResponse( 200, contentType );
+    uint8_t buffer[64];
+    while ( response->content.size() < length )
+    {
+      size_t piece = filler( buffer, sizeof( buffer ), response->content.size() );
+      if ( 0 == piece ) { break; }
+      response->content.append( reinterpret_cast<const char *>( buffer ), piece );
+    }
+    return response;
+  }
+
+  void send(AsyncWebServerResponse *response) { m_response.reset( response ); }
+  void send(int code, const String &contentType = String(), const String &content = String())
+  {
+    send( beginResponse( code, contentType, content ) );
+  }
+
+private:
+  WebRequestMethodComposite m_method;
+  String m_url;
+  std::vector<AsyncWebParameter> m_params;
+  std::vector<AsyncWebHeader>    m_headers;
+  std::function<void()>          m_onDisconnect;
+  std::unique_ptr<AsyncWebServerResponse> m_response;
+};
+
+typedef std::function<void(AsyncWebServerRequest *request)> ArRequestHandlerFunction;
+
+//-- AsyncWebHandler -------------------------------------------------------------------------------
+class AsyncWebHandler
+{
+public:
+  virtual ~AsyncWebHandler() {}
+  virtual bool canHandle(AsyncWebServerRequest *) { return false; }
+  virtual void handleRequest(AsyncWebServerRequest *) {}
+  virtual bool isRequestHandlerTrivial() { return true; }
+};
+
+//-- AsyncWebServer --------------------------------------------------------------------------------
+class AsyncWebServer
+{
+public:
+  explicit AsyncWebServer(uint16_t) {}
+
+  void on(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction handler)
+  {
+    m_uriHandlers.push_back( { uri, method, handler } );
+  }
+  AsyncWebHandler &addHandler(AsyncWebHandler *handler) { m_handlers.push_back( handler ); return *handler; }
+
+  //-- for the tests: handles the request as the server does when it has been received
+  void handle(AsyncWebServerRequest *request)
+  {
+    for ( const UriHandler &uriHandler : m_uriHandlers )
+    {
+      if ( request->url() == uriHandler.uri && 0 != ( request->method() & uriHandler.method ) )
+      {
+        uriHandler.handler( request );
+        return;
+      }
+    }
+    for ( AsyncWebHandler *handler : m_handlers )
+    {
+      if ( true == handler->canHandle( request ) )
+      {
+        handler->handleRequest( request );
+        return;
+      }
+    }
+    request->send( 404 );
+  }
+
+private:
+  struct UriHandler
+  {
+    const char *uri;
+    WebRequestMethodComposite method;
+    ArRequestHandlerFunction  handler;
+  };
+
+  std::vector<UriHandler>       m_uriHandlers;
+  std::vector<AsyncWebHandler *> m_handlers;
+};
+
+#endif // __ESP_ASYNC_WEB_SERVER_STUB_H__
@@ -0,0 +1,160 @@
+#ifndef __FS_STUB_H__
+#define __FS_STUB_H__
+
+#include <Arduino.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+//-- FS STUB ---------------------------------------------------------------------------------------
+// The files are kept in memory. As on LittleFS, the written data of a file becomes visible when
+// the file is closed.
+namespace fs
+{
+
+typedef std::map<std::string, std::shared_ptr<std::string>> FileMap;
+
+//-- File ------------------------------------------------------------------------------------------
+class File : public Stream
+{
+public:
+  File() {}
+  File(const std::shared_ptr<std::string> &stored, const std::string &data, size_t position, bool isWritable):
+    m_stored(stored), m_data(data), m_position(position), m_isOpen(true), m_isWritable(isWritable)
+  {}
+
+  operator bool() const { return m_isOpen; }
+
+  using Print::write;
+  size_t write(uint8_t c) override { return write( &c, 1 ); }
+  size_t write(const uint8_t *data, size_t size) override
+  {
+    if ( false == m_isOpen || false == m_isWritable ) { return 0; }
+    m_data.replace( m_position, std::min( size, m_data.size() - m_position ), reinterpret_cast<const char *>( data ), size );
+    m_position += size;
+    return size;
+  }
+
+  size_t read(uint8_t *data, size_t size)
+  {
+    if ( false == m_isOpen ) { return 0; }
+    size_t length = std::min( size, m_data.size() - m_position );
+    memcpy( data, m_data.data() + m_position, length );
+    m_position += length;
+    return length;
+  }
+  int read() override { uint8_t c = 0; return ( 1 == read( &c, 1 ) ? c : -1 ); }
+  int peek() override { return ( m_position < m_data.size() ? static_cast<uint8_t>( m_data[m_position] ) : -1 ); }
+  int available() override { return ( true == m_isOpen ? static_cast<int>( m_data.size() - m_position ) : 0 ); }
+
+  bool seek(uint32_t position)
+  {
+    if ( m_data.size() < position ) { return false; }
+    m_position = position;
+    return true;
+  }
+  size_t position() const { return m_position; }
+  size_t size() const { return m_data.size(); }
+
+  void close()
+  {
+    if ( true == m_isOpen && true == m_isWritable ) { *m_stored = m_data; }
+    m_isOpen = false;
+  }
+
+private:
+  std::shared_ptr<std::string> m_stored;
+  std::string m_data;
+  size_t      m_position   = 0;
+  bool        m_isOpen     = false;
+  bool        m_isWritable = false;
+};
+
+//-- Dir -------------------------------------------------------------------------------------------
+// The files and the subdirectories of a directory, the directories exist while they have files
+class Dir
+{
+public:
+  Dir() {}
+  Dir(const FileMap &files, const std::string &directory)
+  {
+    std::string prefix = directory + ( 0 < directory.size() && '/' == directory.back() ? "" : "/" );
+    for ( const FileMap::value_type &file : files )
+    {
+      if ( 0 != file.first.compare( 0, prefix.size(), prefix ) ) { continue; }
+
+      std::string name = file.first.substr( prefix.size() );
+      size_t separator = name.find( '/' );
+      Entry entry = { name.substr( 0, separator ), std::string::npos != separator, file.second->size() };
+      if ( true == m_entries.empty() || m_entries.back().name != entry.name ) { m_entries.push_back( entry ); }
+    }
+  }
+
+  bool next() { return ++m_index < static_cast<int>( m_entries.size() ); }
+  String fileName() const { return String( m_entries[m_index].name ); }
+  bool isDirectory() const { return m_entries[m_index].isDirectory; }
+  size_t fileSize() const { return ( true == m_entries[m_index].isDirectory ? 0 : m_entries[m_index].size ); }
+
+private:
+  struct Entry
+  {
+    std::string name;
+    bool        isDirectory;
+    size_t      size;
+  };
+
+  std::vector<Entry> m_entries;
+  int m_index = -1;
+};
+
+//-- FS --------------------------------------------------------------------------------------------
+// Modes: "r", "w" (truncates), "a" (appends), a missing file is created by "w" and "a"
+class FS
+{
+public:
+  bool begin() { return true; }
+  void end() {}
+
+  File open(const char *path, const char *mode)
+  {
+    FileMap::iterator file = m_files.find( path );
+    if ( 'r' == mode[0] )
+    {
+      return ( m_files.end() == file ? File() : File( file->second, *file->second, 0, false ) );
+    }
+    if ( m_files.end() == file ) { file = m_files.emplace( path, std::make_shared<std::string>() ).first; }
+
+    std::string data = ( 'a' == mode[0] ? *file->second : std::string() );
+    return File( file->second, data, data.size(), true );
+  }
+
+  Dir openDir(const char *path) const { return Dir( m_files, path ); }
+  Dir openDir(const String &path) const { return openDir( path.c_str() ); }
+
+  bool exists(const char *path) const { return 0 < m_files.count( path ); }
+  bool remove(const char *path) { return 0 < m_files.erase( path ); }
+  bool rename(const char *from, const char *to)
+  {
+    FileMap::iterator file = m_files.find( from );
+    if ( m_files.end() == file ) { return false; }
+    m_files[to] = file->second;
+    m_files.erase( file );
+    return true;
+  }
+
+  //-- format: the tests start from an empty file system
+  bool format() { m_files.clear(); return true; }
+
+private:
+  FileMap m_files;
+};
+
+}; // namespace
+
+using fs::Dir;
+using fs::File;
+using fs::FS;
+
+#endif // __FS_STUB_H__
@@ -0,0 +1,11 @@
+#ifndef __GSI_DEBUG_STUB_H__
+#define __GSI_DEBUG_STUB_H__
+
+//-- GSI DEBUG STUB --------------------------------------------------------------------------------
+// The debug log of the firmware is off in the native tests
+
+#define SERIAL_PF( ... )
+#define SERIAL_PLN( ... )
+#define SERIAL_P( ... )
+
+#endif // __GSI_DEBUG_STUB_H__
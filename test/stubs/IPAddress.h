@@ -0,0 +1,23 @@
+#ifndef __IP_ADDRESS_STUB_H__
+#define __IP_ADDRESS_STUB_H__
+
+#include <Arduino.h>
+
+//-- IP ADDRESS STUB -------------------------------------------------------------------------------
+// IPv4 only, stored in network byte order like the ESP8266 core
+class IPAddress
+{
+public:
+  IPAddress() {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d): m_address(a | b << 8 | c << 16 | static_cast<uint32_t>( d ) << 24) {}
+  explicit IPAddress(uint32_t address): m_address(address) {}
+
+  operator uint32_t() const { return m_address; }
+  bool operator==(const IPAddress &address) const { return m_address == address.m_address; }
+  bool operator!=(const IPAddress &address) const { return m_address != address.m_address; }
+
+private:
+  uint32_t m_address = 0;
+};
+
+#endif // __IP_ADDRESS_STUB_H__
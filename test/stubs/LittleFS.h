@@ -0,0 +1,8 @@
+#ifndef __LITTLE_FS_STUB_H__
+#define __LITTLE_FS_STUB_H__
+
+#include <FS.h>
+
+inline fs::FS LittleFS;
+
+#endif // __LITTLE_FS_STUB_H__
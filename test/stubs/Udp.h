@@ -0,0 +1,27 @@
+#ifndef __UDP_STUB_H__
+#define __UDP_STUB_H__
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+//-- UDP STUB --------------------------------------------------------------------------------------
+// The interface of the ESP8266 core, the tests implement it
+class UDP : public Stream
+{
+public:
+  virtual uint8_t begin(uint16_t port) = 0;
+  virtual void stop() = 0;
+
+  virtual int beginPacket(IPAddress ip, uint16_t port) = 0;
+  virtual int endPacket() = 0;
+
+  virtual int parsePacket() = 0;
+  virtual int read(unsigned char *buffer, size_t size) = 0;
+  int read(char *buffer, size_t size) { return read( reinterpret_cast<unsigned char *>( buffer ), size ); }
+  using Stream::read;
+
+  virtual IPAddress remoteIP() = 0;
+  virtual uint16_t remotePort() = 0;
+};
+
+#endif // __UDP_STUB_H__
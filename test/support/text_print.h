@@ -0,0 +1,30 @@
+#ifndef __TEXT_PRINT_H__
+#define __TEXT_PRINT_H__
+
+#include <Arduino.h>
+
+#include <string>
+
+//-- TextPrint -------------------------------------------------------------------------------------
+// Collects the printed bytes, the tests compare them with the expected text
+class TextPrint : public Print
+{
+public:
+  using Print::write;
+  size_t write(uint8_t c) override { m_text.push_back( static_cast<char>( c ) ); return 1; }
+  size_t write(const uint8_t *data, size_t size) override
+  {
+    m_text.append( reinterpret_cast<const char *>( data ), size );
+    return size;
+  }
+
+  const char *c_str() const { return m_text.c_str(); }
+  const std::string &text() const { return m_text; }
+  size_t length() const { return m_text.size(); }
+  void clear() { m_text.clear(); }
+
+private:
+  std::string m_text;
+};
+
+#endif // __TEXT_PRINT_H__
@@ -0,0 +1,113 @@
+#include <unity.h>
+
+#include <stdio.h>
+
+#include "battery_governor.h"
+
+using namespace sensor;
+
+struct CadenceCase
+{
+  const char *name;
+  int16_t     battery;
+  uint16_t    uploadFreq;
+  uint8_t     lowLevel;
+  uint8_t     criticalLevel;
+  bool        wasSensorOnly;
+  CadenceMode mode;
+  uint32_t    interval;
+};
+
+void checkCadence(const CadenceCase *cases, size_t count)
+{
+  for ( size_t i = 0; i < count; ++i )
+  {
+    const CadenceCase &c = cases[i];
+    Cadence cadence = planCadence( c.battery, c.uploadFreq, c.lowLevel, c.criticalLevel, c.wasSensorOnly );
+
+    char message[96];
+    snprintf( message, sizeof( message ), "%s: battery %d%%", c.name, c.battery );
+    TEST_ASSERT_EQUAL_INT_MESSAGE( c.mode, cadence.mode, message );
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE( c.interval, cadence.interval, message );
+  }
+}
+
+void setUp() {}
+void tearDown() {}
+
+//-- THRESHOLDS ------------------------------------------------------------------------------------
+// upload_freq 180 s, low 30 %, critical 10 %: the interval grows by 1260 s / 20 % = 63 s per %
+void test_thresholds()
+{
+  const CadenceCase cases[] =
+  {
+    { "governor off",          5,  180,  0,  0, false, CADENCE_NORMAL,       180 },
+    { "governor off",         -1,  180,  0, 10, true,  CADENCE_NORMAL,       180 },
+    { "full",                100,  180, 30, 10, false, CADENCE_NORMAL,       180 },
+    { "at the low level",     30,  180, 30, 10, false, CADENCE_NORMAL,       180 },
+    { "below the low level",  29,  180, 30, 10, false, CADENCE_SAVER,        243 },
+    { "half way",             20,  180, 30, 10, false, CADENCE_SAVER,        810 },
+    { "above critical",       11,  180, 30, 10, false, CADENCE_SAVER,       1377 },
+    { "at critical",          10,  180, 30, 10, false, CADENCE_SENSOR_ONLY, 1440 },
+    { "below critical",        3,  180, 30, 10, false, CADENCE_SENSOR_ONLY, 1440 },
+    { "empty",                 0,  180, 30, 10, false, CADENCE_SENSOR_ONLY, 1440 },
+    { "no battery reading",   -1,  180, 30, 10, false, CADENCE_SENSOR_ONLY, 1440 },
+  };
+  checkCadence( cases, sizeof( cases ) / sizeof( cases[0] ) );
+}
+
+// The sensor-only mode is left at the critical level plus GOVERNOR_HYSTERESIS only
+void test_hysteresis()
+{
+  const CadenceCase cases[] =
+  {
+    { "still sensor-only",    10,  180, 30, 10, true,  CADENCE_SENSOR_ONLY, 1440 },
+    { "still sensor-only",    12,  180, 30, 10, true,  CADENCE_SENSOR_ONLY, 1440 },
+    { "at the hysteresis",    13,  180, 30, 10, true,  CADENCE_SENSOR_ONLY, 1440 },
+    { "above the hysteresis", 14,  180, 30, 10, true,  CADENCE_SAVER,       1188 },
+    { "entering from saver",  12,  180, 30, 10, false, CADENCE_SAVER,       1314 },
+    { "not below low",        30,  180, 30, 10, true,  CADENCE_NORMAL,       180 },
+  };
+  checkCadence( cases, sizeof( cases ) / sizeof( cases[0] ) );
+}
+
+// Equal or inverted levels: there is no saver range, below the low level the radio is off
+void test_critical_not_below_low()
+{
+  const CadenceCase cases[] =
+  {
+    { "equal levels",         20,  180, 20, 20, false, CADENCE_NORMAL,       180 },
+    { "equal levels",         19,  180, 20, 20, false, CADENCE_SENSOR_ONLY, 1440 },
+    { "inverted levels",      25,  180, 20, 30, false, CADENCE_NORMAL,       180 },
+    { "inverted levels",      19,  180, 20, 30, false, CADENCE_SENSOR_ONLY, 1440 },
+  };
+  checkCadence( cases, sizeof( cases ) / sizeof( cases[0] ) );
+}
+
+//-- INTERVAL CLAMPING -----------------------------------------------------------------------------
+// At most GOVERNOR_MAX_INTERVAL, but never below upload_freq
+void test_interval_clamping()
+{
+  const CadenceCase cases[] =
+  {
+    { "stretch below max",   20, 1350, 30, 10, false, CADENCE_SAVER,       6075 },
+    { "stretch at max",      10, 1350, 30, 10, false, CADENCE_SENSOR_ONLY, GOVERNOR_MAX_INTERVAL },
+    { "stretch over max",    10, 3600, 30, 10, false, CADENCE_SENSOR_ONLY, GOVERNOR_MAX_INTERVAL },
+    { "stretch over max",    20, 3600, 30, 10, false, CADENCE_SAVER,       7200 },
+    { "freq over max",       29, 14400, 30, 10, false, CADENCE_SAVER,      14400 },
+    { "freq over max",       10, 14400, 30, 10, false, CADENCE_SENSOR_ONLY, 14400 },
+    { "max freq",            10, 65535, 30, 10, false, CADENCE_SENSOR_ONLY, 65535 },
+    { "zero freq",           20,    0, 30, 10, false, CADENCE_SAVER,          0 },
+  };
+  checkCadence( cases, sizeof( cases ) / sizeof( cases[0] ) );
+}
+
+int main(int, char **)
+{
+  UNITY_BEGIN();
+  RUN_TEST( test_thresholds );
+  RUN_TEST( test_hysteresis );
+  RUN_TEST( test_critical_not_below_low );
+  RUN_TEST( test_interval_clamping );
+  return UNITY_END();
+}
@@ -0,0 +1,367 @@
+#include <unity.h>
+
+#include <chrono>
+#include <string>
+
+#include <LittleFS.h>
+
+#include "config_schema.h"
+#include "sensor_config_file_management.h"
+#include "sensor_ini_file_storage.h"
+#include "text_print.h"
+
+using namespace sensor;
+
+// data/sensor_config.ini, the line ends of the Windows editors included
+const char INI_TEXT[] =
+  "[network]\r\n"
+  "wifi_enabled=true\r\n"
+  "wifi_ap_ssid=MyNetwork\r\n"
+  "wifi_ap_pwd=secret pass\r\n"
+  "wifi_ap_bssid=01-23-45-67-89-ab\r\n"
+  "wifi_ap_channel=6\r\n"
+  "wifi_con_delay=150\r\n"
+  "wifi_max_con_attempts=240\r\n"
+  "[data upload]\n"
+  "upload_freq=180\n"
+  "upload_timeout=20\n"
+  "device_id=TSH05\n"
+  "location=usHallway\n"
+  "data_measurement_org=mine\n"
+  "data_measurement_bucket=ts_bucket\n"
+  "data_measurement_name=devThermoSensor\n"
+  "batch_size=4\n"
+  "temp_deadband=0.25\n"
+  "hum_deadband=1.50\n"
+  "max_silent_wakes=10\n"
+  "history_enabled=false\n"
+  "backlog_drain_max=60\n"
+  "[server config]\n"
+  "server_address=eu-central-1-1.aws.cloud2.influxdata.com\n"
+  "server_port=443\n"
+  "server_auth_token=token\n"
+  "tls_profile=1\n"
+  "gzip_min_size=512\n"
+  "server_transport=0\n"
+  "; a comment\n"
+  "[display]\n"
+  "display_contrast=137\n"
+  "display_rotation=false\n"
+  "[sensor]\n"
+  "sensor_temp_correction=-1.5\n"
+  "sensor_telemetry_interval=1000\n"
+  "[battery]\n"
+  "battery_min_level=527\n"
+  "battery_max_level=856\n"
+  "battery_low_level=30\n"
+  "battery_critical_level=10"; // no new line at the end
+
+void writeTextFile(const char *path, const std::string &text)
+{
+  File file = LittleFS.open( path, "w" );
+  file.write( text.c_str(), text.size() );
+  file.close();
+}
+
+//-- replaceIniLine: the line of the key gets the new text, an empty text removes it
+std::string replaceIniLine(const char *key, const char *line)
+{
+  std::string text = INI_TEXT;
+  size_t start = text.find( std::string( "\n" ) + key + "=" ) + 1;
+  size_t end   = text.find( '\n', start );
+  text.replace( start, ( std::string::npos == end ? text.size() : end + 1 ) - start, line );
+  return text;
+}
+
+void setUp() { LittleFS.format(); }
+void tearDown() {}
+
+//-- findConfigField -------------------------------------------------------------------------------
+void test_find_config_field_every_key()
+{
+  for ( uint8_t i = 0; i < CONFIG_FIELD_COUNT; ++i )
+  {
+    const ConfigField &field = CONFIG_FIELDS[i];
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE( hashConfigKey( hashConfigName( field.section ), field.key ), field.hash, field.key );
+    TEST_ASSERT_EQUAL_INT_MESSAGE( i, findConfigField( field.hash ), field.key );
+  }
+}
+
+void test_find_config_field_unknown_key()
+{
+  TEST_ASSERT_EQUAL( -1, findConfigField( hashConfigKey( hashConfigName( INI_NET_SECTION ), "no_such_key" ) ) );
+  // A key is known in its own section only
+  TEST_ASSERT_EQUAL( -1, findConfigField( hashConfigKey( hashConfigName( INI_DATA_SECTION ), INI_NET_WIFI_ENABLED ) ) );
+  TEST_ASSERT_EQUAL( -1, findConfigField( 0 ) );
+}
+
+//-- parseConfigValue ------------------------------------------------------------------------------
+void test_parse_config_value()
+{
+  struct { const char *key; const char *text; bool isValid; } cases[] =
+  {
+    { INI_NET_WIFI_ENABLED,          "yes",                       true },
+    { INI_NET_WIFI_ENABLED,          "maybe",                     false },
+    { INI_NET_WIFI_AP_SSID,          "12345678901234567890123456789012",  true },  // 32 characters
+    { INI_NET_WIFI_AP_SSID,          "123456789012345678901234567890123", false },
+    { INI_NET_WIFI_AP_BSSID,         "01:23:45:67:89:AB",         true },
+    { INI_NET_WIFI_AP_BSSID,         "01-23-45-67-89",            false },
+    { INI_NET_WIFI_AP_BSSID,         "01-23-45-67-89-ab-cd",      false },
+    { INI_NET_WIFI_AP_BSSID,         "01-23-45-67-89-1ab",        false },
+    { INI_NET_WIFI_AP_CHANNEL,       "14",                        true },
+    { INI_NET_WIFI_AP_CHANNEL,       "15",                        false },
+    { INI_NET_WIFI_MAX_CON_ATTEMPTS, "0",                         false },  // range 1 - 1000
+    { INI_NET_WIFI_MAX_CON_ATTEMPTS, "12x",                       false },
+    { INI_NET_WIFI_MAX_CON_ATTEMPTS, "",                          false },
+    { INI_SENSOR_TEMP_CORRECTION,    "-20",                       true },
+    { INI_SENSOR_TEMP_CORRECTION,    "20.5",                      false },
+  };
+
+  for ( const auto &c : cases )
+  {
+    const ConfigField *field = NULL;
+    for ( uint8_t i = 0; i < CONFIG_FIELD_COUNT; ++i )
+    {
+      if ( 0 == strcmp( c.key, CONFIG_FIELDS[i].key ) ) { field = &CONFIG_FIELDS[i]; }
+    }
+    TEST_ASSERT_NOT_NULL( field );
+
+    SensorIniFileStorage storage;
+    SensorIniFileStorage unchanged;
+    bool isValid = parseConfigValue( *field, c.text, storage );
+    TEST_ASSERT_EQUAL_MESSAGE( c.isValid, isValid, c.text );
+    // A rejected value leaves the field as it was
+    if ( false == isValid ) { TEST_ASSERT_EQUAL_MEMORY( &unchanged, &storage, sizeof( storage ) ); }
+  }
+}
+
+//-- printConfigValue ------------------------------------------------------------------------------
+// Every field is read back as it was printed
+void test_print_parse_round_trip()
+{
+  writeTextFile( INI_FILENAME, INI_TEXT );
+  SensorIniFileStorage storage;
+  TEST_ASSERT_TRUE( SensorConfigFile().readIniFile( storage ) );
+
+  SensorIniFileStorage parsed;
+  for ( uint8_t i = 0; i < CONFIG_FIELD_COUNT; ++i )
+  {
+    const ConfigField &field = CONFIG_FIELDS[i];
+    TextPrint text;
+    printConfigValue( text, field, storage );
+    TEST_ASSERT_TRUE_MESSAGE( parseConfigValue( field, text.c_str(), parsed ), field.key );
+
+    const uint8_t *value = reinterpret_cast<const uint8_t *>( &storage ) + field.offset;
+    const uint8_t *parsedValue = reinterpret_cast<const uint8_t *>( &parsed ) + field.offset;
+    TEST_ASSERT_EQUAL_MEMORY( value, parsedValue, field.size );
+  }
+}
+
+//-- readIniFile -----------------------------------------------------------------------------------
+void test_read_ini_file()
+{
+  writeTextFile( INI_FILENAME, INI_TEXT );
+  SensorIniFileStorage storage;
+  TEST_ASSERT_TRUE( SensorConfigFile().readIniFile( storage ) );
+
+  TEST_ASSERT_TRUE( storage.wifi_enabled );
+  TEST_ASSERT_EQUAL_STRING( "MyNetwork", storage.wifi_ap_ssid );
+  TEST_ASSERT_EQUAL_STRING( "secret pass", storage.wifi_ap_pwd );
+  const uint8_t bssid[6] = { 0x01, 0x23, 0x45, 0x67, 0x89, 0xab };
+  TEST_ASSERT_EQUAL_MEMORY( bssid, storage.wifi_ap_bssid, sizeof( bssid ) );
+  TEST_ASSERT_EQUAL( 6, storage.wifi_ap_channel );
+  TEST_ASSERT_EQUAL( 4, storage.batch_size );
+  TEST_ASSERT_TRUE( 0.25f == storage.temp_deadband );
+  TEST_ASSERT_EQUAL_STRING( "eu-central-1-1.aws.cloud2.influxdata.com", storage.server_address );
+  TEST_ASSERT_EQUAL( 443, storage.server_port );
+  TEST_ASSERT_EQUAL( 137, storage.display_contrast );
+  TEST_ASSERT_TRUE( -1.5f == storage.sensor_temp_correction );
+  TEST_ASSERT_EQUAL( 10, storage.batteryCriticalLevel ); // the last line, without a new line
+}
+
+void test_read_ini_file_optional_key_missing()
+{
+  writeTextFile( INI_FILENAME, replaceIniLine( INI_DATA_MAX_SILENT_WAKES, "" ) );
+  SensorIniFileStorage storage;
+  TEST_ASSERT_TRUE( SensorConfigFile().readIniFile( storage ) );
+  TEST_ASSERT_EQUAL( SensorIniFileStorage().max_silent_wakes, storage.max_silent_wakes );
+}
+
+// One pass: the problems do not stop the parser, the valid keys after them are stored
+void test_read_ini_file_problems()
+{
+  const char *lines[] =
+  {
+    "",                                 // a required key is missing
+    "upload_timeout=256\n",             // out of range
+    "upload_timeout\n",                 // no value: missing
+  };
+
+  for ( const char *line : lines )
+  {
+    writeTextFile( INI_FILENAME, replaceIniLine( INI_DATA_UPLOAD_TIMEOUT, line ) );
+    SensorIniFileStorage storage;
+    TEST_ASSERT_FALSE_MESSAGE( SensorConfigFile().readIniFile( storage ), line );
+    TEST_ASSERT_EQUAL_STRING( "TSH05", storage.device_id );
+    TEST_ASSERT_EQUAL( 856, storage.batteryMaxLevel );
+  }
+}
+
+void test_read_ini_file_truncated_line()
+{
+  std::string line = std::string( INI_SERVER_AUTH_TOKEN ) + "=" + std::string( 400, 'x' ) + "\n";
+  writeTextFile( INI_FILENAME, replaceIniLine( INI_SERVER_AUTH_TOKEN, line.c_str() ) );
+  SensorIniFileStorage storage;
+  TEST_ASSERT_FALSE( SensorConfigFile().readIniFile( storage ) );
+  TEST_ASSERT_EQUAL( 0, storage.server_auth_token[0] );
+  TEST_ASSERT_EQUAL( 1, storage.tls_profile ); // the line after it
+}
+
+void test_read_ini_file_missing()
+{
+  SensorIniFileStorage storage;
+  TEST_ASSERT_FALSE( SensorConfigFile().readIniFile( storage ) );
+}
+
+//-- writeIniFile ----------------------------------------------------------------------------------
+void test_write_read_ini_file()
+{
+  writeTextFile( INI_FILENAME, INI_TEXT );
+  SensorIniFileStorage storage;
+  TEST_ASSERT_TRUE( SensorConfigFile().readIniFile( storage ) );
+  storage.upload_freq = 600;
+  strncpy( storage.location, "attic", sizeof( storage.location ) ); // zero padded, the fields are compared as bytes
+  TEST_ASSERT_TRUE( SensorConfigFile::writeIniFile( storage ) );
+  TEST_ASSERT_FALSE( LittleFS.exists( INI_FILENAME_BACKUP ) );
+
+  SensorIniFileStorage written;
+  TEST_ASSERT_TRUE( SensorConfigFile().readIniFile( written ) );
+  for ( uint8_t i = 0; i < CONFIG_FIELD_COUNT; ++i )
+  {
+    const ConfigField &field = CONFIG_FIELDS[i];
+    const uint8_t *value = reinterpret_cast<const uint8_t *>( &storage ) + field.offset;
+    const uint8_t *writtenValue = reinterpret_cast<const uint8_t *>( &written ) + field.offset;
+    TEST_ASSERT_TRUE_MESSAGE( 0 == memcmp( value, writtenValue, field.size ), field.key );
+  }
+}
+
+// The journal is removed with the new ini file only, a failed write keeps its changes
+void test_write_ini_file_keeps_journal_on_failure()
+{
+  writeTextFile( INI_FILENAME, INI_TEXT );
+  SensorIniFileStorage storage;
+  TEST_ASSERT_TRUE( SensorConfigFile().readIniFile( storage ) );
+  storage.wifi_ap_channel = 11;
+  TEST_ASSERT_TRUE( SensorConfigFile::saveChanges( storage, CONFIG_FIELD_MASK( wifi_ap_channel ) ) );
+
+  LittleFS.remove( INI_FILENAME ); // the back-up cannot be made
+  TEST_ASSERT_FALSE( SensorConfigFile::writeIniFile( storage ) );
+  TEST_ASSERT_TRUE( LittleFS.exists( INI_JOURNAL_FILENAME ) );
+
+  writeTextFile( INI_FILENAME, INI_TEXT );
+  TEST_ASSERT_TRUE( SensorConfigFile::writeIniFile( storage ) );
+  TEST_ASSERT_FALSE( LittleFS.exists( INI_JOURNAL_FILENAME ) );
+
+  SensorIniFileStorage written;
+  TEST_ASSERT_TRUE( SensorConfigFile().readIniFile( written ) );
+  TEST_ASSERT_EQUAL( 11, written.wifi_ap_channel );
+}
+
+//-- BENCHMARK -------------------------------------------------------------------------------------
+// The single pass of readIniFile against a lookup per key, which scans the file from its start
+// for every key as SPIFFSIniFile::getValue did
+const uint32_t BENCHMARK_ROUNDS = 2000;
+
+bool scanIniValue(const char *section, const char *key, char *value, size_t size)
+{
+  File iniFile = LittleFS.open( INI_FILENAME, "r" );
+  bool isInSection = false;
+  char line[320];
+  size_t length = 0;
+  int c = 0;
+  while ( -1 != c )
+  {
+    c = iniFile.read();
+    if ( -1 != c && '\n' != c )
+    {
+      if ( sizeof( line ) - 1 > length ) { line[length++] = static_cast<char>( c ); }
+      continue;
+    }
+    while ( 0 < length && '\r' == line[length - 1] ) { --length; }
+    line[length] = 0;
+    length = 0;
+
+    if ( '[' == line[0] )
+    {
+      char *end = strchr( line, ']' );
+      if ( NULL != end ) { *end = 0; }
+      isInSection = ( 0 == strcmp( line + 1, section ) );
+      continue;
+    }
+    char *separator = strchr( line, '=' );
+    if ( true == isInSection && NULL != separator )
+    {
+      *separator = 0;
+      if ( 0 == strcmp( line, key ) )
+      {
+        snprintf( value, size, "%s", separator + 1 );
+        iniFile.close();
+        return true;
+      }
+    }
+  }
+  iniFile.close();
+  return false;
+}
+
+void test_benchmark_against_scan_per_key()
+{
+  typedef std::chrono::steady_clock Clock;
+  writeTextFile( INI_FILENAME, INI_TEXT );
+
+  Clock::time_point start = Clock::now();
+  for ( uint32_t round = 0; round < BENCHMARK_ROUNDS; ++round )
+  {
+    SensorIniFileStorage storage;
+    for ( uint8_t i = 0; i < CONFIG_FIELD_COUNT; ++i )
+    {
+      char value[256];
+      if ( true == scanIniValue( CONFIG_FIELDS[i].section, CONFIG_FIELDS[i].key, value, sizeof( value ) ) )
+      {
+        parseConfigValue( CONFIG_FIELDS[i], value, storage );
+      }
+    }
+  }
+  double scanTime = std::chrono::duration<double, std::micro>( Clock::now() - start ).count();
+
+  start = Clock::now();
+  for ( uint32_t round = 0; round < BENCHMARK_ROUNDS; ++round )
+  {
+    SensorIniFileStorage storage;
+    TEST_ASSERT_TRUE( SensorConfigFile().readIniFile( storage ) );
+  }
+  double passTime = std::chrono::duration<double, std::micro>( Clock::now() - start ).count();
+
+  char message[128];
+  snprintf( message, sizeof( message ), "scan per key: %.1f us/file, single pass: %.1f us/file (%.1fx)",
+            scanTime / BENCHMARK_ROUNDS, passTime / BENCHMARK_ROUNDS, scanTime / passTime );
+  TEST_MESSAGE( message );
+}
+
+int main(int, char **)
+{
+  UNITY_BEGIN();
+  RUN_TEST( test_find_config_field_every_key );
+  RUN_TEST( test_find_config_field_unknown_key );
+  RUN_TEST( test_parse_config_value );
+  RUN_TEST( test_print_parse_round_trip );
+  RUN_TEST( test_read_ini_file );
+  RUN_TEST( test_read_ini_file_optional_key_missing );
+  RUN_TEST( test_read_ini_file_problems );
+  RUN_TEST( test_read_ini_file_truncated_line );
+  RUN_TEST( test_read_ini_file_missing );
+  RUN_TEST( test_write_read_ini_file );
+  RUN_TEST( test_write_ini_file_keeps_journal_on_failure );
+  RUN_TEST( test_benchmark_against_scan_per_key );
+  return UNITY_END();
+}
@@ -0,0 +1,223 @@
+#include <unity.h>
+
+#include <string>
+#include <vector>
+
+#include "http_request_writer.h"
+#include "text_print.h"
+
+using namespace sensor;
+
+//-- ClientPrint -----------------------------------------------------------------------------------
+// Stands in for the TLS client: records the size of every write(), as every write is a TLS record.
+// A client with failAfter set accepts that many bytes only.
+class ClientPrint : public TextPrint
+{
+public:
+  using Print::write;
+  size_t write(const uint8_t *data, size_t size) override
+  {
+    m_writes.push_back( size );
+    size_t accepted = std::min( size, m_failAfter - std::min( m_failAfter, length() ) );
+    return TextPrint::write( data, accepted );
+  }
+
+  std::vector<size_t> m_writes;
+  size_t              m_failAfter = SIZE_MAX;
+};
+
+//-- Body ------------------------------------------------------------------------------------------
+struct Body
+{
+  size_t lineCount;
+  mutable uint8_t printCount;
+};
+
+void printBody(Print &out, const void *context)
+{
+  const Body *body = static_cast<const Body *>( context );
+  ++body->printCount;
+  for ( size_t i = 0; i < body->lineCount; ++i ) { out.printf( "sensor,deviceId=TSH05 temperature=%u.25\n", static_cast<unsigned>( i ) ); }
+}
+
+std::string expectedBody(size_t lineCount)
+{
+  TextPrint text;
+  Body body = { lineCount, 0 };
+  printBody( text, &body );
+  return text.c_str();
+}
+
+HttpRequestHeader makeHeader()
+{
+  HttpRequestHeader header;
+  header.build( "eu-central-1-1.aws.cloud2.influxdata.com", "/api/v2/write?precision=s", "mine", "ts_bucket", "token" );
+  return header;
+}
+
+//-- decodeChunks: the body of a chunked request, false if the framing is broken
+bool decodeChunks(const std::string &chunks, size_t position, std::string &body)
+{
+  while ( true )
+  {
+    size_t lineEnd = chunks.find( "\r\n", position );
+    if ( std::string::npos == lineEnd || lineEnd == position ) { return false; }
+    size_t size = std::stoul( chunks.substr( position, lineEnd - position ), nullptr, 16 );
+    position = lineEnd + 2;
+    if ( 0 == size ) { return chunks.size() == position + 2 && 0 == chunks.compare( position, 2, "\r\n" ); }
+
+    if ( chunks.size() < position + size + 2 || 0 != chunks.compare( position + size, 2, "\r\n" ) ) { return false; }
+    body.append( chunks, position, size );
+    position += size + 2;
+  }
+}
+
+void setUp() {}
+void tearDown() {}
+
+//-- HttpRequestHeader -----------------------------------------------------------------------------
+void test_header_build()
+{
+  HttpRequestHeader header = makeHeader();
+  TEST_ASSERT_TRUE( header.isBuilt() );
+  TEST_ASSERT_EQUAL_STRING( "POST /api/v2/write?precision=s&org=mine&bucket=ts_bucket HTTP/1.1\r\n"
+                            "Host: eu-central-1-1.aws.cloud2.influxdata.com\r\n"
+                            "User-Agent: ESP8266 Sensor Agent\r\n"
+                            "Connection: close\r\n"
+                            "Authorization: Token token\r\n", header.c_str() );
+  TEST_ASSERT_EQUAL( strlen( header.c_str() ), header.length() );
+}
+
+void test_header_too_long()
+{
+  std::string token( HTTP_HEADER_MAX_LENGTH, 'x' );
+  HttpRequestHeader header;
+  TEST_ASSERT_FALSE( header.build( "server", "/api/v2/write?precision=s", "mine", "ts_bucket", token.c_str() ) );
+  TEST_ASSERT_FALSE( header.isBuilt() );
+}
+
+//-- writePost -------------------------------------------------------------------------------------
+void test_write_post()
+{
+  ClientPrint client;
+  HttpRequestWriter writer( client );
+  HttpRequestHeader header = makeHeader();
+  Body body = { 200, 0 }; // about 8 KB, many TLS records
+
+  size_t sent = writer.writePost( header, printBody, &body );
+
+  TEST_ASSERT_EQUAL( client.length(), sent );
+  TEST_ASSERT_EQUAL( 2, body.printCount ); // the length first, then the data
+  for ( size_t size : client.m_writes ) { TEST_ASSERT_LESS_OR_EQUAL( HTTP_WRITE_CHUNK_SIZE, size ); }
+
+  std::string request = client.c_str();
+  std::string content = expectedBody( 200 );
+  std::string lengthHeader = "Content-Length: " + std::to_string( content.size() ) + "\r\n\r\n";
+  TEST_ASSERT_EQUAL_STRING( ( std::string( header.c_str() ) + lengthHeader + content ).c_str(), request.c_str() );
+}
+
+void test_write_post_client_fails()
+{
+  ClientPrint client;
+  client.m_failAfter = 1000;
+  HttpRequestWriter writer( client );
+  Body body = { 200, 0 };
+
+  TEST_ASSERT_EQUAL( 0, writer.writePost( makeHeader(), printBody, &body ) );
+  TEST_ASSERT_EQUAL( 1000, client.length() );
+  // Nothing is sent after the failed write
+  TEST_ASSERT_LESS_OR_EQUAL( 3, client.m_writes.size() );
+}
+
+//-- writePostChunked ------------------------------------------------------------------------------
+void test_write_post_chunked()
+{
+  ClientPrint client;
+  HttpRequestWriter writer( client );
+  HttpRequestHeader header = makeHeader();
+  Body body = { 200, 0 };
+
+  size_t sent = writer.writePostChunked( header, printBody, &body );
+
+  TEST_ASSERT_EQUAL( client.length(), sent );
+  TEST_ASSERT_EQUAL( 1, body.printCount );
+  for ( size_t size : client.m_writes ) { TEST_ASSERT_LESS_OR_EQUAL( HTTP_WRITE_CHUNK_SIZE, size ); }
+
+  std::string head = std::string( header.c_str() ) + "Transfer-Encoding: chunked\r\n\r\n";
+  TEST_ASSERT_EQUAL_STRING_LEN( head.c_str(), client.c_str(), head.size() );
+
+  std::string content;
+  TEST_ASSERT_TRUE( decodeChunks( client.text(), head.size(), content ) );
+  TEST_ASSERT_EQUAL_STRING( expectedBody( 200 ).c_str(), content.c_str() );
+}
+
+void test_write_post_chunked_empty_body()
+{
+  ClientPrint client;
+  HttpRequestWriter writer( client );
+  HttpRequestHeader header = makeHeader();
+  Body body = { 0, 0 };
+
+  writer.writePostChunked( header, printBody, &body );
+
+  std::string request = std::string( header.c_str() ) + "Transfer-Encoding: chunked\r\n\r\n0\r\n\r\n";
+  TEST_ASSERT_EQUAL_STRING( request.c_str(), client.c_str() );
+}
+
+void test_write_post_chunked_compressed()
+{
+  ClientPrint client;
+  HttpRequestWriter writer( client );
+  HttpRequestHeader header = makeHeader();
+  Body body = { 200, 0 };
+
+  writer.writePostChunked( header, printBody, &body, true );
+
+  std::string head = std::string( header.c_str() ) + "Content-Encoding: gzip\r\nTransfer-Encoding: chunked\r\n\r\n";
+  TEST_ASSERT_EQUAL_STRING_LEN( head.c_str(), client.c_str(), head.size() );
+
+  std::string content;
+  TEST_ASSERT_TRUE( decodeChunks( client.text(), head.size(), content ) );
+  TEST_ASSERT_TRUE( 10 < content.size() );
+  TEST_ASSERT_EQUAL( 0x1f, static_cast<uint8_t>( content[0] ) ); // gzip magic
+  TEST_ASSERT_EQUAL( 0x8b, static_cast<uint8_t>( content[1] ) );
+  TEST_ASSERT_TRUE( content.size() < expectedBody( 200 ).size() / 2 );
+}
+
+//-- parseHttpDate ---------------------------------------------------------------------------------
+void test_parse_http_date()
+{
+  struct { const char *text; bool isValid; uint32_t epoch; } cases[] =
+  {
+    { "Sun, 06 Nov 1994 08:49:37 GMT", true,  784111777 },
+    { "Thu, 01 Jan 1970 00:00:00 GMT", true,  0 },
+    { "Thu, 29 Feb 2024 23:59:59 GMT", true,  1709251199 },
+    { "Sat, 18 Oct 2026 12:00:00 GMT", true,  1792324800 },
+    { "Sun, 06 Nov 1994 08:49:37",     false, 0 },  // no zone
+    { "Sun, 06 Foo 1994 08:49:37 GMT", false, 0 },
+    { "Sun, 06 ovD 1994 08:49:37 GMT", false, 0 },  // not on a month boundary
+    { "Sun, 06 Nov 1994 24:00:00 GMT", false, 0 },
+    { "",                              false, 0 },
+  };
+
+  for ( const auto &c : cases )
+  {
+    uint32_t epoch = 0;
+    TEST_ASSERT_EQUAL_MESSAGE( c.isValid, parseHttpDate( c.text, epoch ), c.text );
+    if ( true == c.isValid ) { TEST_ASSERT_EQUAL_UINT32_MESSAGE( c.epoch, epoch, c.text ); }
+  }
+}
+
+int main(int, char **)
+{
+  UNITY_BEGIN();
+  RUN_TEST( test_header_build );
+  RUN_TEST( test_header_too_long );
+  RUN_TEST( test_write_post );
+  RUN_TEST( test_write_post_client_fails );
+  RUN_TEST( test_write_post_chunked );
+  RUN_TEST( test_write_post_chunked_empty_body );
+  RUN_TEST( test_write_post_chunked_compressed );
+  RUN_TEST( test_parse_http_date );
+  return UNITY_END();
+}
@@ -0,0 +1,211 @@
+#include <unity.h>
+
+#include <chrono>
+
+#include "line_protocol.h"
+#include "text_print.h"
+
+using namespace sensor;
+
+enum TestField : uint8_t
+{
+  TEST_FIELD_TEMPERATURE = 0,
+  TEST_FIELD_HUMIDITY,
+  TEST_FIELD_PRESSURE,
+  TEST_FIELD_BATTERY,
+  TEST_FIELD_UPTIME,
+  TEST_FIELD_COUNT
+};
+
+// The fields of the sensor reading, as in submitData()
+const LineSchema<2, TEST_FIELD_COUNT> TEST_SCHEMA =
+{
+  { "deviceId", "location" },
+  {
+    { "temperature", LINE_FIELD_FIXED,   2 },
+    { "humidity",    LINE_FIELD_FIXED,   2 },
+    { "pressure",    LINE_FIELD_FIXED,   2 },
+    { "battery",     LINE_FIELD_INTEGER, 0 },
+    { "uptime",      LINE_FIELD_FIXED,   1 },
+  }
+};
+
+typedef LinePoint<2, TEST_FIELD_COUNT> TestPoint;
+
+TestPoint makePoint()
+{
+  TestPoint point;
+  point.tagValues[0] = "TSH05";
+  point.tagValues[1] = "usHallway";
+  point.fieldValues[TEST_FIELD_TEMPERATURE] = 2153;
+  point.fieldValues[TEST_FIELD_HUMIDITY]    = 4510;
+  point.fieldValues[TEST_FIELD_PRESSURE]    = 101325;
+  point.fieldValues[TEST_FIELD_BATTERY]     = 87;
+  point.fieldValues[TEST_FIELD_UPTIME]      = 1234;
+  return point;
+}
+
+void setUp() {}
+void tearDown() {}
+
+//-- printFixed ------------------------------------------------------------------------------------
+void test_print_fixed()
+{
+  struct { int32_t value; uint8_t decimals; const char *text; } cases[] =
+  {
+    { 2153,           2, "21.53" },
+    { -2153,          2, "-21.53" },
+    { -5,             2, "-0.05" },   // the sign of a value above -1
+    { 0,              1, "0.0" },
+    { 7,              0, "7" },
+    { 100,            2, "1.00" },
+    { 123456789,      9, "0.123456789" },
+    { INT32_MIN + 1,  0, "-2147483647" },
+    { INT32_MAX,      3, "2147483.647" },
+  };
+
+  for ( const auto &c : cases )
+  {
+    TextPrint out;
+    size_t length = printFixed( out, c.value, c.decimals );
+    TEST_ASSERT_EQUAL_STRING( c.text, out.c_str() );
+    TEST_ASSERT_EQUAL( strlen( c.text ), length );
+  }
+}
+
+//-- printLineName ---------------------------------------------------------------------------------
+void test_print_line_name_escapes()
+{
+  TextPrint out;
+  printLineName( out, "my sensor,a=b", false );
+  TEST_ASSERT_EQUAL_STRING( "my\\ sensor\\,a=b", out.c_str() );
+
+  out.clear();
+  size_t length = printLineName( out, "my sensor,a=b", true );
+  TEST_ASSERT_EQUAL_STRING( "my\\ sensor\\,a\\=b", out.c_str() );
+  TEST_ASSERT_EQUAL( out.length(), length );
+}
+
+//-- encodeLine ------------------------------------------------------------------------------------
+void test_encode_line()
+{
+  TestPoint point = makePoint();
+  TextPrint out;
+  size_t length = encodeLine( out, "devThermoSensor", NULL, TEST_SCHEMA, point );
+  TEST_ASSERT_EQUAL_STRING( "devThermoSensor,deviceId=TSH05,location=usHallway "
+                            "temperature=21.53,humidity=45.10,pressure=1013.25,battery=87i,uptime=123.4\n",
+                            out.c_str() );
+  TEST_ASSERT_EQUAL( out.length(), length );
+}
+
+void test_encode_line_skips_empty_tags_and_missing_fields()
+{
+  TestPoint point = makePoint();
+  point.tagValues[1] = "";
+  point.fieldValues[TEST_FIELD_TEMPERATURE] = LINE_VALUE_MISSING;
+  point.fieldValues[TEST_FIELD_PRESSURE]    = LINE_VALUE_MISSING;
+  point.fieldValues[TEST_FIELD_UPTIME]      = LINE_VALUE_MISSING;
+  point.timeStamp = 1700000000;
+
+  TextPrint out;
+  encodeLine( out, "devThermoSensor", "Health", TEST_SCHEMA, point );
+  TEST_ASSERT_EQUAL_STRING( "devThermoSensorHealth,deviceId=TSH05 humidity=45.10,battery=87i 1700000000\n",
+                            out.c_str() );
+}
+
+void test_encode_line_escapes_tags()
+{
+  TestPoint point = makePoint();
+  point.tagValues[1] = "living room,north=1";
+
+  TextPrint out;
+  encodeLine( out, "dev", NULL, TEST_SCHEMA, point );
+  TEST_ASSERT_NOT_NULL( strstr( out.c_str(), ",location=living\\ room\\,north\\=1 " ) );
+}
+
+//-- encodeLines -----------------------------------------------------------------------------------
+void test_encode_lines()
+{
+  TestPoint points[2] = { makePoint(), makePoint() };
+  points[0].timeStamp = 1700000000;
+  points[1].timeStamp = 1700000060;
+  points[1].fieldValues[TEST_FIELD_TEMPERATURE] = -50;
+
+  TextPrint out;
+  size_t length = encodeLines( out, "dev", TEST_SCHEMA, points, 2 );
+  TEST_ASSERT_EQUAL( out.length(), length );
+
+  const char *second = strchr( out.c_str(), '\n' ) + 1;
+  TEST_ASSERT_EQUAL_STRING( "dev,deviceId=TSH05,location=usHallway "
+                            "temperature=-0.50,humidity=45.10,pressure=1013.25,battery=87i,uptime=123.4 1700000060\n",
+                            second );
+}
+
+//-- BENCHMARK -------------------------------------------------------------------------------------
+// The encoder against the sprintf() of PAYLOAD_STRING, which it has replaced. On the host the FPU
+// formats the floats, the ESP8266 formats them in software: the ratio printed here is the lower
+// bound of the gain on the device.
+const uint32_t BENCHMARK_LINES = 200000;
+
+const char PAYLOAD_STRING[] =
+  "%s,deviceId=%s,location=%s temperature=%.2f,humidity=%.2f,pressure=%.2f,battery=%di,uptime=%llu.%llu\n";
+
+class NullPrint : public Print
+{
+public:
+  using Print::write;
+  size_t write(uint8_t) override { return 1; }
+  size_t write(const uint8_t *, size_t size) override { return size; }
+};
+
+void test_benchmark_against_sprintf()
+{
+  typedef std::chrono::steady_clock Clock;
+
+  volatile float tempr = 21.53f;
+  float humid = 45.1f;
+  float press = 1013.25f;
+  unsigned long long uptime = 123456;
+
+  char payload[256];
+  size_t sprintfLength = 0;
+  Clock::time_point start = Clock::now();
+  for ( uint32_t i = 0; i < BENCHMARK_LINES; ++i )
+  {
+    sprintfLength += sprintf( payload, PAYLOAD_STRING, "devThermoSensor", "TSH05", "usHallway",
+                              tempr + i % 8, humid, press, 87, uptime / 1000, uptime / 100 % 10 );
+  }
+  double sprintfTime = std::chrono::duration<double, std::nano>( Clock::now() - start ).count();
+
+  NullPrint out;
+  TestPoint point = makePoint();
+  size_t encoderLength = 0;
+  start = Clock::now();
+  for ( uint32_t i = 0; i < BENCHMARK_LINES; ++i )
+  {
+    point.fieldValues[TEST_FIELD_TEMPERATURE] = 2153 + i % 8 * 100;
+    encoderLength += encodeLine( out, "devThermoSensor", NULL, TEST_SCHEMA, point );
+  }
+  double encoderTime = std::chrono::duration<double, std::nano>( Clock::now() - start ).count();
+
+  // The same lines, so the same amount of text is produced
+  TEST_ASSERT_EQUAL( sprintfLength, encoderLength );
+
+  char message[128];
+  snprintf( message, sizeof( message ), "sprintf: %.0f ns/line, encodeLine: %.0f ns/line (%.1fx)",
+            sprintfTime / BENCHMARK_LINES, encoderTime / BENCHMARK_LINES, sprintfTime / encoderTime );
+  TEST_MESSAGE( message );
+}
+
+int main(int, char **)
+{
+  UNITY_BEGIN();
+  RUN_TEST( test_print_fixed );
+  RUN_TEST( test_print_line_name_escapes );
+  RUN_TEST( test_encode_line );
+  RUN_TEST( test_encode_line_skips_empty_tags_and_missing_fields );
+  RUN_TEST( test_encode_line_escapes_tags );
+  RUN_TEST( test_encode_lines );
+  RUN_TEST( test_benchmark_against_sprintf );
+  return UNITY_END();
+}
@@ -0,0 +1,330 @@
+#include <unity.h>
+
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "udp_line_sender.h"
+
+using namespace sensor;
+
+const IPAddress RELAY_IP( 192, 168, 1, 20 );
+const IPAddress OTHER_IP( 192, 168, 1, 21 );
+const uint16_t  RELAY_PORT     = 8094;
+const uint32_t  FIRST_SEQUENCE = 7;
+
+//-- getSequence: of the "#seq <sequence>\n" line
+uint32_t getSequence(const std::string &data)
+{
+  unsigned sequence = 0;
+  TEST_ASSERT_EQUAL( 1, sscanf( data.c_str(), "#seq %u\n", &sequence ) );
+  return sequence;
+}
+
+//-- FakeRelay -------------------------------------------------------------------------------------
+// Keeps the sent datagrams, onDatagram scripts the answers of the relay. An answer is received
+// after its delay, the clock is advanced by the sender waiting with delay().
+class FakeRelay : public UDP
+{
+public:
+  struct Datagram
+  {
+    IPAddress   ip;
+    uint16_t    port;
+    std::string data;
+  };
+
+  //-- onDatagram: called with every sent datagram, the default acknowledges it
+  std::function<void(const std::string &data)> onDatagram = [this](const std::string &data) { ack( getSequence( data ) ); };
+  bool isSendFailing = false; // beginPacket fails
+
+  std::vector<Datagram> sent;
+
+  void answer(const char *text, const IPAddress &ip = RELAY_IP, uint32_t delayMs = 0)
+  {
+    m_answers.push_back( { static_cast<uint32_t>( millis() + delayMs ), ip, text } );
+  }
+  void ack(uint32_t sequence, const IPAddress &ip = RELAY_IP, uint32_t delayMs = 0)
+  {
+    answer( ( "ack " + std::to_string( sequence ) ).c_str(), ip, delayMs );
+  }
+
+  uint8_t begin(uint16_t) override { return 1; }
+  void stop() override {}
+
+  int beginPacket(IPAddress ip, uint16_t port) override
+  {
+    if ( true == isSendFailing ) { return 0; }
+    m_packet = { ip, port, std::string() };
+    return 1;
+  }
+  using Print::write;
+  size_t write(uint8_t c) override { return write( &c, 1 ); }
+  size_t write(const uint8_t *data, size_t size) override
+  {
+    m_packet.data.append( reinterpret_cast<const char *>( data ), size );
+    return size;
+  }
+  int endPacket() override
+  {
+    if ( true == isSendFailing ) { return 0; }
+    sent.push_back( m_packet );
+    onDatagram( m_packet.data );
+    return 1;
+  }
+
+  int parsePacket() override
+  {
+    if ( true == m_answers.empty() || millis() < m_answers.front().time ) { return 0; }
+    m_received = m_answers.front();
+    m_answers.pop_front();
+    return static_cast<int>( m_received.text.size() );
+  }
+  int available() override { return static_cast<int>( m_received.text.size() ); }
+  int read() override { unsigned char c = 0; return ( 1 == read( &c, 1 ) ? c : -1 ); }
+  int read(unsigned char *buffer, size_t size) override
+  {
+    size_t length = std::min( size, m_received.text.size() );
+    memcpy( buffer, m_received.text.data(), length );
+    m_received.text.erase( 0, length );
+    return static_cast<int>( length );
+  }
+  using UDP::read;
+  int peek() override { return ( true == m_received.text.empty() ? -1 : static_cast<uint8_t>( m_received.text[0] ) ); }
+
+  IPAddress remoteIP() override { return m_received.ip; }
+  uint16_t remotePort() override { return RELAY_PORT; }
+
+private:
+  struct Answer
+  {
+    uint32_t    time;
+    IPAddress   ip;
+    std::string text;
+  };
+
+  Datagram           m_packet;
+  std::deque<Answer> m_answers;
+  Answer             m_received;
+};
+
+//-- printLines: count lines of the given length, the new line included
+std::string printLines(Print &out, size_t count, size_t length)
+{
+  std::string lines;
+  for ( size_t i = 0; i < count; ++i )
+  {
+    std::string line = "m,n=" + std::to_string( i ) + " v=";
+    line.append( length - line.size() - 1, '1' );
+    line += '\n';
+    TEST_ASSERT_EQUAL( line.size(), out.write( line.c_str(), line.size() ) );
+    lines += line;
+  }
+  return lines;
+}
+
+//-- getPayload: the datagram without the sequence line
+std::string getPayload(const std::string &data) { return data.substr( data.find( '\n' ) + 1 ); }
+
+void setUp() { g_stubMillis = 1000; }
+void tearDown() {}
+
+//-- UNACKNOWLEDGED --------------------------------------------------------------------------------
+void test_unacknowledged()
+{
+  FakeRelay relay;
+  relay.onDatagram = [](const std::string &) {};
+  UdpLineSender sender( relay, RELAY_IP, RELAY_PORT, false, FIRST_SEQUENCE );
+
+  std::string lines = printLines( sender, 3, 60 );
+  TEST_ASSERT_EQUAL( 0, relay.sent.size() );
+  TEST_ASSERT_TRUE( sender.end() );
+
+  // No sequence line, no waiting for an answer
+  TEST_ASSERT_EQUAL( 1, relay.sent.size() );
+  TEST_ASSERT_TRUE( RELAY_IP == relay.sent[0].ip );
+  TEST_ASSERT_EQUAL( RELAY_PORT, relay.sent[0].port );
+  TEST_ASSERT_EQUAL_STRING( lines.c_str(), relay.sent[0].data.c_str() );
+  TEST_ASSERT_EQUAL( 1000, millis() );
+}
+
+void test_end_without_lines()
+{
+  FakeRelay relay;
+  UdpLineSender sender( relay, RELAY_IP, RELAY_PORT, true, FIRST_SEQUENCE );
+  TEST_ASSERT_TRUE( sender.end() );
+  TEST_ASSERT_EQUAL( 0, relay.sent.size() );
+}
+
+//-- ACKNOWLEDGED ----------------------------------------------------------------------------------
+void test_acknowledged()
+{
+  FakeRelay relay;
+  UdpLineSender sender( relay, RELAY_IP, RELAY_PORT, true, FIRST_SEQUENCE );
+
+  std::string lines = printLines( sender, 3, 60 );
+  TEST_ASSERT_TRUE( sender.end() );
+
+  TEST_ASSERT_EQUAL( 1, relay.sent.size() );
+  TEST_ASSERT_EQUAL_STRING( ( "#seq 7\n" + lines ).c_str(), relay.sent[0].data.c_str() );
+}
+
+// A line is never split, the datagrams have consecutive sequences
+void test_datagrams_split_at_lines()
+{
+  FakeRelay relay;
+  UdpLineSender sender( relay, RELAY_IP, RELAY_PORT, true, FIRST_SEQUENCE );
+
+  std::string lines = printLines( sender, 25, 100 );
+  TEST_ASSERT_TRUE( sender.end() );
+
+  TEST_ASSERT_EQUAL( 3, relay.sent.size() );
+  std::string received;
+  for ( size_t i = 0; i < relay.sent.size(); ++i )
+  {
+    const std::string &data = relay.sent[i].data;
+    TEST_ASSERT_TRUE( UDP_DATAGRAM_MAX_SIZE >= data.size() );
+    TEST_ASSERT_EQUAL( FIRST_SEQUENCE + i, getSequence( data ) );
+    TEST_ASSERT_EQUAL( '\n', data.back() );
+    TEST_ASSERT_EQUAL( 0, getPayload( data ).size() % 100 );
+    received += getPayload( data );
+  }
+  TEST_ASSERT_EQUAL_STRING( lines.c_str(), received.c_str() );
+}
+
+// The relay answers a little later, within UDP_ACK_TIMEOUT
+void test_late_ack()
+{
+  FakeRelay relay;
+  relay.onDatagram = [&relay](const std::string &data) { relay.ack( getSequence( data ), RELAY_IP, UDP_ACK_TIMEOUT - 10 ); };
+  UdpLineSender sender( relay, RELAY_IP, RELAY_PORT, true, FIRST_SEQUENCE );
+
+  printLines( sender, 1, 60 );
+  TEST_ASSERT_TRUE( sender.end() );
+  TEST_ASSERT_EQUAL( 1, relay.sent.size() );
+}
+
+// The ack of the previous datagram, e.g. of its retransmission, does not acknowledge this one
+void test_stale_ack_skipped()
+{
+  FakeRelay relay;
+  relay.onDatagram = [&relay](const std::string &data)
+  {
+    uint32_t sequence = getSequence( data );
+    relay.ack( sequence - 1 );
+    relay.answer( "garbage" );
+    relay.ack( sequence, RELAY_IP, 5 );
+  };
+  UdpLineSender sender( relay, RELAY_IP, RELAY_PORT, true, FIRST_SEQUENCE );
+
+  printLines( sender, 1, 60 );
+  TEST_ASSERT_TRUE( sender.end() );
+  TEST_ASSERT_EQUAL( 1, relay.sent.size() );
+
+  // Only the stale ack: the datagram is sent again
+  FakeRelay staleRelay;
+  staleRelay.onDatagram = [&staleRelay](const std::string &data) { staleRelay.ack( getSequence( data ) - 1 ); };
+  UdpLineSender staleSender( staleRelay, RELAY_IP, RELAY_PORT, true, FIRST_SEQUENCE );
+
+  printLines( staleSender, 1, 60 );
+  TEST_ASSERT_FALSE( staleSender.end() );
+  TEST_ASSERT_EQUAL( UDP_MAX_ATTEMPTS, staleRelay.sent.size() );
+}
+
+// An ack from another host is ignored
+void test_ack_from_other_ip_ignored()
+{
+  FakeRelay relay;
+  relay.onDatagram = [&relay](const std::string &data)
+  {
+    relay.ack( getSequence( data ), ( 1 == relay.sent.size() ? OTHER_IP : RELAY_IP ) );
+  };
+  UdpLineSender sender( relay, RELAY_IP, RELAY_PORT, true, FIRST_SEQUENCE );
+
+  printLines( sender, 1, 60 );
+  TEST_ASSERT_TRUE( sender.end() );
+  TEST_ASSERT_EQUAL( 2, relay.sent.size() );
+  TEST_ASSERT_EQUAL_STRING( relay.sent[0].data.c_str(), relay.sent[1].data.c_str() ); // same sequence
+}
+
+//-- RETRANSMISSION --------------------------------------------------------------------------------
+// A lost datagram or ack: the same datagram is sent again
+void test_retransmission()
+{
+  FakeRelay relay;
+  relay.onDatagram = [&relay](const std::string &data)
+  {
+    if ( 3 <= relay.sent.size() ) { relay.ack( getSequence( data ) ); }
+  };
+  UdpLineSender sender( relay, RELAY_IP, RELAY_PORT, true, FIRST_SEQUENCE );
+
+  printLines( sender, 1, 60 );
+  TEST_ASSERT_TRUE( sender.end() );
+  TEST_ASSERT_EQUAL( 3, relay.sent.size() );
+  TEST_ASSERT_EQUAL_STRING( relay.sent[0].data.c_str(), relay.sent[2].data.c_str() );
+  TEST_ASSERT_EQUAL( 1000 + 2 * UDP_ACK_TIMEOUT, millis() );
+}
+
+// No answer: UDP_MAX_ATTEMPTS times UDP_ACK_TIMEOUT, then the sender fails
+void test_no_ack()
+{
+  FakeRelay relay;
+  relay.onDatagram = [](const std::string &) {};
+  UdpLineSender sender( relay, RELAY_IP, RELAY_PORT, true, FIRST_SEQUENCE );
+
+  // The first datagram fails while the lines are printed
+  std::string line( 99, '1' );
+  line += '\n';
+  size_t written = 0;
+  for ( int i = 0; i < 25; ++i ) { written += sender.write( line.c_str(), line.size() ); }
+  TEST_ASSERT_EQUAL( UDP_DATAGRAM_MAX_SIZE - UDP_SEQUENCE_MAX_SIZE, written );
+  TEST_ASSERT_EQUAL( UDP_MAX_ATTEMPTS, relay.sent.size() );
+  TEST_ASSERT_EQUAL( 1000 + UDP_MAX_ATTEMPTS * UDP_ACK_TIMEOUT, millis() );
+
+  // Nothing is sent after the failure
+  TEST_ASSERT_EQUAL( 0, sender.write( 'x' ) );
+  TEST_ASSERT_FALSE( sender.end() );
+  TEST_ASSERT_EQUAL( UDP_MAX_ATTEMPTS, relay.sent.size() );
+}
+
+void test_send_failed()
+{
+  FakeRelay relay;
+  relay.isSendFailing = true;
+  UdpLineSender sender( relay, RELAY_IP, RELAY_PORT, true, FIRST_SEQUENCE );
+
+  printLines( sender, 1, 60 );
+  TEST_ASSERT_FALSE( sender.end() );
+  TEST_ASSERT_EQUAL( 0, relay.sent.size() );
+  TEST_ASSERT_EQUAL( 1000, millis() ); // no waiting for the ack of a datagram not sent
+}
+
+//-- LINE TOO LONG ---------------------------------------------------------------------------------
+void test_line_too_long()
+{
+  FakeRelay relay;
+  UdpLineSender sender( relay, RELAY_IP, RELAY_PORT, true, FIRST_SEQUENCE );
+
+  std::string line( UDP_DATAGRAM_MAX_SIZE, 'x' );
+  TEST_ASSERT_EQUAL( UDP_DATAGRAM_MAX_SIZE - UDP_SEQUENCE_MAX_SIZE, sender.write( line.c_str(), line.size() ) );
+  TEST_ASSERT_FALSE( sender.end() );
+  TEST_ASSERT_EQUAL( 0, relay.sent.size() );
+}
+
+int main(int, char **)
+{
+  UNITY_BEGIN();
+  RUN_TEST( test_unacknowledged );
+  RUN_TEST( test_end_without_lines );
+  RUN_TEST( test_acknowledged );
+  RUN_TEST( test_datagrams_split_at_lines );
+  RUN_TEST( test_late_ack );
+  RUN_TEST( test_stale_ack_skipped );
+  RUN_TEST( test_ack_from_other_ip_ignored );
+  RUN_TEST( test_retransmission );
+  RUN_TEST( test_no_ack );
+  RUN_TEST( test_send_failed );
+  RUN_TEST( test_line_too_long );
+  return UNITY_END();
+}
@@ -0,0 +1,317 @@
+#include <unity.h>
+
+#include <string>
+
+#include <LittleFS.h>
+
+#include "config_schema.h"
+#include "sensor_config_file_management.h"
+#include "sensor_ini_file_storage.h"
+#include "web_config_management.h"
+#include "text_print.h"
+
+using namespace sensor;
+
+// data/sensor_config.ini
+const char INI_TEXT[] =
+  "[network]\n"
+  "wifi_enabled=true\n"
+  "wifi_ap_ssid=MyNetwork\n"
+  "wifi_ap_pwd=secret pass\n"
+  "wifi_ap_bssid=01-23-45-67-89-ab\n"
+  "wifi_ap_channel=6\n"
+  "wifi_con_delay=150\n"
+  "wifi_max_con_attempts=240\n"
+  "[data upload]\n"
+  "upload_freq=180\n"
+  "upload_timeout=20\n"
+  "device_id=TSH05\n"
+  "location=usHallway\n"
+  "data_measurement_org=mine\n"
+  "data_measurement_bucket=ts_bucket\n"
+  "data_measurement_name=devThermoSensor\n"
+  "batch_size=4\n"
+  "temp_deadband=0.25\n"
+  "hum_deadband=1.50\n"
+  "max_silent_wakes=10\n"
+  "history_enabled=false\n"
+  "backlog_drain_max=60\n"
+  "[server config]\n"
+  "server_address=eu-central-1-1.aws.cloud2.influxdata.com\n"
+  "server_port=443\n"
+  "server_auth_token=token\n"
+  "tls_profile=1\n"
+  "gzip_min_size=512\n"
+  "server_transport=0\n"
+  "[display]\n"
+  "display_contrast=137\n"
+  "display_rotation=false\n"
+  "[sensor]\n"
+  "sensor_temp_correction=-1.5\n"
+  "sensor_telemetry_interval=1000\n"
+  "[battery]\n"
+  "battery_min_level=527\n"
+  "battery_max_level=856\n"
+  "battery_low_level=30\n"
+  "battery_critical_level=10\n";
+
+const char INDEX_HTML[]  = "<html>index</html>";
+const char SUBMIT_HTML[] = "<html>saved</html>";
+
+SensorIniFileStorage g_storage;
+
+void writeTextFile(const char *path, const char *text)
+{
+  File file = LittleFS.open( path, "w" );
+  file.write( text );
+  file.close();
+}
+
+std::string readTextFile(const char *path)
+{
+  File file = LittleFS.open( path, "r" );
+  std::string text;
+  for ( int c = file.read(); -1 != c; c = file.read() ) { text.push_back( static_cast<char>( c ) ); }
+  file.close();
+  return text;
+}
+
+//-- addForm: every field of the config page with its current value, as the page submits them
+void addForm(AsyncWebServerRequest &request)
+{
+  for ( uint8_t i = 0; i < CONFIG_FIELD_COUNT; ++i )
+  {
+    const ConfigField &field = CONFIG_FIELDS[i];
+    if ( 0 == ( field.flags & CONFIG_FLAG_FORM ) ) { continue; }
+
+    TextPrint value;
+    printConfigValue( value, field, g_storage );
+    if ( CONFIG_TYPE_BOOL == field.type && value.text() != "true" ) { continue; } // an unchecked checkbox
+    request.addParam( field.key, value.c_str() );
+  }
+}
+
+void setForm(AsyncWebServerRequest &request, const char *key, const char *value)
+{
+  AsyncWebParameter *param = request.getParam( key, true );
+  *param = AsyncWebParameter( key, value, true );
+}
+
+void setUp()
+{
+  LittleFS.format();
+  writeTextFile( INI_FILENAME, INI_TEXT );
+  writeTextFile( "/index.html", INDEX_HTML );
+  writeTextFile( "/submit.html", SUBMIT_HTML );
+  writeTextFile( "/i/wifi.svg.gz", "gzipped svg" );
+  writeTextFile( "/assets.id", "1700000000\n" );
+  writeTextFile( "/history/0.bin", "history" );
+
+  g_storage = SensorIniFileStorage();
+  SensorConfigFile().readIniFile( g_storage );
+}
+
+void tearDown() {}
+
+//-- STATIC FILES ----------------------------------------------------------------------------------
+void test_static_files()
+{
+  AsyncWebServer server( 80 );
+  WebConfigManagement webConfig;
+  webConfig.begin( server, g_storage );
+
+  AsyncWebServerRequest index( HTTP_GET, "/" );
+  server.handle( &index );
+  TEST_ASSERT_EQUAL( 200, index.response()->code );
+  TEST_ASSERT_EQUAL_STRING( "text/html", index.response()->contentType.c_str() );
+  TEST_ASSERT_EQUAL_STRING( INDEX_HTML, index.response()->content.c_str() );
+  TEST_ASSERT_EQUAL_STRING( "no-cache", index.response()->getHeader( "Cache-Control" )->value().c_str() );
+
+  // The compressed file is served for the path without its extension
+  AsyncWebServerRequest icon( HTTP_GET, "/i/wifi.svg" );
+  server.handle( &icon );
+  TEST_ASSERT_EQUAL( 200, icon.response()->code );
+  TEST_ASSERT_EQUAL_STRING( "image/svg+xml", icon.response()->contentType.c_str() );
+  TEST_ASSERT_EQUAL_STRING( "gzipped svg", icon.response()->content.c_str() );
+  TEST_ASSERT_EQUAL_STRING( "max-age=604800", icon.response()->getHeader( "Cache-Control" )->value().c_str() );
+}
+
+void test_files_not_served()
+{
+  AsyncWebServer server( 80 );
+  WebConfigManagement webConfig;
+  webConfig.begin( server, g_storage );
+
+  const char *urls[] = { INI_FILENAME, "/assets.id", "/history/0.bin", "/missing.html", "/i/wifi.svg.gz" };
+  for ( const char *url : urls )
+  {
+    AsyncWebServerRequest request( HTTP_GET, url );
+    server.handle( &request );
+    TEST_ASSERT_EQUAL_INT_MESSAGE( 404, request.response()->code, url );
+  }
+}
+
+void test_etag_revalidation()
+{
+  AsyncWebServer server( 80 );
+  WebConfigManagement webConfig;
+  webConfig.begin( server, g_storage );
+
+  AsyncWebServerRequest first( HTTP_GET, "/index.html" );
+  server.handle( &first );
+  const AsyncWebHeader *etag = first.response()->getHeader( "ETag" );
+  TEST_ASSERT_NOT_NULL( etag );
+
+  AsyncWebServerRequest second( HTTP_GET, "/index.html" );
+  second.addHeader( "If-None-Match", etag->value().c_str() );
+  server.handle( &second );
+  TEST_ASSERT_EQUAL( 304, second.response()->code );
+}
+
+//-- GET /api/config -------------------------------------------------------------------------------
+void test_get_config()
+{
+  AsyncWebServer server( 80 );
+  WebConfigManagement webConfig;
+  webConfig.begin( server, g_storage );
+
+  AsyncWebServerRequest request( HTTP_GET, "/api/config" );
+  server.handle( &request );
+  TEST_ASSERT_EQUAL( 200, request.response()->code );
+  TEST_ASSERT_EQUAL_STRING( "application/json", request.response()->contentType.c_str() );
+
+  // Rendered in pieces, the pieces must join into the whole object
+  const std::string &json = request.response()->content;
+  TEST_ASSERT_EQUAL( '{', json.front() );
+  TEST_ASSERT_EQUAL( '}', json.back() );
+  TEST_ASSERT_TRUE( std::string::npos != json.find( "\"device_id\":\"TSH05\"" ) );
+  TEST_ASSERT_TRUE( std::string::npos != json.find( "\"upload_freq\":180" ) );
+  TEST_ASSERT_TRUE( std::string::npos == json.find( "wifi_ap_bssid" ) ); // not on the form
+}
+
+//-- PUT /api/config -------------------------------------------------------------------------------
+// The answer waits for the ini file
+void test_put_config_answered_after_write()
+{
+  AsyncWebServer server( 80 );
+  WebConfigManagement webConfig;
+  webConfig.begin( server, g_storage );
+
+  AsyncWebServerRequest request( HTTP_PUT, "/api/config" );
+  addForm( request );
+  setForm( request, INI_DATA_LOCATION, "attic" );
+  server.handle( &request );
+  TEST_ASSERT_NULL( request.response() );
+  TEST_ASSERT_EQUAL_STRING( "attic", g_storage.location );
+  TEST_ASSERT_EQUAL( 0, g_storage.wifi_ap_bssid[0] ); // the AP may have changed
+
+  webConfig.loop();
+  TEST_ASSERT_EQUAL( 204, request.response()->code );
+  TEST_ASSERT_TRUE( std::string::npos != readTextFile( INI_FILENAME ).find( "location=attic\n" ) );
+}
+
+void test_put_config_invalid()
+{
+  AsyncWebServer server( 80 );
+  WebConfigManagement webConfig;
+  webConfig.begin( server, g_storage );
+
+  AsyncWebServerRequest request( HTTP_PUT, "/api/config" );
+  addForm( request );
+  setForm( request, INI_DATA_LOCATION, "attic" );
+  setForm( request, INI_DATA_FREQ, "0" );
+  server.handle( &request );
+  TEST_ASSERT_EQUAL( 400, request.response()->code );
+  TEST_ASSERT_TRUE( std::string::npos != request.response()->content.find( "upload_freq is invalid" ) );
+
+  // Nothing is applied from a rejected form
+  TEST_ASSERT_EQUAL_STRING( "usHallway", g_storage.location );
+  webConfig.loop();
+  TEST_ASSERT_EQUAL_STRING( INI_TEXT, readTextFile( INI_FILENAME ).c_str() );
+}
+
+void test_put_config_busy()
+{
+  AsyncWebServer server( 80 );
+  WebConfigManagement webConfig;
+  webConfig.begin( server, g_storage );
+
+  AsyncWebServerRequest first( HTTP_PUT, "/api/config" );
+  addForm( first );
+  server.handle( &first );
+
+  AsyncWebServerRequest second( HTTP_PUT, "/api/config" );
+  addForm( second );
+  server.handle( &second );
+  TEST_ASSERT_EQUAL( 503, second.response()->code );
+
+  webConfig.loop();
+  TEST_ASSERT_EQUAL( 204, first.response()->code );
+}
+
+void test_put_config_write_failed()
+{
+  AsyncWebServer server( 80 );
+  WebConfigManagement webConfig;
+  webConfig.begin( server, g_storage );
+  LittleFS.remove( INI_FILENAME ); // the back-up cannot be made, the write fails
+
+  AsyncWebServerRequest request( HTTP_PUT, "/api/config" );
+  addForm( request );
+  server.handle( &request );
+
+  webConfig.loop();
+  TEST_ASSERT_EQUAL( 500, request.response()->code );
+  TEST_ASSERT_EQUAL_STRING( "Error saving the configuration!", request.response()->content.c_str() );
+}
+
+void test_put_config_client_gone()
+{
+  AsyncWebServer server( 80 );
+  WebConfigManagement webConfig;
+  webConfig.begin( server, g_storage );
+
+  AsyncWebServerRequest request( HTTP_PUT, "/api/config" );
+  addForm( request );
+  setForm( request, INI_DATA_LOCATION, "attic" );
+  server.handle( &request );
+  request.disconnect();
+
+  // The config is written, there is nobody to answer
+  webConfig.loop();
+  TEST_ASSERT_NULL( request.response() );
+  TEST_ASSERT_TRUE( std::string::npos != readTextFile( INI_FILENAME ).find( "location=attic\n" ) );
+}
+
+//-- POST /submit.html -----------------------------------------------------------------------------
+void test_post_form()
+{
+  AsyncWebServer server( 80 );
+  WebConfigManagement webConfig;
+  webConfig.begin( server, g_storage );
+
+  AsyncWebServerRequest request( HTTP_POST, "/submit.html" );
+  addForm( request );
+  server.handle( &request );
+  TEST_ASSERT_NULL( request.response() );
+
+  webConfig.loop();
+  TEST_ASSERT_EQUAL( 200, request.response()->code );
+  TEST_ASSERT_EQUAL_STRING( SUBMIT_HTML, request.response()->content.c_str() );
+}
+
+int main(int, char **)
+{
+  UNITY_BEGIN();
+  RUN_TEST( test_static_files );
+  RUN_TEST( test_files_not_served );
+  RUN_TEST( test_etag_revalidation );
+  RUN_TEST( test_get_config );
+  RUN_TEST( test_put_config_answered_after_write );
+  RUN_TEST( test_put_config_invalid );
+  RUN_TEST( test_put_config_busy );
+  RUN_TEST( test_put_config_write_failed );
+  RUN_TEST( test_put_config_client_gone );
+  RUN_TEST( test_post_form );
+  return UNITY_END();
+}
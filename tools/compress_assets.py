@@ -0,0 +1,81 @@
+# PlatformIO pre-script: builds the LittleFS image from minified and gzipped web assets.
+#
+# The files of data/ are staged into $BUILD_DIR/data and the file system image is made of that
+# folder. The text assets are minified and only their .gz variant is kept, the web server sends
+# it with "Content-Encoding: gzip". The files written by the device (sensor_config.*) and the
+# already compressed images (png, jpg) are copied as they are.
+# /assets.id holds a hash of the staged content, the web server uses it as the ETag.
+
+Import("env")
+
+import gzip
+import hashlib
+import os
+import re
+import shutil
+
+from SCons.Script import COMMAND_LINE_TARGETS
+
+COMPRESSED_EXTENSIONS = (".html", ".css", ".js", ".svg", ".xml", ".webmanifest", ".ico", ".json")
+RAW_FILE_PREFIX       = "sensor_config."
+ASSETS_ID_FILENAME    = "assets.id"
+
+
+def minify(name, text):
+    if name.endswith(".html") or name.endswith(".svg") or name.endswith(".xml"):
+        text = re.sub(r"<!--.*?-->", "", text, flags=re.S)
+        text = re.sub(r">\s+<", "> <", text)
+    elif name.endswith(".css"):
+        text = re.sub(r"/\*.*?\*/", "", text, flags=re.S)
+        text = re.sub(r"\s*([{};,>])\s*", r"\1", text)
+    # Only the indentation and the empty lines are removed from everything else (js, json)
+    return "\n".join(line.strip() for line in text.splitlines() if line.strip())
+
+
+def stage_file(source, target):
+    name = os.path.basename(source)
+    if name.startswith(RAW_FILE_PREFIX) or not name.endswith(COMPRESSED_EXTENSIONS):
+        shutil.copyfile(source, target)
+        return target
+
+    with open(source, "rb") as file:
+        content = file.read()
+    if not name.endswith(".ico"):
+        content = minify(name, content.decode("utf-8")).encode("utf-8")
+
+    # mtime=0: the same content gives the same archive, so the assets id only changes with it
+    with open(target + ".gz", "wb") as file:
+        file.write(gzip.compress(content, compresslevel=9, mtime=0))
+    return target + ".gz"
+
+
+def stage_assets(source_dir, target_dir):
+    if os.path.isdir(target_dir):
+        shutil.rmtree(target_dir)
+
+    digest = hashlib.sha1()
+    for root, dirs, files in os.walk(source_dir):
+        dirs.sort()
+        relative = os.path.relpath(root, source_dir)
+        os.makedirs(os.path.join(target_dir, relative), exist_ok=True)
+
+        for name in sorted(files):
+            staged = stage_file(os.path.join(root, name), os.path.join(target_dir, relative, name))
+            with open(staged, "rb") as file:
+                digest.update(os.path.relpath(staged, target_dir).encode("utf-8"))
+                digest.update(file.read())
+
+            original = os.path.getsize(os.path.join(root, name))
+            print("  %-40s %6d -> %6d" % (os.path.join(relative, name), original, os.path.getsize(staged)))
+
+    with open(os.path.join(target_dir, ASSETS_ID_FILENAME), "w") as file:
+        file.write(digest.hexdigest()[:8])
+
+
+if any(target in COMMAND_LINE_TARGETS for target in ("buildfs", "uploadfs", "uploadfsota")):
+    source_dir = env.subst("$PROJECT_DATA_DIR")
+    target_dir = os.path.join(env.subst("$BUILD_DIR"), "data")
+
+    print("Compressing web assets: %s -> %s" % (source_dir, target_dir))
+    stage_assets(source_dir, target_dir)
+    env.Replace(PROJECT_DATA_DIR=target_dir)